@@ -59,6 +59,9 @@
 #include "olsr_logging.h"
 #include "olsr_ip_prefix_list.h"
 #include "parser.h"
+#include "interfaces.h"
+#include "net_olsr.h"
+#include "olsr_profile.h"
 #include "olsr_comport_txt.h"
 #include "olsrd_debuginfo.h"
 #include "olsr_types.h"
@@ -86,6 +89,10 @@ static enum olsr_txtcommand_result debuginfo_pktstat(struct comport_connection *
     const char *cmd, const char *param);
 static enum olsr_txtcommand_result debuginfo_cookies(struct comport_connection *con,
     const char *cmd, const char *param);
+static enum olsr_txtcommand_result debuginfo_outstat(struct comport_connection *con,
+    const char *cmd, const char *param);
+static enum olsr_txtcommand_result debuginfo_profile(struct comport_connection *con,
+    const char *cmd, const char *param);
 static enum olsr_txtcommand_result debuginfo_log(struct comport_connection *con,
     const char *cmd, const char *param);
 static enum olsr_txtcommand_result olsr_debuginfo_displayhelp(struct comport_connection *con,
@@ -129,6 +136,9 @@ static struct debuginfo_cmd commands[] = {
     {"msgstat", "Displays statistics about the incoming OLSR messages\n", &debuginfo_msgstat, NULL, NULL},
     {"pktstat", "Displays statistics about the incoming OLSR packets\n", &debuginfo_pktstat, NULL, NULL},
     {"cookies", "Displays statistics about memory and timer cookies\n", &debuginfo_cookies, NULL, NULL},
+    {"outstat", "Displays packing statistics of the outgoing OLSR packets\n", &debuginfo_outstat, NULL, NULL},
+    {"profile", "\"profile\":       Displays the time spent in the parser, route calculation and timer callbacks\n"
+                "\"profile reset\": Clears all measurements\n", &debuginfo_profile, NULL, NULL},
     {"log",     "\"log\":      continuous output of logging to this console\n"
                 "\"log show\": show configured logging option for debuginfo output\n"
                 "\"log add <severity> <source1> <source2> ...\": Add one or more sources of a defined severity for logging\n"
@@ -578,8 +588,8 @@ static INLINE bool debuginfo_print_cookies_mem(struct autobuf *buf) {
   struct olsr_memcookie_info *c, *iterator;
 
   OLSR_FOR_ALL_COOKIES(c, iterator) {
-    if (abuf_appendf(buf, "%-25s (MEMORY) size: %lu usage: %u freelist: %u\n",
-        c->ci_name, (unsigned long)c->ci_size, c->ci_usage, c->ci_free_list_usage) < 0) {
+    if (abuf_appendf(buf, "%-25s (MEMORY) size: %lu usage: %u freelist: %u slabs: %u\n",
+        c->ci_name, (unsigned long)c->ci_size, c->ci_usage, c->ci_free_list_usage, c->ci_slab_count) < 0) {
       return true;
     }
   }
@@ -620,6 +630,66 @@ debuginfo_cookies(struct comport_connection *con,
   return CONTINUE;
 }
 
+static enum olsr_txtcommand_result
+debuginfo_outstat(struct comport_connection *con,
+    const char *cmd __attribute__ ((unused)), const char *param __attribute__ ((unused)))
+{
+  struct interface *ifp, *iterator;
+
+  if (abuf_appendf(&con->out, "Interface\tPackets\tMessages\tBytes\tMsg/Pkt\tFill(%%)\tQueued\n") < 0) {
+    return ABUF_ERROR;
+  }
+
+  OLSR_FOR_ALL_INTERFACES(ifp, iterator) {
+    const struct olsr_netbuf *netbuf = &ifp->netbuf;
+    unsigned int msg_per_pkt = 0, fill = 0;
+
+    if (netbuf->stat_packets > 0) {
+      msg_per_pkt = netbuf->stat_messages / netbuf->stat_packets;
+      fill = (unsigned int)(netbuf->stat_bytes * 100 / ((uint64_t)netbuf->stat_packets * netbuf->maxsize));
+    }
+
+    if (abuf_appendf(&con->out, "%s\t%u\t%u\t%llu\t%u\t%u\t%d\n",
+        ifp->int_name, netbuf->stat_packets, netbuf->stat_messages,
+        (unsigned long long)netbuf->stat_bytes, msg_per_pkt, fill, netbuf->scheduled_count) < 0) {
+      return ABUF_ERROR;
+    }
+  }
+  return CONTINUE;
+}
+
+static enum olsr_txtcommand_result
+debuginfo_profile(struct comport_connection *con,
+    const char *cmd __attribute__ ((unused)), const char *param)
+{
+  struct olsr_profile *profile, *iterator;
+
+  if (param != NULL && strcasecmp(param, "reset") == 0) {
+    olsr_profile_reset_all();
+    return CONTINUE;
+  }
+  if (param != NULL && *param != 0) {
+    return UNKNOWN;
+  }
+
+  if (abuf_appendf(&con->out, "Name\tCalls\tTotal(us)\tAvg(ns)\tP50(ns)\tP99(ns)\tMax(ns)\n") < 0) {
+    return ABUF_ERROR;
+  }
+
+  OLSR_FOR_ALL_PROFILES(profile, iterator) {
+    if (abuf_appendf(&con->out, "%s\t%u\t%llu\t%llu\t%llu\t%llu\t%llu\n",
+        profile->name, profile->count,
+        (unsigned long long)(profile->total / 1000),
+        (unsigned long long)(profile->count > 0 ? profile->total / profile->count : 0),
+        (unsigned long long)olsr_profile_get_percentile(profile, 50),
+        (unsigned long long)olsr_profile_get_percentile(profile, 99),
+        (unsigned long long)profile->max) < 0) {
+      return ABUF_ERROR;
+    }
+  }
+  return CONTINUE;
+}
+
 static enum olsr_txtcommand_result
 debuginfo_update_logfilter(struct comport_connection *con,
     const char *cmd, const char *param, const char *current, bool value) {
@@ -1309,7 +1309,13 @@ write_resolv_file(void)
         struct ipaddr_str strbuf;
         char lqbuffer[LQTEXT_MAXLENGTH];
 #endif
-        route = olsr_lookup_routing_table(&name->ip);
+        /* the nameserver might be reachable by a HNA announced network */
+        route = olsr_lookup_routing_table_lpm(&name->ip);
+
+        /* a default route (gateway) does not say anything about the nameserver */
+        if (route != NULL && route->rt_dst.prefix_len == 0) {
+          route = NULL;
+        }
 
         OLSR_DEBUG(LOG_PLUGINS, "NAME PLUGIN: check route for nameserver %s %s",
                    olsr_ip_to_string(&strbuf, &name->ip), route ? "suceeded" : "failed");
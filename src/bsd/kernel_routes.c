@@ -386,6 +386,31 @@ olsr_ioctl_del_route6(const struct rt_entry *rt)
   return add_del_route6(rt, 0);
 }
 
+/**
+ * Routes cannot be replaced atomically on this platform.
+ */
+bool
+os_route_can_replace(void)
+{
+  return false;
+}
+
+/**
+ * Route updates are not batched on this platform.
+ */
+void
+os_route_batch_begin(void)
+{
+}
+
+/**
+ * Route updates are not batched on this platform.
+ */
+void
+os_route_batch_end(void)
+{
+}
+
 /*
  * Local Variables:
  * c-basic-offset: 2
@@ -0,0 +1,4 @@
+#include "defs.h"
+const char olsrd_version[] = "olsr.org - pre-0.7.0-429433a";
+const char build_date[] = "2026-10-18 01:25:16";
+const char build_host[] = "vm";
@@ -10,7 +10,7 @@
 
 #include <common/avl.h>
 
-extern avl_tree_comp avl_comp_default;
+extern avl_tree_comp EXPORT(avl_comp_default);
 extern avl_tree_comp avl_comp_addr_origin_default;
 extern avl_tree_comp avl_comp_prefix_default;
 extern avl_tree_comp avl_comp_prefix_origin_default;
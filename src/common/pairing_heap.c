@@ -0,0 +1,245 @@
+
+/*
+ * The olsr.org Optimized Link-State Routing daemon(olsrd)
+ * Copyright (c) 2004-2011, the olsr.org team - see HISTORY file
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of olsr.org, olsrd nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Visit http://www.olsr.org for more information.
+ *
+ * If you find this software useful feel free to make a donation
+ * to the project. For more information see the website or contact
+ * the copyright holders.
+ *
+ */
+
+#include <stddef.h>
+
+#include "common/common_types.h"
+#include "common/pairing_heap.h"
+
+static struct pairing_heap_node *int_pairing_heap_link(struct pairing_heap_node *,
+    struct pairing_heap_node *);
+static void int_pairing_heap_detach(struct pairing_heap_node *);
+static struct pairing_heap_node *int_pairing_heap_merge_pairs(struct pairing_heap_node *);
+
+/**
+ * Initialize a new pairing heap
+ * @param heap pointer to pairing heap
+ */
+void
+pairing_heap_init(struct pairing_heap *heap)
+{
+  heap->root = NULL;
+  heap->count = 0;
+}
+
+/**
+ * Insert a new node into a pairing heap
+ * @param heap pointer to pairing heap
+ * @param node pointer to node, must not be part of a heap
+ * @param key key of the node
+ */
+void
+pairing_heap_insert(struct pairing_heap *heap, struct pairing_heap_node *node, uint32_t key)
+{
+  node->key = key;
+  node->child = node->next = node->prev = NULL;
+
+  heap->root = heap->root ? int_pairing_heap_link(heap->root, node) : node;
+  heap->count++;
+}
+
+/**
+ * Lower the key of a node which is part of a pairing heap
+ * @param heap pointer to pairing heap
+ * @param node pointer to node
+ * @param key new key of the node, must not be larger than the old one
+ */
+void
+pairing_heap_decrease_key(struct pairing_heap *heap, struct pairing_heap_node *node, uint32_t key)
+{
+  node->key = key;
+
+  if (node == heap->root) {
+    return;
+  }
+
+  /* cut the subtree of the node and link it with the root */
+  int_pairing_heap_detach(node);
+  heap->root = int_pairing_heap_link(heap->root, node);
+}
+
+/**
+ * Remove and return the node with the smallest key of a pairing heap
+ * @param heap pointer to pairing heap
+ * @return pointer to removed node, NULL if heap is empty
+ */
+struct pairing_heap_node *
+pairing_heap_extract_min(struct pairing_heap *heap)
+{
+  struct pairing_heap_node *node = heap->root;
+
+  if (node == NULL) {
+    return NULL;
+  }
+
+  heap->root = int_pairing_heap_merge_pairs(node->child);
+  heap->count--;
+
+  node->child = NULL;
+  return node;
+}
+
+/**
+ * Remove a node from a pairing heap
+ * @param heap pointer to pairing heap
+ * @param node pointer to node
+ */
+void
+pairing_heap_remove(struct pairing_heap *heap, struct pairing_heap_node *node)
+{
+  struct pairing_heap_node *subtree;
+
+  if (node == heap->root) {
+    pairing_heap_extract_min(heap);
+    return;
+  }
+
+  int_pairing_heap_detach(node);
+  subtree = int_pairing_heap_merge_pairs(node->child);
+  node->child = NULL;
+
+  if (subtree) {
+    heap->root = int_pairing_heap_link(heap->root, subtree);
+  }
+  heap->count--;
+}
+
+/**
+ * internal function to link two heap roots. The root with the
+ * larger key becomes the leftmost child of the other one.
+ * On equal keys the first parameter stays on top.
+ * @param first pointer to first root node
+ * @param second pointer to second root node
+ * @return pointer to new root node
+ */
+static struct pairing_heap_node *
+int_pairing_heap_link(struct pairing_heap_node *first, struct pairing_heap_node *second)
+{
+  struct pairing_heap_node *parent, *child;
+
+  if (second->key < first->key) {
+    parent = second;
+    child = first;
+  }
+  else {
+    parent = first;
+    child = second;
+  }
+
+  child->prev = parent;
+  child->next = parent->child;
+  if (parent->child) {
+    parent->child->prev = child;
+  }
+  parent->child = child;
+
+  parent->prev = parent->next = NULL;
+  return parent;
+}
+
+/**
+ * internal function to cut a node (including its subtree)
+ * out of the list of its siblings.
+ * @param node pointer to node, must not be the root node
+ */
+static void
+int_pairing_heap_detach(struct pairing_heap_node *node)
+{
+  if (node->prev->child == node) {
+    /* leftmost child, prev points to parent */
+    node->prev->child = node->next;
+  }
+  else {
+    node->prev->next = node->next;
+  }
+
+  if (node->next) {
+    node->next->prev = node->prev;
+  }
+  node->prev = node->next = NULL;
+}
+
+/**
+ * internal function to combine a list of siblings into a single heap
+ * with the standard two-pass pairing scheme.
+ * @param first pointer to first sibling, might be NULL
+ * @return pointer to new root node, NULL if list was empty
+ */
+static struct pairing_heap_node *
+int_pairing_heap_merge_pairs(struct pairing_heap_node *first)
+{
+  struct pairing_heap_node *a, *b, *pairs = NULL, *root = NULL;
+
+  /* first pass: link pairs from left to right, keep them in reverse order */
+  while (first) {
+    a = first;
+    b = a->next;
+
+    if (b) {
+      first = b->next;
+      a = int_pairing_heap_link(a, b);
+    }
+    else {
+      first = NULL;
+      a->prev = NULL;
+    }
+
+    a->next = pairs;
+    pairs = a;
+  }
+
+  /* second pass: link the pairs from right to left */
+  while (pairs) {
+    a = pairs;
+    pairs = a->next;
+
+    a->next = NULL;
+    root = root ? int_pairing_heap_link(root, a) : a;
+  }
+  return root;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * End:
+ */
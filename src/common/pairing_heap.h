@@ -0,0 +1,158 @@
+
+/*
+ * The olsr.org Optimized Link-State Routing daemon(olsrd)
+ * Copyright (c) 2004-2011, the olsr.org team - see HISTORY file
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of olsr.org, olsrd nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Visit http://www.olsr.org for more information.
+ *
+ * If you find this software useful feel free to make a donation
+ * to the project. For more information see the website or contact
+ * the copyright holders.
+ *
+ */
+
+#ifndef _PAIRING_HEAP_H
+#define _PAIRING_HEAP_H
+
+#include <stddef.h>
+
+#include "common/common_types.h"
+#include "container_of.h"
+
+/**
+ * This element is a member of a pairing heap. It must be contained in all
+ * larger structs that should be put into a heap.
+ */
+struct pairing_heap_node {
+  /**
+   * Pointer to the leftmost child of this node
+   */
+  struct pairing_heap_node *child;
+
+  /**
+   * Pointer to the next sibling of this node
+   */
+  struct pairing_heap_node *next;
+
+  /**
+   * Pointer to the previous sibling of this node, to the parent if
+   * this is the leftmost child, NULL for the root node
+   */
+  struct pairing_heap_node *prev;
+
+  /**
+   * key of the node, smallest key is on top of the heap
+   */
+  uint32_t key;
+};
+
+/**
+ * This struct is the central management part of a pairing heap.
+ */
+struct pairing_heap {
+  /**
+   * pointer to the node with the smallest key, NULL if heap is empty
+   */
+  struct pairing_heap_node *root;
+
+  /**
+   * number of nodes in the heap
+   */
+  unsigned int count;
+};
+
+void EXPORT(pairing_heap_init)(struct pairing_heap *);
+void EXPORT(pairing_heap_insert)(struct pairing_heap *, struct pairing_heap_node *, uint32_t);
+void EXPORT(pairing_heap_decrease_key)(struct pairing_heap *, struct pairing_heap_node *, uint32_t);
+void EXPORT(pairing_heap_remove)(struct pairing_heap *, struct pairing_heap_node *);
+struct pairing_heap_node *EXPORT(pairing_heap_extract_min)(struct pairing_heap *);
+
+/**
+ * initialize a heap node
+ * @param node pointer to heap node
+ */
+static inline void
+pairing_heap_init_node(struct pairing_heap_node *node) {
+  node->child = node->next = node->prev = NULL;
+}
+
+/**
+ * @param heap pointer to pairing heap
+ * @return true if the heap is empty, false otherwise
+ */
+static inline bool
+pairing_heap_is_empty(struct pairing_heap *heap) {
+  return heap->root == NULL;
+}
+
+/**
+ * @param heap pointer to pairing heap
+ * @param node pointer to heap node
+ * @return true if node is part of the heap, false otherwise
+ */
+static inline bool
+pairing_heap_is_node_added(struct pairing_heap *heap, struct pairing_heap_node *node) {
+  return node->prev != NULL || heap->root == node;
+}
+
+/**
+ * @param heap pointer to pairing heap
+ * @param element pointer to a node element
+ *    (don't need to be initialized)
+ * @param node_member name of the pairing_heap_node element inside the
+ *    larger struct
+ * @return pointer to the element with the smallest key,
+ *    NULL if the heap is empty
+ */
+#define pairing_heap_first_element(heap, element, node_member) \
+  container_of_if_notnull((heap)->root, typeof(*(element)), node_member)
+
+/**
+ * Remove the element with the smallest key from the heap.
+ *
+ * @param heap pointer to pairing heap
+ * @param element pointer to a node element
+ *    (don't need to be initialized)
+ * @param node_member name of the pairing_heap_node element inside the
+ *    larger struct
+ * @return pointer to the removed element, NULL if the heap was empty
+ */
+#define pairing_heap_extract_min_element(heap, element, node_member) \
+  container_of_if_notnull(pairing_heap_extract_min(heap), typeof(*(element)), node_member)
+
+#endif /* _PAIRING_HEAP_H */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * End:
+ */
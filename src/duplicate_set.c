@@ -39,25 +39,36 @@
  *
  */
 
-#include "common/avl.h"
-#include "common/avl_olsr_comp.h"
 #include "duplicate_set.h"
+#include "hashing.h"
 #include "ipcalc.h"
 #include "olsr.h"
 #include "mid_set.h"
 #include "olsr_timer.h"
 #include "olsr_socket.h"
 #include "olsr_clock.h"
-#include "olsr_memcookie.h"
 #include "olsr_logging.h"
 
 #include <stdlib.h>
 
-struct avl_tree forward_set, processing_set;
+/*
+ * Open addressing hash table with linear probing, indexed by originator.
+ * Entries are only removed by the periodic sweep, which rebuilds the
+ * table, so no tombstones are necessary.
+ */
+static struct dup_entry *dup_table = NULL;
+static uint32_t dup_table_size = 0;
+static uint32_t dup_count = 0;
+
+/* current sweep bucket */
+static uint32_t dup_bucket = 0;
+
+/* last entry used, forwarding checks follow the processing checks */
+static struct dup_entry *dup_last_entry = NULL;
 
 /* Some cookies for stats keeping */
 static struct olsr_timer_info *duplicate_timer_info = NULL;
-static struct olsr_memcookie_info *duplicate_mem_cookie = NULL;
+static struct olsr_timer_entry *duplicate_sweep_timer = NULL;
 
 int
 olsr_seqno_diff(uint16_t reference, uint16_t other)
@@ -75,39 +86,90 @@ olsr_seqno_diff(uint16_t reference, uint16_t other)
   return diff;
 }
 
+/**
+ * Find the slot of an originator in a duplicate set hash table.
+ * @param table pointer to hash table
+ * @param size number of slots, must be a power of two
+ * @param ip originator address
+ * @return slot with the originator or empty slot where it should be
+ */
 static struct dup_entry *
-olsr_create_duplicate_entry(union olsr_ip_addr *ip, uint16_t seqnr)
+olsr_find_duplicate_slot(struct dup_entry *table, uint32_t size, const union olsr_ip_addr *ip)
 {
-  struct dup_entry *entry;
+  uint32_t idx;
 
-  entry = olsr_memcookie_malloc(duplicate_mem_cookie);
-  if (entry != NULL) {
-    memcpy(&entry->ip, ip, olsr_cnf->ip_version == AF_INET ? sizeof(entry->ip.v4) : sizeof(entry->ip.v6));
-    entry->seqnr = seqnr;
-    entry->too_low_counter = 0;
-    entry->avl.key = &entry->ip;
-    entry->array = 0;
+  idx = olsr_ip_hash(ip) & (size - 1);
+  while (table[idx].used && olsr_ipcmp(&table[idx].ip, ip) != 0) {
+    idx = (idx + 1) & (size - 1);
   }
-  return entry;
+  return &table[idx];
+}
+
+/**
+ * @param entry pointer to duplicate entry
+ * @return true if the entry has not been updated for the cleanup interval
+ */
+static bool
+olsr_is_duplicate_entry_expired(const struct dup_entry *entry)
+{
+  return dup_bucket - entry->bucket >= DUPLICATE_SWEEP_BUCKETS;
 }
 
+/**
+ * Move all valid entries into a new hash table.
+ * @param size number of slots of the new table, must be a power of two
+ */
 static void
-olsr_delete_duplicate_entry(struct dup_entry *entry)
+olsr_rebuild_duplicate_table(uint32_t size)
 {
-  avl_delete(entry->tree, &entry->avl);
-  entry->tree = NULL;
-  olsr_timer_stop(entry->validity_timer);
-  entry->validity_timer = NULL;
-  olsr_memcookie_free(duplicate_mem_cookie, entry);
+  struct dup_entry *old_table = dup_table;
+  uint32_t old_size = dup_table_size;
+  uint32_t i;
+
+  dup_table = olsr_malloc(sizeof(struct dup_entry) * size, "Duplicate set");
+  dup_table_size = size;
+  dup_count = 0;
+  dup_last_entry = NULL;
+
+  for (i = 0; i < old_size; i++) {
+    if (old_table[i].used && !olsr_is_duplicate_entry_expired(&old_table[i])) {
+      *olsr_find_duplicate_slot(dup_table, dup_table_size, &old_table[i].ip) = old_table[i];
+      dup_count++;
+    }
+  }
+  free(old_table);
 }
 
+/**
+ * Timer callback to start a new sweep bucket and remove all
+ * entries which have not been updated for the cleanup interval.
+ */
 static void
-olsr_expire_duplicate_entry(void *context)
+olsr_sweep_duplicate_set(void *context __attribute__ ((unused)))
 {
-  struct dup_entry *entry = context;
-  entry->validity_timer = NULL;
+  uint32_t i, valid, size;
+
+  dup_bucket++;
+
+  valid = 0;
+  for (i = 0; i < dup_table_size; i++) {
+    if (dup_table[i].used && !olsr_is_duplicate_entry_expired(&dup_table[i])) {
+      valid++;
+    }
+  }
+
+  if (valid == dup_count) {
+    return;
+  }
+
+  OLSR_DEBUG(LOG_DUPLICATE_SET, "Removing %u expired duplicate entries\n", dup_count - valid);
 
-  olsr_delete_duplicate_entry(entry);
+  /* shrink the table if possible, but keep room for growth */
+  size = DUPLICATE_MIN_TABLE_SIZE;
+  while (size < valid * 4) {
+    size <<= 1;
+  }
+  olsr_rebuild_duplicate_table(size < dup_table_size ? size : dup_table_size);
 }
 
 void
@@ -115,15 +177,16 @@ olsr_init_duplicate_set(void)
 {
   OLSR_INFO(LOG_DUPLICATE_SET, "Initialize duplicate set...\n");
 
-  avl_init(&forward_set, avl_comp_default, false, NULL);
-  avl_init(&processing_set, avl_comp_default, false, NULL);
+  dup_table = olsr_malloc(sizeof(struct dup_entry) * DUPLICATE_MIN_TABLE_SIZE, "Duplicate set");
+  dup_table_size = DUPLICATE_MIN_TABLE_SIZE;
+  dup_count = 0;
 
   /*
    * Get some cookies for getting stats to ease troubleshooting.
    */
-  duplicate_timer_info = olsr_timer_add("Duplicate Set", &olsr_expire_duplicate_entry, false);
+  duplicate_timer_info = olsr_timer_add("Duplicate Set", &olsr_sweep_duplicate_set, true);
 
-  duplicate_mem_cookie = olsr_memcookie_add("dup_entry", sizeof(struct dup_entry));
+  duplicate_sweep_timer = olsr_timer_start(DUPLICATE_SWEEP_INTERVAL, 0, NULL, duplicate_timer_info);
 }
 
 
@@ -133,21 +196,54 @@ olsr_init_duplicate_set(void)
 void
 olsr_flush_duplicate_entries(void)
 {
-  struct dup_entry *entry, *iterator;
+  olsr_timer_stop(duplicate_sweep_timer);
+  duplicate_sweep_timer = NULL;
+
+  free(dup_table);
+  dup_table = NULL;
+  dup_table_size = 0;
+  dup_count = 0;
+  dup_last_entry = NULL;
+}
+
+/**
+ * Lookup the duplicate entry of an originator, create it if necessary.
+ * @param ip originator address
+ * @return pointer to duplicate entry
+ */
+static struct dup_entry *
+olsr_get_duplicate_entry(const union olsr_ip_addr *ip)
+{
+  struct dup_entry *entry;
 
-  OLSR_FOR_ALL_FORWARD_DUP_ENTRIES(entry, iterator) {
-    olsr_delete_duplicate_entry(entry);
+  /* the forwarding check uses the entry of the processing check */
+  if (dup_last_entry != NULL && olsr_ipcmp(&dup_last_entry->ip, ip) == 0) {
+    return dup_last_entry;
   }
-  OLSR_FOR_ALL_PROCESS_DUP_ENTRIES(entry, iterator) {
-    olsr_delete_duplicate_entry(entry);
+
+  entry = olsr_find_duplicate_slot(dup_table, dup_table_size, ip);
+  if (!entry->used) {
+    /* keep the load factor below 50% */
+    if ((dup_count + 1) * 2 > dup_table_size) {
+      olsr_rebuild_duplicate_table(dup_table_size * 2);
+      entry = olsr_find_duplicate_slot(dup_table, dup_table_size, ip);
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    memcpy(&entry->ip, ip, olsr_cnf->ipsize);
+    entry->used = true;
+    dup_count++;
   }
+
+  dup_last_entry = entry;
+  return entry;
 }
 
 bool
 olsr_is_duplicate_message(struct olsr_message *m, bool forwarding, enum duplicate_status *status)
 {
-  struct avl_tree *tree;
   struct dup_entry *entry;
+  struct dup_state *state;
   int diff;
   enum duplicate_status dummy = 0;
 
@@ -159,38 +255,31 @@ olsr_is_duplicate_message(struct olsr_message *m, bool forwarding, enum duplicat
     status = &dummy;
   }
 
-  tree = forwarding ? &forward_set : &processing_set;
-
-  /* Check if entry exists */
-  entry = (struct dup_entry *)avl_find(tree, &m->originator);
-  if (entry == NULL) {
-    entry = olsr_create_duplicate_entry(&m->originator, m->seqno);
-    if (entry != NULL) {
-      avl_insert(tree, &entry->avl);
-      entry->tree = tree;
-      entry->validity_timer = olsr_timer_start(DUPLICATE_CLEANUP_INTERVAL, DUPLICATE_CLEANUP_JITTER,
-                                               entry, duplicate_timer_info);
-    }
+  entry = olsr_get_duplicate_entry(&m->originator);
+
+  /* Refresh entry */
+  entry->bucket = dup_bucket;
+
+  state = forwarding ? &entry->forward : &entry->processing;
+  if (!state->valid) {
+    state->valid = true;
+    state->seqnr = m->seqno;
+    state->array = 1;
 
     *status = NEW_OLSR_MESSAGE;
     return false;               // okay, we process this package
   }
 
-  /*
-   * Refresh timer.
-   */
-  olsr_timer_change(entry->validity_timer, DUPLICATE_CLEANUP_INTERVAL, DUPLICATE_CLEANUP_JITTER);
-
-  diff = olsr_seqno_diff(m->seqno, entry->seqnr);
+  diff = olsr_seqno_diff(m->seqno, state->seqnr);
 
   if (diff < -31) {
-    entry->too_low_counter++;
+    state->too_low_counter++;
 
     // client did restart with a lower number ?
-    if (entry->too_low_counter > 16) {
-      entry->too_low_counter = 0;
-      entry->seqnr = m->seqno;
-      entry->array = 1;
+    if (state->too_low_counter > 16) {
+      state->too_low_counter = 0;
+      state->seqnr = m->seqno;
+      state->array = 1;
 
       /* start with a new sequence number, so NO duplicate */
       *status = RESET_SEQNO_OLSR_MESSAGE;
@@ -203,31 +292,31 @@ olsr_is_duplicate_message(struct olsr_message *m, bool forwarding, enum duplicat
     return true;
   }
 
-  entry->too_low_counter = 0;
+  state->too_low_counter = 0;
   if (diff <= 0) {
     uint32_t bitmask = 1 << ((uint32_t) (-diff));
 
-    if ((entry->array & bitmask) != 0) {
+    if ((state->array & bitmask) != 0) {
       OLSR_DEBUG(LOG_DUPLICATE_SET, "blocked %x (diff=%d,mask=%08x) from %s\n", m->seqno, diff,
-                 entry->array, olsr_ip_to_string(&buf, &m->originator));
+                 state->array, olsr_ip_to_string(&buf, &m->originator));
 
       /* duplicate ! */
       *status = DUPLICATE_OLSR_MESSAGE;
       return true;
     }
-    entry->array |= bitmask;
+    state->array |= bitmask;
     OLSR_DEBUG(LOG_DUPLICATE_SET, "processed %x from %s\n", m->seqno, olsr_ip_to_string(&buf, &m->originator));
 
     /* no duplicate */
     *status = OLD_OLSR_MESSAGE;
     return false;
   } else if (diff < 32) {
-    entry->array <<= (uint32_t) diff;
+    state->array <<= (uint32_t) diff;
   } else {
-    entry->array = 0;
+    state->array = 0;
   }
-  entry->array |= 1;
-  entry->seqnr = m->seqno;
+  state->array |= 1;
+  state->seqnr = m->seqno;
   OLSR_DEBUG(LOG_DUPLICATE_SET, "processed %x from %s\n", m->seqno, olsr_ip_to_string(&buf, &m->originator));
 
   /* no duplicate */
@@ -242,27 +331,27 @@ olsr_print_duplicate_table(void)
   /* The whole function makes no sense without it. */
   struct timeval_buf timebuf;
   struct ipaddr_str addrbuf;
-  struct dup_entry *entry, *iterator;
+  struct dup_entry *entry;
   const int ipwidth = olsr_cnf->ip_version == AF_INET ? 15 : 30;
+  uint32_t i, vtime;
 
-  OLSR_INFO(LOG_DUPLICATE_SET, "\n--- %s ------------------------------------------------- DUPLICATE SET (forwarding)\n\n",
+  OLSR_INFO(LOG_DUPLICATE_SET, "\n--- %s ------------------------------------------------- DUPLICATE SET\n\n",
             olsr_clock_getWallclockString(&timebuf));
-  OLSR_INFO_NH(LOG_DUPLICATE_SET, "%-*s %8s %s\n", ipwidth, "Node IP", "DupArray", "VTime");
+  OLSR_INFO_NH(LOG_DUPLICATE_SET, "%-*s %8s %8s %s\n", ipwidth, "Node IP", "FwdArray", "ProArray", "VTime");
 
-  OLSR_FOR_ALL_FORWARD_DUP_ENTRIES(entry, iterator) {
-    OLSR_INFO_NH(LOG_DUPLICATE_SET, "%-*s %08x %s\n",
-                 ipwidth, olsr_ip_to_string(&addrbuf, entry->avl.key), entry->array,
-                 olsr_clock_toClockString(&timebuf, entry->validity_timer->timer_clock));
-  }
+  for (i = 0; i < dup_table_size; i++) {
+    entry = &dup_table[i];
+    if (!entry->used) {
+      continue;
+    }
 
-  OLSR_INFO(LOG_DUPLICATE_SET, "\n--- %s ------------------------------------------------- DUPLICATE SET (processing)\n\n",
-              olsr_clock_getWallclockString(&timebuf));
-  OLSR_INFO_NH(LOG_DUPLICATE_SET, "%-*s %8s %s\n", ipwidth, "Node IP", "DupArray", "VTime");
+    /* the entry expires with the sweep which reaches the last bucket */
+    vtime = duplicate_sweep_timer->timer_clock
+        + (DUPLICATE_SWEEP_BUCKETS - 1 - (dup_bucket - entry->bucket)) * DUPLICATE_SWEEP_INTERVAL;
 
-  OLSR_FOR_ALL_PROCESS_DUP_ENTRIES(entry, iterator) {
-    OLSR_INFO_NH(LOG_DUPLICATE_SET, "%-*s %08x %s\n",
-                 ipwidth, olsr_ip_to_string(&addrbuf, entry->avl.key), entry->array,
-                 olsr_clock_toClockString(&timebuf, entry->validity_timer->timer_clock));
+    OLSR_INFO_NH(LOG_DUPLICATE_SET, "%-*s %08x %08x %s\n",
+                 ipwidth, olsr_ip_to_string(&addrbuf, &entry->ip), entry->forward.array, entry->processing.array,
+                 olsr_clock_toClockString(&timebuf, vtime));
   }
 #endif
 }
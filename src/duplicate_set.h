@@ -45,20 +45,32 @@
 #include "defs.h"
 #include "olsr.h"
 #include "olsr_clock.h"
-#include "common/avl.h"
 
 #define DUPLICATE_CLEANUP_INTERVAL 30000
-#define DUPLICATE_CLEANUP_JITTER 25
 #define DUPLICATE_VTIME 120000
 
-struct dup_entry {
-  struct avl_node avl;
-  union olsr_ip_addr ip;
+/* entries are expired by a periodic sweep over coarse time buckets */
+#define DUPLICATE_SWEEP_INTERVAL 5000
+#define DUPLICATE_SWEEP_BUCKETS (DUPLICATE_CLEANUP_INTERVAL / DUPLICATE_SWEEP_INTERVAL)
+
+/* minimum number of slots of the hash table, must be a power of two */
+#define DUPLICATE_MIN_TABLE_SIZE 64
+
+/* duplicate detection state for either processing or forwarding */
+struct dup_state {
+  uint32_t array;
   uint16_t seqnr;
   uint16_t too_low_counter;
-  uint32_t array;
-  struct olsr_timer_entry *validity_timer;
-  struct avl_tree *tree;               /* backpointer to owning tree */
+  bool valid;
+};
+
+/* slot of the duplicate set hash table, one per originator */
+struct dup_entry {
+  union olsr_ip_addr ip;
+  uint32_t bucket;                     /* sweep bucket of the last update */
+  bool used;                           /* slot is in use */
+  struct dup_state forward;
+  struct dup_state processing;
 };
 
 enum duplicate_status {
@@ -76,10 +88,6 @@ bool olsr_is_duplicate_message(struct olsr_message *m, bool forward_set, enum du
 void olsr_print_duplicate_table(void);
 void olsr_flush_duplicate_entries(void);
 
-#define OLSR_FOR_ALL_FORWARD_DUP_ENTRIES(dup, iterator) avl_for_each_element_safe(&forward_set, dup, avl, iterator)
-#define OLSR_FOR_ALL_PROCESS_DUP_ENTRIES(dup, iterator) avl_for_each_element_safe(&processing_set, dup, avl, iterator)
-
-extern struct avl_tree forward_set, processing_set;
 #endif /*DUPLICATE_SET_H_ */
 
 /*
@@ -126,12 +126,13 @@ jenkins_hash(const uint8_t * k, uint32_t length)
 
 
 /**
- * Hashing function. Creates a key based on an IP address.
+ * Hashing function. Creates a 32 bit key based on an IP address,
+ * for hash tables with their own size.
  * @param address the address to hash
- * @return the hash(a value in the (0 to HASHMASK-1) range)
+ * @return the hash
  */
 uint32_t
-olsr_ip_hashing(const union olsr_ip_addr * address)
+olsr_ip_hash(const union olsr_ip_addr * address)
 {
   uint32_t hash;
 
@@ -147,7 +148,18 @@ olsr_ip_hashing(const union olsr_ip_addr * address)
     break;
 
   }
-  return hash & HASHMASK;
+  return hash;
+}
+
+/**
+ * Hashing function. Creates a key based on an IP address.
+ * @param address the address to hash
+ * @return the hash(a value in the (0 to HASHMASK-1) range)
+ */
+uint32_t
+olsr_ip_hashing(const union olsr_ip_addr * address)
+{
+  return olsr_ip_hash(address) & HASHMASK;
 }
 
 /*
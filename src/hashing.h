@@ -48,6 +48,7 @@
 
 #include "olsr_types.h"
 
+uint32_t EXPORT(olsr_ip_hash) (const union olsr_ip_addr *);
 uint32_t EXPORT(olsr_ip_hashing) (const union olsr_ip_addr *);
 
 #endif
@@ -66,6 +66,7 @@ olsr_init_hna_set(void)
   OLSR_INFO(LOG_HNA, "Initialize HNA set...\n");
 
   hna_net_timer_info = olsr_timer_add("HNA Network", &olsr_expire_hna_net_entry, false);
+  hna_net_timer_info->coalescing = OLSR_TIMER_VALIDITY_COALESCING;
 
   hna_net_mem_cookie = olsr_memcookie_add("hna_net", sizeof(struct hna_net));
 }
@@ -335,13 +336,16 @@ void
 generate_hna(void *p __attribute__ ((unused))) {
   struct interface *ifp, *ifp_iterator;
   struct ip_prefix_entry *h, *h_iterator;
-  uint8_t msg_buffer[MAXMESSAGESIZE - OLSR_HEADERSIZE] __attribute__ ((aligned));
-  uint8_t *curr = msg_buffer;
+  struct olsr_packet_buffer *pktbuf;
+  uint8_t *msg_buffer, *curr;
   uint8_t *length_field, *last;
   bool sendHNA = false;
 
   OLSR_INFO(LOG_PACKET_CREATION, "Building HNA\n-------------------\n");
 
+  pktbuf = net_alloc_packet_buffer();
+  msg_buffer = curr = pktbuf->data;
+
   pkt_put_u8(&curr, HNA_MESSAGE);
   pkt_put_reltime(&curr, olsr_cnf->hna_params.validity_time);
 
@@ -354,7 +358,7 @@ generate_hna(void *p __attribute__ ((unused))) {
   pkt_put_u8(&curr, 0);
   pkt_put_u16(&curr, get_msg_seqno());
 
-  last = msg_buffer + sizeof(msg_buffer) - olsr_cnf->ipsize;
+  last = msg_buffer + MAXMESSAGESIZE - OLSR_HEADERSIZE - olsr_cnf->ipsize;
   OLSR_FOR_ALL_IPPREFIX_ENTRIES(&olsr_cnf->hna_entries, h, h_iterator) {
     union olsr_ip_addr subnet;
 
@@ -364,19 +368,14 @@ generate_hna(void *p __attribute__ ((unused))) {
     pkt_put_ipaddress(&curr, &subnet);
   }
 
-  if (!sendHNA) {
-    return;
-  }
-
-  pkt_put_u16(&length_field, curr - msg_buffer);
+  if (sendHNA) {
+    pkt_put_u16(&length_field, curr - msg_buffer);
 
-  OLSR_FOR_ALL_INTERFACES(ifp, ifp_iterator) {
-    if (net_outbuffer_bytes_left(ifp) < curr - msg_buffer) {
-      net_output(ifp);
-      set_buffer_timer(ifp);
+    OLSR_FOR_ALL_INTERFACES(ifp, ifp_iterator) {
+      net_schedule_message(ifp, msg_buffer, curr - msg_buffer, OLSR_PRIO_LOCAL, pktbuf);
     }
-    net_outbuffer_push(ifp, msg_buffer, curr - msg_buffer);
   }
+  net_unlock_packet_buffer(pktbuf);
 }
 
 /*
@@ -53,6 +53,7 @@
 #include "ipcalc.h"
 #include "olsr_logging.h"
 #include "os_net.h"
+#include "hashing.h"
 
 #include <signal.h>
 #include <unistd.h>
@@ -68,6 +69,18 @@ const char *INTERFACE_MODE_NAMES[] = {
 /* The interface list head */
 struct list_entity interface_head;
 
+/*
+ * Interfaces indexed by socket, local address and kernel interface index.
+ * The socket index is an array with one slot per filedescriptor, the
+ * other two are hash tables. All of them are kept in sync with the
+ * interface list by add_interface(), remove_interface() and
+ * reindex_interface().
+ */
+static struct interface **interface_fd_index = NULL;
+static int interface_fd_index_size = 0;
+static struct list_entity interface_addr_hash[HASHSIZE];
+static struct list_entity interface_ifindex_hash[HASHSIZE];
+
 /* tree of lost interface IPs */
 struct avl_tree interface_lost_tree;
 
@@ -88,6 +101,78 @@ static struct olsr_timer_info *hello_gen_timerinfo = NULL;
 
 static void check_interface_updates(void *);
 
+/**
+ * Calculate the hash bucket of a kernel interface index
+ * @param if_index interface index
+ * @return hash bucket
+ */
+static INLINE uint32_t
+interface_ifindex_hashing(int if_index)
+{
+  return (uint32_t)if_index & HASHMASK;
+}
+
+/**
+ * Link an interface into the filedescriptor index
+ * @param ifp pointer to interface
+ * @param fd filedescriptor of one of its sockets
+ */
+static void
+add_interface_fd(struct interface *ifp, int fd)
+{
+  struct interface **new_index;
+  int size;
+
+  assert(fd >= 0);
+
+  if (fd >= interface_fd_index_size) {
+    size = interface_fd_index_size > 0 ? interface_fd_index_size : 16;
+    while (fd >= size) {
+      size *= 2;
+    }
+
+    new_index = olsr_malloc(size * sizeof(*new_index), "Interface fd index");
+    if (interface_fd_index) {
+      memcpy(new_index, interface_fd_index, interface_fd_index_size * sizeof(*new_index));
+      free(interface_fd_index);
+    }
+    interface_fd_index = new_index;
+    interface_fd_index_size = size;
+  }
+  interface_fd_index[fd] = ifp;
+}
+
+/**
+ * Remove an interface from the filedescriptor index
+ * @param ifp pointer to interface
+ * @param fd filedescriptor of one of its sockets
+ */
+static void
+remove_interface_fd(struct interface *ifp, int fd)
+{
+  if (fd >= 0 && fd < interface_fd_index_size && interface_fd_index[fd] == ifp) {
+    interface_fd_index[fd] = NULL;
+  }
+}
+
+/**
+ * Update the address and interface index hash tables of an interface.
+ * Must be called after the IP address or the kernel index
+ * of an active interface has changed.
+ * @param ifp pointer to interface
+ */
+void
+reindex_interface(struct interface *ifp)
+{
+  if (list_node_added(&ifp->int_addr_node)) {
+    list_remove(&ifp->int_addr_node);
+    list_remove(&ifp->int_index_node);
+  }
+
+  list_add_tail(&interface_addr_hash[olsr_ip_hashing(&ifp->ip_addr)], &ifp->int_addr_node);
+  list_add_tail(&interface_ifindex_hash[interface_ifindex_hashing(ifp->if_index)], &ifp->int_index_node);
+}
+
 /**
  * Do initialization of various data needed for network interface management.
  * This function also tries to set up the given interfaces.
@@ -98,9 +183,14 @@ bool
 init_interfaces(void)
 {
   struct olsr_if_config *tmp_if;
+  int i;
 
   /* Initial values */
   list_init_head(&interface_head);
+  for (i = 0; i < HASHSIZE; i++) {
+    list_init_head(&interface_addr_hash[i]);
+    list_init_head(&interface_ifindex_hash[i]);
+  }
   avl_init(&interface_lost_tree, avl_comp_default, false, NULL);
 
   /*
@@ -178,6 +268,10 @@ void destroy_interfaces(void) {
   OLSR_FOR_ALL_LOSTIF_ENTRIES(lost, lost_iterator) {
     remove_lost_interface_ip(lost);
   }
+
+  free(interface_fd_index);
+  interface_fd_index = NULL;
+  interface_fd_index_size = 0;
 }
 
 struct interface *
@@ -203,7 +297,7 @@ add_interface(struct olsr_if_config *iface) {
   set_buffer_timer(ifp);
 
   /* Register sockets */
-  ifp->olsr_socket = olsr_socket_add(sock_rcv, &olsr_input, NULL, OLSR_SOCKET_READ);
+  ifp->olsr_socket = olsr_socket_add(sock_rcv, &olsr_input, ifp, OLSR_SOCKET_READ);
   // ifp->send_socket = olsr_socket_add(sock_send, &olsr_input, NULL, OLSR_SOCKET_READ);
   ifp->send_socket_fd = sock_send;
 
@@ -263,6 +357,11 @@ add_interface(struct olsr_if_config *iface) {
   /* Queue */
   list_add_before(&interface_head, &ifp->int_node);
 
+  /* Index */
+  add_interface_fd(ifp, sock_rcv);
+  add_interface_fd(ifp, sock_send);
+  reindex_interface(ifp);
+
   return ifp;
 }
 
@@ -330,6 +429,10 @@ remove_interface(struct interface *ifp)
 
   /* Dequeue */
   list_remove(&ifp->int_node);
+  list_remove(&ifp->int_addr_node);
+  list_remove(&ifp->int_index_node);
+  remove_interface_fd(ifp, ifp->olsr_socket->fd);
+  remove_interface_fd(ifp, ifp->send_socket_fd);
 
   /* Remove output buffer */
   net_remove_buffer(ifp);
@@ -391,12 +494,12 @@ run_ifchg_cbs(struct interface *ifp, int flag)
 struct interface *
 if_ifwithaddr(const union olsr_ip_addr *addr)
 {
-  struct interface *ifp, *iterator;
+  struct interface *ifp;
   if (!addr) {
     return NULL;
   }
 
-  OLSR_FOR_ALL_INTERFACES(ifp, iterator) {
+  list_for_each_element(&interface_addr_hash[olsr_ip_hashing(addr)], ifp, int_addr_node) {
     if (olsr_ipcmp(&ifp->ip_addr, addr) == 0) {
       return ifp;
     }
@@ -405,27 +508,19 @@ if_ifwithaddr(const union olsr_ip_addr *addr)
 }
 
 /**
- * Find the interface with a given number.
+ * Find the interface with a given socket.
  *
- * @param nr the number of the interface to find.
+ * @param fd the filedescriptor of the receive or send socket.
  * @return return the interface struct representing the interface
- * that matched the number.
+ * that owns the socket.
  */
 struct interface *
 if_ifwithsock(int fd)
 {
-  struct interface *ifp, *iterator;
-
-  OLSR_FOR_ALL_INTERFACES(ifp, iterator) {
-    if (ifp->olsr_socket->fd == fd) {
-      return ifp;
-    }
-    if (ifp->send_socket_fd == fd) {
-      return ifp;
-    }
+  if (fd < 0 || fd >= interface_fd_index_size) {
+    return NULL;
   }
-
-  return NULL;
+  return interface_fd_index[fd];
 }
 
 
@@ -461,8 +556,9 @@ if_ifwithname(const char *if_name)
 struct interface *
 if_ifwithindex(const int if_index)
 {
-  struct interface *ifp, *iterator;
-  OLSR_FOR_ALL_INTERFACES(ifp, iterator) {
+  struct interface *ifp;
+
+  list_for_each_element(&interface_ifindex_hash[interface_ifindex_hashing(if_index)], ifp, int_index_node) {
     if (ifp->if_index == if_index) {
       return ifp;
     }
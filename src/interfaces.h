@@ -126,6 +126,37 @@ struct if_gen_property {
 
 extern const char *INTERFACE_MODE_NAMES[];
 
+/* maximum number of forwarded messages referenced by an output buffer */
+#define OLSR_NETBUF_FORWARDS 16
+
+struct olsr_packet_buffer;
+
+/*
+ * Forwarded message referenced by an output buffer. The message is
+ * sent directly from the buffer of the received packet.
+ */
+struct olsr_netbuf_forward {
+  struct olsr_packet_buffer *pktbuf;   /* received packet containing the message */
+  uint8_t *data;                       /* start of the message */
+  uint16_t size;                       /* length of the message */
+  uint16_t offset;                     /* copied bytes in front of the message */
+};
+
+/* maximum number of messages waiting for the output scheduler of an interface */
+#define OLSR_NETBUF_SCHEDULED 32
+
+/*
+ * Message waiting for the output scheduler. The message is stored
+ * in a packet buffer, either the received packet (forwarding) or a
+ * copy of a generated message.
+ */
+struct olsr_netbuf_message {
+  struct olsr_packet_buffer *pktbuf;   /* packet buffer containing the message */
+  uint8_t *data;                       /* start of the message */
+  uint16_t size;                       /* length of the message */
+  uint8_t priority;                    /* priority class, see enum olsr_output_priority */
+};
+
 /*
  * Output buffer structure. This should actually be in net_olsr.h
  * but we have circular references then.
@@ -135,7 +166,22 @@ struct olsr_netbuf {
   int bufsize;                         /* Size of the buffer */
   int maxsize;                         /* Max bytes of payload that can be added */
   int pending;                         /* How much data is currently pending */
+  int copied;                          /* How much of the pending data is stored in buff */
   int reserved;                        /* Plugins can reserve space in buffers */
+
+  /* forwarded messages which are part of the pending data */
+  int forward_count;
+  struct olsr_netbuf_forward forward[OLSR_NETBUF_FORWARDS];
+
+  /* messages waiting for the output scheduler */
+  int scheduled_count;
+  int scheduled_bytes;
+  struct olsr_netbuf_message scheduled[OLSR_NETBUF_SCHEDULED];
+
+  /* packing statistics */
+  uint32_t stat_packets;               /* number of packets sent */
+  uint32_t stat_messages;              /* number of messages sent */
+  uint64_t stat_bytes;                 /* payload bytes sent */
 };
 
 /**
@@ -145,6 +191,10 @@ struct olsr_netbuf {
 struct interface {
   struct list_entity int_node;         /* List of all interfaces */
 
+  /* hash buckets for the address and interface index lookups */
+  struct list_entity int_addr_node;
+  struct list_entity int_index_node;
+
   /* backpointer */
   struct olsr_if_config *if_cfg;
 
@@ -227,6 +277,7 @@ bool EXPORT(is_lost_interface_ip)(union olsr_ip_addr *ip);
 void destroy_interfaces(void);
 struct interface *add_interface(struct olsr_if_config *iface);
 void remove_interface(struct interface *);
+void EXPORT(reindex_interface)(struct interface *);
 void run_ifchg_cbs(struct interface *, int);
 struct interface *if_ifwithsock(int);
 struct interface *EXPORT(if_ifwithaddr) (const union olsr_ip_addr *);
@@ -56,6 +56,7 @@
 #include "lq_plugin.h"
 #include "common/string.h"
 #include "olsr_logging.h"
+#include "hashing.h"
 
 #include <assert.h>
 
@@ -66,6 +67,9 @@ static void olsr_expire_link_sym_timer(void *context);
 /* head node for all link sets */
 struct list_entity link_entry_head;
 
+/* link entries hashed by neighbor interface address */
+static struct list_entity link_entry_hash[HASHSIZE];
+
 static struct olsr_timer_info *link_dead_timer_info = NULL;
 static struct olsr_timer_info *link_loss_timer_info = NULL;
 static struct olsr_timer_info *link_sym_timer_info = NULL;
@@ -87,10 +91,15 @@ static struct link_entry *add_link_entry(const union olsr_ip_addr *,
 void
 olsr_init_link_set(void)
 {
+  int i;
+
   OLSR_INFO(LOG_LINKS, "Initialize linkset...\n");
 
   /* Init list head */
   list_init_head(&link_entry_head);
+  for (i = 0; i < HASHSIZE; i++) {
+    list_init_head(&link_entry_hash[i]);
+  }
 
   link_dead_timer_info = olsr_timer_add("Link dead", &olsr_expire_link_entry, false);
   link_loss_timer_info = olsr_timer_add("Link loss", &olsr_expire_link_loss_timer, true);
@@ -242,6 +251,7 @@ olsr_delete_link_entry(struct link_entry *link)
   link->link_loss_timer = NULL;
 
   list_remove(&link->link_list);
+  list_remove(&link->link_hash_node);
 
   /* Unlink Interfaces */
   unlock_interface(link->inter);
@@ -423,6 +433,7 @@ add_link_entry(const union olsr_ip_addr *local,
 
   /* Add to queue */
   list_add_before(&link_entry_head, &link->link_list);
+  list_add_tail(&link_entry_hash[olsr_ip_hashing(remote)], &link->link_hash_node);
 
 
   /*
@@ -462,9 +473,9 @@ add_link_entry(const union olsr_ip_addr *local,
 int
 check_neighbor_link(const union olsr_ip_addr *int_addr)
 {
-  struct link_entry *link, *iterator;
+  struct link_entry *link;
 
-  OLSR_FOR_ALL_LINK_ENTRIES(link, iterator) {
+  list_for_each_element(&link_entry_hash[olsr_ip_hashing(int_addr)], link, link_hash_node) {
     if (olsr_ipcmp(int_addr, &link->neighbor_iface_addr) == 0) {
       return lookup_link_status(link);
     }
@@ -484,9 +495,9 @@ check_neighbor_link(const union olsr_ip_addr *int_addr)
 struct link_entry *
 lookup_link_entry(const union olsr_ip_addr *remote, const union olsr_ip_addr *remote_main, const struct interface *local)
 {
-  struct link_entry *link, *iterator;
+  struct link_entry *link;
 
-  OLSR_FOR_ALL_LINK_ENTRIES(link, iterator) {
+  list_for_each_element(&link_entry_hash[olsr_ip_hashing(remote)], link, link_hash_node) {
     if (olsr_ipcmp(remote, &link->neighbor_iface_addr) == 0 && (link->if_name ? !strcmp(link->if_name, local->int_name)
                                                                 : olsr_ipcmp(&local->ip_addr, &link->local_iface_addr) == 0)) {
       /* check the remote-main address only if there is one given */
@@ -730,14 +741,18 @@ olsr_update_packet_loss(struct link_entry *entry)
 void
 generate_hello(void *p) {
   struct interface *ifp = p;
-  uint8_t msg_buffer[MAXMESSAGESIZE - OLSR_HEADERSIZE] __attribute__ ((aligned));
+  struct olsr_packet_buffer *pktbuf;
   struct olsr_message msg;
-  uint8_t *curr = msg_buffer;
+  uint8_t *msg_buffer, *curr;
   uint8_t *length_field, *last;
   struct link_entry *link, *iterator;
   uint8_t writeLinkType, writeNeighType;
   OLSR_INFO(LOG_PACKET_CREATION, "Building Hello for %s\n-------------------\n", ifp->int_name);
 
+  /* build the message directly in a packet buffer, the scheduler references it */
+  pktbuf = net_alloc_packet_buffer();
+  msg_buffer = curr = pktbuf->data;
+
   msg.type = olsr_get_Hello_MessageId();
   msg.vtime = ifp->hello_validity;
   msg.size = 0; /* fill in later */
@@ -752,7 +767,7 @@ generate_hello(void *p) {
   pkt_put_reltime(&curr, ifp->hello_interval);
   pkt_put_u8(&curr, olsr_cnf->willingness);
 
-  last = msg_buffer + sizeof(msg_buffer) - olsr_cnf->ipsize;
+  last = msg_buffer + MAXMESSAGESIZE - OLSR_HEADERSIZE - olsr_cnf->ipsize;
 
   /* first calculate local link status */
   OLSR_FOR_ALL_LINK_ENTRIES(link, iterator) {
@@ -809,12 +824,9 @@ generate_hello(void *p) {
   /* fix length field of message */
   pkt_put_u16(&length_field, curr - msg_buffer);
 
-  /* send hello immediately */
-  if (net_outbuffer_bytes_left(ifp) < curr - msg_buffer) {
-    net_output(ifp);
-  }
-  net_outbuffer_push(ifp, msg_buffer, curr - msg_buffer);
-  net_output(ifp);
+  /* send hello immediately, together with all waiting messages */
+  net_schedule_message(ifp, msg_buffer, curr - msg_buffer, OLSR_PRIO_HELLO, pktbuf);
+  net_unlock_packet_buffer(pktbuf);
 }
 /*
  * Local Variables:
@@ -85,6 +85,7 @@ struct link_entry {
   olsr_linkcost linkcost;
 
   struct list_entity link_list;          /* double linked list of all link entries */
+  struct list_entity link_hash_node;     /* hash bucket of the neighbor interface address */
 };
 
 #define OLSR_LINK_JITTER       5        /* percent */
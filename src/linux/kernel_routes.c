@@ -57,8 +57,14 @@
 #include <assert.h>
 #include <errno.h>
 
+#include "common/avl.h"
+#include "common/avl_olsr_comp.h"
 #include "interfaces.h"
 #include "olsr_logging.h"
+#include "olsr_memcookie.h"
+#include "olsr_socket.h"
+#include "olsr_timer.h"
+#include "process_routes.h"
 #include "os_net.h"
 #include "os_kernel_routes.h"
 
@@ -71,7 +77,7 @@
  * from /usr/include/linux/netlink.h and adapted for ARM
  */
 #define MY_NLMSG_NEXT(nlh,len)   ((len) -= NLMSG_ALIGN((nlh)->nlmsg_len), \
-          (struct nlmsghdr*)ARM_NOWARN_ALIGN((((char*)(nlh)) + NLMSG_ALIGN((nlh)->nlmsg_len)))
+          (struct nlmsghdr*)ARM_NOWARN_ALIGN((((char*)(nlh)) + NLMSG_ALIGN((nlh)->nlmsg_len))))
 
 
 static void rtnetlink_read(int sock, void *, unsigned int);
@@ -88,6 +94,61 @@ struct olsr_ipadd_req {
   char buf[256];
 };
 
+/*
+ * Batched route updates. Route messages are collected in a buffer
+ * and sent to the kernel with a single sendmsg() call. The acks are
+ * collected afterwards without blocking. The number of messages per
+ * batch is limited to keep all acks within the socket receive buffer.
+ */
+#define NETLINK_BATCH_SIZE 16384
+#define NETLINK_BATCH_MSGS 128
+
+struct olsr_netlink_batch {
+  uint32_t buffer[NETLINK_BATCH_SIZE / sizeof(uint32_t)];
+  size_t len;
+  unsigned int count;
+  uint32_t first_seq;
+  uint16_t offset[NETLINK_BATCH_MSGS];
+  bool retry[NETLINK_BATCH_MSGS];
+};
+
+static struct olsr_netlink_batch netlink_batch[2];
+
+/* messages waiting to be sent and messages waiting for their acks */
+static struct olsr_netlink_batch *batch_queue = &netlink_batch[0];
+static struct olsr_netlink_batch *batch_sent = &netlink_batch[1];
+
+static bool batch_active = false;
+static uint32_t netlink_seq = 0;
+static struct olsr_socket_entry *netlink_socket = NULL;
+
+/*
+ * Routes of a previous olsrd instance found in the kernel at startup.
+ * They are adopted if the first RIB calculations produce the same
+ * route and deleted if they are still unused after the validity time
+ * of the topology information.
+ */
+struct olsr_fib_entry {
+  struct avl_node node;
+  struct olsr_ip_prefix dst;
+  union olsr_ip_addr gw;
+  bool has_gw;
+  int family;
+  int table;
+  int if_index;
+  int metric;
+};
+
+static struct avl_tree fib_stale_tree;
+static struct olsr_memcookie_info *fib_stale_cookie = NULL;
+static struct olsr_timer_info *fib_stale_timer_info = NULL;
+static struct olsr_timer_entry *fib_stale_timer = NULL;
+
+static void olsr_netlink_flush(void);
+static void olsr_build_netlink_route(struct olsr_rtreq *req, int family, int rttable, int if_index,
+    int metric, int protocol, const union olsr_ip_addr *src, const union olsr_ip_addr *gw,
+    const struct olsr_ip_prefix *dst, bool set, bool del_similar);
+
 int rtnetlink_register_socket(int rtnl_mgrp)
 {
   int sock = socket(AF_NETLINK,SOCK_RAW,NETLINK_ROUTE);
@@ -213,18 +274,286 @@ olsr_netlink_addreq(struct nlmsghdr *n, size_t reqSize __attribute__ ((unused)),
   memcpy(RTA_DATA(rta), data, len);
 }
 
-/*rt_entry and nexthop and family and table must only be specified with an flag != RT_NONE  && != RT_LO_IP*/
+/**
+ * Parse the destination of a route message.
+ * @param n pointer to netlink message
+ * @param dst pointer to target prefix
+ */
+static void
+olsr_netlink_get_dst(const struct nlmsghdr *n, struct olsr_ip_prefix *dst)
+{
+  const struct rtmsg *r = NLMSG_DATA(n);
+  const struct rtattr *rta;
+  int len;
+
+  memset(dst, 0, sizeof(*dst));
+  dst->prefix_len = r->rtm_dst_len;
+
+  len = RTM_PAYLOAD(n);
+  for (rta = RTM_RTA(r); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+    if (rta->rta_type == RTA_DST && RTA_PAYLOAD(rta) <= sizeof(dst->prefix)) {
+      memcpy(&dst->prefix, RTA_DATA(rta), RTA_PAYLOAD(rta));
+    }
+  }
+}
+
+/**
+ * Add a netlink message to the batch queue.
+ * @param n pointer to netlink message
+ * @param retry true if this message is already a retry
+ * @return -1 if there was no space left in the batch, 0 otherwise
+ */
 static int
-olsr_netlink_send(struct nlmsghdr *nl_hdr)
+olsr_netlink_queue(struct nlmsghdr *n, bool retry)
+{
+  if (batch_queue->count == NETLINK_BATCH_MSGS
+      || batch_queue->len + NLMSG_ALIGN(n->nlmsg_len) > sizeof(batch_queue->buffer)) {
+    return -1;
+  }
+
+  n->nlmsg_seq = ++netlink_seq;
+  if (batch_queue->count == 0) {
+    batch_queue->first_seq = n->nlmsg_seq;
+  }
+
+  batch_queue->offset[batch_queue->count] = batch_queue->len;
+  batch_queue->retry[batch_queue->count] = retry;
+  batch_queue->count++;
+
+  memcpy((char *)batch_queue->buffer + batch_queue->len, n, n->nlmsg_len);
+  batch_queue->len += NLMSG_ALIGN(n->nlmsg_len);
+  return 0;
+}
+
+/**
+ * Handle the error of a batched route message.
+ * A failed route addition with 'File exists' is retried once after
+ * deleting similar routes, all other errors are reported to the route
+ * processing.
+ * @param n pointer to original netlink message
+ * @param retry true if message was already a retry
+ * @param error errno value reported by the kernel
+ */
+static void
+olsr_netlink_batch_error(const struct nlmsghdr *n, bool retry, int error)
+{
+  struct olsr_rtreq req;
+  struct olsr_ip_prefix dst;
+  const struct rtmsg *r;
+  bool set;
+#if !defined(REMOVE_LOG_ERROR)
+  struct ipprefix_str bufp;
+#endif
+
+  r = NLMSG_DATA(n);
+  set = n->nlmsg_type == RTM_NEWROUTE;
+  olsr_netlink_get_dst(n, &dst);
+
+  /* report success on "No such process" (3) while deleting routes */
+  if (!set && error == ESRCH) {
+    OLSR_ERROR(LOG_ROUTING, ". ignoring 'No such process' (3) while deleting route to %s!",
+        olsr_ip_prefix_to_string(&bufp, &dst));
+    return;
+  }
+
+  /* resolve "File exist" (17) propblems (on orig and autogen routes)*/
+  if (set && error == EEXIST && !retry && n->nlmsg_len <= sizeof(req)
+      && batch_queue->count + 2 <= NETLINK_BATCH_MSGS
+      && batch_queue->len + NLMSG_ALIGN(sizeof(req)) + NLMSG_ALIGN(n->nlmsg_len) <= sizeof(batch_queue->buffer)) {
+    OLSR_ERROR(LOG_ROUTING, ". auto-deleting similar routes to %s to resolve 'File exists' (17) while adding route!",
+        olsr_ip_prefix_to_string(&bufp, &dst));
+
+    /* erase similar rule and create this rule a second time */
+    olsr_build_netlink_route(&req, r->rtm_family, r->rtm_table, 0, 0, -1, NULL, NULL, &dst, false, true);
+    olsr_netlink_queue(&req.n, true);
+
+    memcpy(&req, n, n->nlmsg_len);
+    olsr_netlink_queue(&req.n, true);
+    return;
+  }
+
+  OLSR_ERROR(LOG_ROUTING, ". error: %s route to %s (%s %d)", set ? "add" : "del",
+      olsr_ip_prefix_to_string(&bufp, &dst), strerror(error), error);
+  olsr_kernel_route_error(&dst, set, error);
+}
+
+/**
+ * Process a netlink ack which does not belong to a synchronous request.
+ * @param h pointer to netlink ack
+ */
+static void
+olsr_netlink_batch_ack(const struct nlmsghdr *h)
+{
+  const struct nlmsgerr *l_err;
+  uint32_t idx;
+
+  if (h->nlmsg_type != NLMSG_ERROR || NLMSG_LENGTH(sizeof(struct nlmsgerr)) > h->nlmsg_len) {
+    return;
+  }
+
+  l_err = NLMSG_DATA(h);
+  if (l_err->error == 0) {
+    return;
+  }
+
+  idx = h->nlmsg_seq - batch_sent->first_seq;
+  if (idx >= batch_sent->count) {
+    OLSR_WARN(LOG_ROUTING, "Received netlink error code %s (%d) for unknown seqnr %u",
+        strerror(-l_err->error), l_err->error, h->nlmsg_seq);
+    return;
+  }
+
+  olsr_netlink_batch_error(
+      (struct nlmsghdr *)ARM_NOWARN_ALIGN((char *)batch_sent->buffer + batch_sent->offset[idx]),
+      batch_sent->retry[idx], -l_err->error);
+}
+
+/**
+ * Read all pending acks from the rtnetlink socket.
+ * @param wait_seq sequence number of a synchronous request, 0 if none
+ * @return error code of the synchronous request, -1 if not found
+ */
+static int
+olsr_netlink_read_acks(uint32_t wait_seq)
 {
-  char rcvbuf[1024];
+  uint32_t rcvbuf[1024];
   struct iovec iov;
   struct sockaddr_nl nladdr;
   struct msghdr msg;
   struct nlmsghdr *h;
   struct nlmsgerr *l_err;
+  int ret, result = -1;
+
+  memset(&nladdr, 0, sizeof(nladdr));
+  memset(&msg, 0, sizeof(msg));
+
+  msg.msg_name = &nladdr;
+  msg.msg_namelen = sizeof(nladdr);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  while (result == -1) {
+    iov.iov_base = rcvbuf;
+    iov.iov_len = sizeof(rcvbuf);
+
+    ret = recvmsg(olsr_cnf->rtnl_s, &msg, MSG_DONTWAIT);
+    if (ret <= 0) {
+      if (wait_seq != 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        OLSR_WARN(LOG_ROUTING, "Error while reading answer to netlink message (%d: %s)", errno, strerror(errno));
+      }
+      return -1;
+    }
+
+    for (h = (struct nlmsghdr *)ARM_NOWARN_ALIGN(rcvbuf); NLMSG_OK(h, (unsigned int)ret); h = MY_NLMSG_NEXT(h, ret)) {
+      if (wait_seq == 0 || h->nlmsg_seq != wait_seq) {
+        olsr_netlink_batch_ack(h);
+        continue;
+      }
+
+      if (h->nlmsg_type != NLMSG_ERROR) {
+        OLSR_WARN(LOG_ROUTING,
+            "Received unknown netlink response: %u bytes, type %u (not %u) with seqnr %u and flags %u from %u",
+            h->nlmsg_len, h->nlmsg_type, NLMSG_ERROR, h->nlmsg_seq, h->nlmsg_flags, h->nlmsg_pid);
+        return -1;
+      }
+      if (NLMSG_LENGTH(sizeof(struct nlmsgerr)) > h->nlmsg_len) {
+        OLSR_WARN(LOG_ROUTING,"Received invalid netlink message size %lu != %u",
+            (unsigned long int)sizeof(struct nlmsgerr), h->nlmsg_len);
+        return -1;
+      }
+
+      l_err = (struct nlmsgerr *)NLMSG_DATA(h);
+
+      if (l_err->error) {
+        OLSR_WARN(LOG_ROUTING,"Received netlink error code %s (%d)", strerror(-l_err->error), l_err->error);
+      }
+      result = -l_err->error;
+    }
+  }
+  return result;
+}
+
+/**
+ * Send all queued route messages to the kernel
+ * and process their acks.
+ */
+static void
+olsr_netlink_flush(void)
+{
+  struct olsr_netlink_batch *batch;
+  struct iovec iov;
+  struct sockaddr_nl nladdr;
+  struct msghdr msg;
+  unsigned int i;
+
+  while (batch_queue->count > 0) {
+    memset(&nladdr, 0, sizeof(nladdr));
+    memset(&msg, 0, sizeof(msg));
+
+    nladdr.nl_family = AF_NETLINK;
+
+    msg.msg_name = &nladdr;
+    msg.msg_namelen = sizeof(nladdr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    iov.iov_base = batch_queue->buffer;
+    iov.iov_len = batch_queue->len;
+
+    /* the queued messages are waiting for their acks now */
+    batch = batch_sent;
+    batch_sent = batch_queue;
+    batch_queue = batch;
+
+    batch_queue->count = 0;
+    batch_queue->len = 0;
+
+    OLSR_DEBUG(LOG_ROUTING, "Sending %u batched netlink messages (%lu bytes)\n",
+        batch_sent->count, (unsigned long)batch_sent->len);
+
+    if (sendmsg(olsr_cnf->rtnl_s, &msg, 0) <= 0) {
+      int error = errno;
+
+      OLSR_WARN(LOG_ROUTING, "Cannot send data to netlink socket (%d: %s)", error, strerror(error));
+      for (i = 0; i < batch_sent->count; i++) {
+        olsr_netlink_batch_error(
+            (struct nlmsghdr *)ARM_NOWARN_ALIGN((char *)batch_sent->buffer + batch_sent->offset[i]),
+            true, error);
+      }
+      continue;
+    }
+
+    /* rtnetlink processes the messages during sendmsg(), so the acks are already waiting */
+    olsr_netlink_read_acks(0);
+  }
+}
+
+/**
+ * Socket scheduler callback for late acks of batched messages.
+ */
+static void
+olsr_netlink_read(int fd __attribute__ ((unused)), void *data __attribute__ ((unused)),
+    unsigned int flags __attribute__ ((unused)))
+{
+  olsr_netlink_read_acks(0);
+
+  if (!batch_active) {
+    olsr_netlink_flush();
+  }
+}
+
+/*rt_entry and nexthop and family and table must only be specified with an flag != RT_NONE  && != RT_LO_IP*/
+static int
+olsr_netlink_send(struct nlmsghdr *nl_hdr)
+{
+  struct iovec iov;
+  struct sockaddr_nl nladdr;
+  struct msghdr msg;
   int ret;
 
+  /* keep the order of the kernel operations */
+  olsr_netlink_flush();
+
   memset(&nladdr, 0, sizeof(nladdr));
   memset(&msg, 0, sizeof(msg));
 
@@ -235,6 +564,8 @@ olsr_netlink_send(struct nlmsghdr *nl_hdr)
   msg.msg_iov = &iov;
   msg.msg_iovlen = 1;
 
+  nl_hdr->nlmsg_seq = ++netlink_seq;
+
   iov.iov_base = nl_hdr;
   iov.iov_len = nl_hdr->nlmsg_len;
   ret = sendmsg(olsr_cnf->rtnl_s, &msg, 0);
@@ -243,38 +574,351 @@ olsr_netlink_send(struct nlmsghdr *nl_hdr)
     return -1;
   }
 
-  iov.iov_base = rcvbuf;
-  iov.iov_len = sizeof(rcvbuf);
-  ret = recvmsg(olsr_cnf->rtnl_s, &msg, 0);
-  if (ret <= 0) {
-    OLSR_WARN(LOG_ROUTING, "Error while reading answer to netlink message (%d: %s)", errno, strerror(errno));
-    return -1;
+  return olsr_netlink_read_acks(nl_hdr->nlmsg_seq);
+}
+
+/**
+ * Parse a route netlink message.
+ * @param n pointer to RTM_NEWROUTE/RTM_DELROUTE message
+ * @param fib pointer to target FIB entry
+ */
+static void
+olsr_netlink_parse_route(const struct nlmsghdr *n, struct olsr_fib_entry *fib)
+{
+  const struct rtmsg *r = NLMSG_DATA(n);
+  const struct rtattr *rta;
+  int len;
+
+  memset(fib, 0, sizeof(*fib));
+  fib->family = r->rtm_family;
+  fib->table = r->rtm_table;
+  fib->dst.prefix_len = r->rtm_dst_len;
+
+  len = RTM_PAYLOAD(n);
+  for (rta = RTM_RTA(r); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+    switch (rta->rta_type) {
+      case RTA_DST:
+        if (RTA_PAYLOAD(rta) <= sizeof(fib->dst.prefix)) {
+          memcpy(&fib->dst.prefix, RTA_DATA(rta), RTA_PAYLOAD(rta));
+        }
+        break;
+      case RTA_GATEWAY:
+        if (RTA_PAYLOAD(rta) <= sizeof(fib->gw)) {
+          memcpy(&fib->gw, RTA_DATA(rta), RTA_PAYLOAD(rta));
+          fib->has_gw = true;
+        }
+        break;
+      case RTA_OIF:
+        memcpy(&fib->if_index, RTA_DATA(rta), sizeof(fib->if_index));
+        break;
+      case RTA_PRIORITY:
+        memcpy(&fib->metric, RTA_DATA(rta), sizeof(fib->metric));
+        break;
+      case RTA_TABLE:
+        memcpy(&fib->table, RTA_DATA(rta), sizeof(fib->table));
+        break;
+      default:
+        break;
+    }
   }
+}
 
-  h = (struct nlmsghdr *)ARM_NOWARN_ALIGN(rcvbuf);
-  if (!NLMSG_OK(h, (unsigned int)ret)) {
-    OLSR_WARN(LOG_ROUTING, "Received netlink message was malformed (ret=%d, %u)", ret, h->nlmsg_len);
-    return -1;
+/**
+ * Delete a stale route of a previous olsrd instance from the kernel
+ * and forget about it.
+ * @param entry pointer to stale route
+ */
+static void
+olsr_fib_delete_stale(struct olsr_fib_entry *entry)
+{
+  struct olsr_rtreq req;
+  int family_size, err;
+#if !defined(REMOVE_LOG_DEBUG)
+  struct ipprefix_str bufp;
+#endif
+
+  OLSR_DEBUG(LOG_ROUTING, "KERN: Deleting stale route to %s\n", olsr_ip_prefix_to_string(&bufp, &entry->dst));
+
+  family_size = entry->family == AF_INET ? sizeof(struct in_addr) : sizeof(struct in6_addr);
+
+  memset(&req, 0, sizeof(req));
+
+  req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+  req.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+  req.n.nlmsg_type = RTM_DELROUTE;
+  req.r.rtm_family = entry->family;
+  req.r.rtm_table = entry->table;
+  req.r.rtm_type = RTN_UNICAST;
+  req.r.rtm_scope = RT_SCOPE_NOWHERE;
+  req.r.rtm_dst_len = entry->dst.prefix_len;
+
+  olsr_netlink_addreq(&req.n, sizeof(req), RTA_DST, &entry->dst.prefix, family_size);
+  olsr_netlink_addreq(&req.n, sizeof(req), RTA_OIF, &entry->if_index, sizeof(entry->if_index));
+  olsr_netlink_addreq(&req.n, sizeof(req), RTA_PRIORITY, &entry->metric, sizeof(entry->metric));
+  if (entry->has_gw) {
+    olsr_netlink_addreq(&req.n, sizeof(req), RTA_GATEWAY, &entry->gw, family_size);
   }
 
-  if (h->nlmsg_type != NLMSG_ERROR) {
-    OLSR_WARN(LOG_ROUTING,
-        "Received unknown netlink response: %u bytes, type %u (not %u) with seqnr %u and flags %u from %u",
-        h->nlmsg_len, h->nlmsg_type, NLMSG_ERROR, h->nlmsg_seq, h->nlmsg_flags, h->nlmsg_pid);
-    return -1;
+  if (batch_active) {
+    while (olsr_netlink_queue(&req.n, false)) {
+      olsr_netlink_flush();
+    }
+  }
+  else {
+    /* the kernel reports 'No such process' if the route is already gone */
+    err = olsr_netlink_send(&req.n);
+    if (err != 0 && err != ESRCH) {
+      OLSR_WARN(LOG_ROUTING, "Could not delete stale route to %s", olsr_ip_prefix_to_string(&bufp, &entry->dst));
+    }
+  }
+
+  avl_remove(&fib_stale_tree, &entry->node);
+  olsr_memcookie_free(fib_stale_cookie, entry);
+}
+
+/**
+ * Compare a new route with the stale routes of a previous
+ * olsrd instance to the same destination.
+ * @param n pointer to RTM_NEWROUTE message
+ * @return true if an identical route is already in the kernel
+ */
+static bool
+olsr_fib_reconcile(const struct nlmsghdr *n)
+{
+  struct olsr_fib_entry fib, *entry, *next;
+  bool found = false;
+
+  olsr_netlink_parse_route(n, &fib);
+
+  entry = avl_find_element(&fib_stale_tree, &fib.dst, entry, node);
+  while (entry != NULL) {
+    next = NULL;
+    if (!avl_is_last(&fib_stale_tree, &entry->node)) {
+      next = avl_next_element(entry, node);
+      if (next->node.leader) {
+        /* first entry with another destination */
+        next = NULL;
+      }
+    }
+
+    if (entry->family == fib.family && entry->table == fib.table) {
+      if (!found && entry->if_index == fib.if_index && entry->metric == fib.metric
+          && entry->has_gw == fib.has_gw && (!fib.has_gw || olsr_ipcmp(&entry->gw, &fib.gw) == 0)) {
+        /* route is already there, keep it */
+        avl_remove(&fib_stale_tree, &entry->node);
+        olsr_memcookie_free(fib_stale_cookie, entry);
+        found = true;
+      }
+      else if (entry->metric == fib.metric) {
+        /* NLM_F_REPLACE will overwrite this route */
+        avl_remove(&fib_stale_tree, &entry->node);
+        olsr_memcookie_free(fib_stale_cookie, entry);
+      }
+      else {
+        /* a route with a different metric would stay in the kernel */
+        olsr_fib_delete_stale(entry);
+      }
+    }
+    entry = next;
+  }
+  return found;
+}
+
+/**
+ * Timer callback to remove all stale routes which have not been
+ * adopted by the route calculation.
+ */
+static void
+olsr_fib_expire_stale(void *context __attribute__ ((unused)))
+{
+  struct olsr_fib_entry *entry, *iterator;
+
+  fib_stale_timer = NULL;
+
+  if (fib_stale_tree.count > 0) {
+    OLSR_INFO(LOG_ROUTING, "Removing %u stale routes of a previous olsrd instance\n", fib_stale_tree.count);
+  }
+
+  os_route_batch_begin();
+  avl_for_each_element_safe(&fib_stale_tree, entry, node, iterator) {
+    olsr_fib_delete_stale(entry);
+  }
+  os_route_batch_end();
+}
+
+/**
+ * Read the routes of a previous olsrd instance from the kernel,
+ * identified by the routing protocol and table.
+ * This only happens if a dedicated routing protocol is configured,
+ * the protocol IDs up to RTPROT_STATIC are shared with the system
+ * and the routes of the administrator.
+ */
+static void
+olsr_fib_dump(void)
+{
+  static uint32_t rcvbuf[8192];
+  struct {
+    struct nlmsghdr n;
+    struct rtmsg r;
+  } req;
+  struct iovec iov;
+  struct sockaddr_nl nladdr;
+  struct msghdr msg;
+  struct nlmsghdr *h;
+  struct olsr_fib_entry fib, *entry;
+  const struct rtmsg *r;
+  bool done = false;
+  int ret;
+
+  if (olsr_cnf->rt_proto <= RTPROT_STATIC) {
+    OLSR_DEBUG(LOG_ROUTING, "No dedicated RtProto configured, not looking for routes of a previous instance\n");
+    return;
+  }
+
+  memset(&req, 0, sizeof(req));
+  req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+  req.n.nlmsg_type = RTM_GETROUTE;
+  req.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  req.n.nlmsg_seq = ++netlink_seq;
+  req.r.rtm_family = olsr_cnf->ip_version;
+
+  memset(&nladdr, 0, sizeof(nladdr));
+  memset(&msg, 0, sizeof(msg));
+
+  nladdr.nl_family = AF_NETLINK;
+
+  msg.msg_name = &nladdr;
+  msg.msg_namelen = sizeof(nladdr);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  iov.iov_base = &req;
+  iov.iov_len = req.n.nlmsg_len;
+  if (sendmsg(olsr_cnf->rtnl_s, &msg, 0) <= 0) {
+    OLSR_WARN(LOG_ROUTING, "Cannot request kernel routing table (%d: %s)", errno, strerror(errno));
+    return;
+  }
+
+  while (!done) {
+    iov.iov_base = rcvbuf;
+    iov.iov_len = sizeof(rcvbuf);
+
+    /* rtnetlink generates the next part of the dump while we are reading */
+    ret = recvmsg(olsr_cnf->rtnl_s, &msg, MSG_DONTWAIT);
+    if (ret <= 0) {
+      OLSR_WARN(LOG_ROUTING, "Error while reading kernel routing table (%d: %s)", errno, strerror(errno));
+      break;
+    }
+
+    for (h = (struct nlmsghdr *)ARM_NOWARN_ALIGN(rcvbuf); NLMSG_OK(h, (unsigned int)ret); h = MY_NLMSG_NEXT(h, ret)) {
+      if (h->nlmsg_seq != req.n.nlmsg_seq) {
+        continue;
+      }
+      if (h->nlmsg_type == NLMSG_DONE || h->nlmsg_type == NLMSG_ERROR) {
+        done = true;
+        break;
+      }
+      if (h->nlmsg_type != RTM_NEWROUTE) {
+        continue;
+      }
+
+      r = NLMSG_DATA(h);
+      if (r->rtm_type != RTN_UNICAST || r->rtm_protocol != olsr_cnf->rt_proto
+          || (r->rtm_flags & RTM_F_CLONED) != 0) {
+        continue;
+      }
+
+      olsr_netlink_parse_route(h, &fib);
+      if (fib.family != olsr_cnf->ip_version
+          || (fib.table != olsr_cnf->rt_table && fib.table != olsr_cnf->rt_table_default)) {
+        continue;
+      }
+
+      entry = olsr_memcookie_malloc(fib_stale_cookie);
+      memcpy(entry, &fib, sizeof(*entry));
+      entry->node.key = &entry->dst;
+      avl_insert(&fib_stale_tree, &entry->node);
+    }
   }
-  if (NLMSG_LENGTH(sizeof(struct nlmsgerr)) > h->nlmsg_len) {
-    OLSR_WARN(LOG_ROUTING,"Received invalid netlink message size %lu != %u",
-        (unsigned long int)sizeof(struct nlmsgerr), h->nlmsg_len);
+
+  if (fib_stale_tree.count > 0) {
+    OLSR_INFO(LOG_ROUTING, "Found %u routes of a previous olsrd instance\n", fib_stale_tree.count);
+
+    /* all valid routes should be known after the topology validity time */
+    fib_stale_timer = olsr_timer_start(
+        MAX(olsr_cnf->tc_params.validity_time, olsr_cnf->hna_params.validity_time), 0, NULL, fib_stale_timer_info);
+  }
+}
+
+/**
+ * Register the rtnetlink socket with the socket scheduler
+ * to collect late acks of batched route updates and read the
+ * routes of a previous olsrd instance.
+ * @return 0 if successful, -1 otherwise
+ */
+int
+olsr_os_netlink_init(void)
+{
+  netlink_socket = olsr_socket_add(olsr_cnf->rtnl_s, &olsr_netlink_read, NULL, OLSR_SOCKET_READ);
+  if (netlink_socket == NULL) {
+    OLSR_ERROR(LOG_ROUTING, "Could not register rtnetlink socket with scheduler");
     return -1;
   }
 
-  l_err = (struct nlmsgerr *)NLMSG_DATA(h);
+  avl_init(&fib_stale_tree, avl_comp_prefix_default, true, NULL);
+  fib_stale_cookie = olsr_memcookie_add("Stale FIB entry", sizeof(struct olsr_fib_entry));
+  fib_stale_timer_info = olsr_timer_add("Stale FIB entries", &olsr_fib_expire_stale, false);
+
+  olsr_fib_dump();
+  return 0;
+}
+
+/**
+ * Remove the stale routes of a previous olsrd instance and the
+ * rtnetlink socket from the socket scheduler.
+ */
+void
+olsr_os_netlink_cleanup(void)
+{
+  olsr_timer_stop(fib_stale_timer);
+  olsr_fib_expire_stale(NULL);
+
+  olsr_netlink_flush();
 
-  if (l_err->error) {
-    OLSR_WARN(LOG_ROUTING,"Received netlink error code %s (%d)", strerror(-l_err->error), l_err->error);
+  if (netlink_socket) {
+    olsr_socket_remove(netlink_socket);
+    netlink_socket = NULL;
   }
-  return -l_err->error;
+}
+
+/**
+ * Linux can change the nexthop of a route atomically with NLM_F_REPLACE.
+ * If the kernel refuses the replacement, the caller falls back to
+ * delete and add.
+ */
+bool
+os_route_can_replace(void)
+{
+  return true;
+}
+
+/**
+ * Start collecting kernel route updates in a batch.
+ */
+void
+os_route_batch_begin(void)
+{
+  batch_active = olsr_cnf->rt_batch;
+}
+
+/**
+ * Send all collected kernel route updates to the kernel.
+ */
+void
+os_route_batch_end(void)
+{
+  batch_active = false;
+  olsr_netlink_flush();
 }
 
 int olsr_os_policy_rule(int family, int rttable, uint32_t priority, const char *if_name, bool set) {
@@ -349,13 +993,11 @@ int olsr_os_ifip(int ifindex, union olsr_ip_addr *ip, bool create) {
   return olsr_add_ip(ifindex, ip, NULL, create);
 }
 
-static int olsr_new_netlink_route(int family, int rttable, int if_index, int metric, int protocol,
-    const union olsr_ip_addr *src, const union olsr_ip_addr *gw, const struct olsr_ip_prefix *dst,
-    bool set, bool del_similar) {
+static void olsr_build_netlink_route(struct olsr_rtreq *req, int family, int rttable, int if_index,
+    int metric, int protocol, const union olsr_ip_addr *src, const union olsr_ip_addr *gw,
+    const struct olsr_ip_prefix *dst, bool set, bool del_similar) {
 
-  struct olsr_rtreq req;
   int family_size;
-  int err;
 
   if (0) {
 #if !defined(REMOVE_LOG_WARN)
@@ -369,72 +1011,82 @@ static int olsr_new_netlink_route(int family, int rttable, int if_index, int met
   }
   family_size = family == AF_INET ? sizeof(struct in_addr) : sizeof(struct in6_addr);
 
-  memset(&req, 0, sizeof(req));
+  memset(req, 0, sizeof(*req));
 
-  req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
-  req.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+  req->n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+  req->n.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
   if (set) {
-    req.n.nlmsg_flags |= NLM_F_CREATE | NLM_F_REPLACE;
+    req->n.nlmsg_flags |= NLM_F_CREATE | NLM_F_REPLACE;
   }
 
-  req.n.nlmsg_type = set ? RTM_NEWROUTE : RTM_DELROUTE;
-  req.r.rtm_family = family;
-  req.r.rtm_table = rttable;
-  req.r.rtm_flags |= RTNH_F_ONLINK;
+  req->n.nlmsg_type = set ? RTM_NEWROUTE : RTM_DELROUTE;
+  req->r.rtm_family = family;
+  req->r.rtm_table = rttable;
+  req->r.rtm_flags |= RTNH_F_ONLINK;
 
   /* RTN_UNSPEC would be the wildcard, but blackhole broadcast or nat roules should usually not conflict */
   /* -> olsr only adds deletes unicast routes */
-  req.r.rtm_type = RTN_UNICAST;
+  req->r.rtm_type = RTN_UNICAST;
 
-  req.r.rtm_dst_len = dst->prefix_len;
+  req->r.rtm_dst_len = dst->prefix_len;
 
   if (set) {
     /* add protocol for setting a route */
-    req.r.rtm_protocol = protocol;
+    req->r.rtm_protocol = protocol;
   }
 
   /* calculate scope of operation */
   if (!set && del_similar) {
     /* as wildcard for fuzzy deletion */
-    req.r.rtm_scope = RT_SCOPE_NOWHERE;
+    req->r.rtm_scope = RT_SCOPE_NOWHERE;
   }
   else {
     /* for all routes */
-    req.r.rtm_scope = RT_SCOPE_UNIVERSE;
+    req->r.rtm_scope = RT_SCOPE_UNIVERSE;
   }
 
   if (set || !del_similar) {
     /* add interface*/
-    olsr_netlink_addreq(&req.n, sizeof(req), RTA_OIF, &if_index, sizeof(if_index));
+    olsr_netlink_addreq(&req->n, sizeof(*req), RTA_OIF, &if_index, sizeof(if_index));
   }
 
   if (set && src != NULL) {
     /* add src-ip */
-    olsr_netlink_addreq(&req.n, sizeof(req), RTA_PREFSRC, src, family_size);
+    olsr_netlink_addreq(&req->n, sizeof(*req), RTA_PREFSRC, src, family_size);
   }
 
   if (metric != -1) {
     /* add metric */
-    olsr_netlink_addreq(&req.n, sizeof(req), RTA_PRIORITY, &metric, sizeof(metric));
+    olsr_netlink_addreq(&req->n, sizeof(*req), RTA_PRIORITY, &metric, sizeof(metric));
   }
 
   if (gw) {
     /* add gateway */
-    olsr_netlink_addreq(&req.n, sizeof(req), RTA_GATEWAY, gw, family_size);
+    olsr_netlink_addreq(&req->n, sizeof(*req), RTA_GATEWAY, gw, family_size);
   }
   else {
     if ( dst->prefix_len == 32 ) {
       /* use destination as gateway, to 'force' linux kernel to do proper source address selection */
-      olsr_netlink_addreq(&req.n, sizeof(req), RTA_GATEWAY, &dst->prefix, family_size);
+      olsr_netlink_addreq(&req->n, sizeof(*req), RTA_GATEWAY, &dst->prefix, family_size);
     }
     else {
       /*do not use onlink on such routes(no gateway, but no hostroute aswell) -  e.g. smartgateway default route over an ptp tunnel interface*/
-      req.r.rtm_flags &= (~RTNH_F_ONLINK);
+      req->r.rtm_flags &= (~RTNH_F_ONLINK);
     }
   }
 
   /* add destination */
-  olsr_netlink_addreq(&req.n, sizeof(req), RTA_DST, &dst->prefix, family_size);
+  olsr_netlink_addreq(&req->n, sizeof(*req), RTA_DST, &dst->prefix, family_size);
+}
+
+static int olsr_new_netlink_route(int family, int rttable, int if_index, int metric, int protocol,
+    const union olsr_ip_addr *src, const union olsr_ip_addr *gw, const struct olsr_ip_prefix *dst,
+    bool set, bool del_similar) {
+
+  struct olsr_rtreq req;
+  int err;
+
+  olsr_build_netlink_route(&req, family, rttable, if_index, metric, protocol, src, gw, dst, set, del_similar);
 
   err = olsr_netlink_send(&req.n);
   if (err) {
@@ -557,6 +1209,26 @@ static int olsr_os_process_rt_entry(int af_family, const struct rt_entry *rt, bo
     src = NULL;
   }
 
+  if (batch_active || (set && fib_stale_tree.count > 0)) {
+    struct olsr_rtreq req;
+
+    olsr_build_netlink_route(&req, af_family, table, nexthop->interface->if_index, metric, olsr_cnf->rt_proto,
+        src, hostRoute ? NULL : &nexthop->gateway, &rt->rt_dst, set, false);
+
+    if (set && fib_stale_tree.count > 0 && olsr_fib_reconcile(&req.n)) {
+      OLSR_DEBUG(LOG_ROUTING, "KERN: route is already in the kernel\n");
+      return 0;
+    }
+
+    if (batch_active) {
+      /* errors are handled when the acks arrive */
+      while (olsr_netlink_queue(&req.n, false)) {
+        olsr_netlink_flush();
+      }
+      return 0;
+    }
+  }
+
   /* create route */
   err = olsr_new_netlink_route(af_family, table, nexthop->interface->if_index, metric, olsr_cnf->rt_proto,
       src, hostRoute ? NULL : &nexthop->gateway, &rt->rt_dst, set, false);
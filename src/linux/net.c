@@ -43,6 +43,8 @@
  * Linux spesific code
  */
 
+#define _GNU_SOURCE 1
+
 #include <net/if.h>
 #include <netinet/ip.h>
 
@@ -73,6 +75,12 @@
 #endif
 #define IPTOS_CLASS(class)    ((class) & IPTOS_CLASS_MASK)
 
+/* maximum number of packets handled by one sendmmsg/recvmmsg call */
+#define OS_MMSG_MAX             64
+
+/* maximum number of iovecs (packet buffers and segments) per sendmmsg call */
+#define OS_MMSG_IOV_MAX         256
+
 #define IPV6_ADDR_LOOPBACK      0x0010U
 #define IPV6_ADDR_LINKLOCAL     0x0020U
 #define IPV6_ADDR_SITELOCAL     0x0040U
@@ -664,6 +672,95 @@ os_recvfrom(int s, void *buf, size_t len, int flags,
   return recvfrom(s, buf, len, flags, &sockaddr->std, socklen);
 }
 
+/**
+ * Send multiple packets with one sendmmsg(2) call.
+ * The segments of each packet are sent together with its buffer
+ * as one datagram (scatter-gather).
+ * @param s socket
+ * @param pkts array of packets with buffer, length and destination
+ * @param count number of packets in the array
+ * @param flags flags for sendmmsg(2)
+ * @return number of packets sent, -1 if the first packet failed
+ */
+int
+os_sendmmsg(int s, struct os_packet *pkts, int count, int flags)
+{
+  struct mmsghdr msgs[OS_MMSG_MAX];
+  struct iovec iov[OS_MMSG_IOV_MAX];
+  int i, j, iovcount;
+
+  if (count > OS_MMSG_MAX) {
+    count = OS_MMSG_MAX;
+  }
+
+  memset(msgs, 0, sizeof(struct mmsghdr) * count);
+  iovcount = 0;
+  for (i = 0; i < count; i++) {
+    if (i > 0 && iovcount + 1 + pkts[i].segment_count > OS_MMSG_IOV_MAX) {
+      /* no more iovecs left for this packet, send it with the next call */
+      count = i;
+      break;
+    }
+    assert(1 + pkts[i].segment_count <= OS_MMSG_IOV_MAX);
+
+    msgs[i].msg_hdr.msg_name = &pkts[i].addr.std;
+    msgs[i].msg_hdr.msg_namelen = sizeof(pkts[i].addr);
+    msgs[i].msg_hdr.msg_iov = &iov[iovcount];
+    msgs[i].msg_hdr.msg_iovlen = 1 + pkts[i].segment_count;
+
+    iov[iovcount].iov_base = pkts[i].buf;
+    iov[iovcount].iov_len = pkts[i].len;
+    iovcount++;
+
+    for (j = 0; j < pkts[i].segment_count; j++) {
+      iov[iovcount].iov_base = pkts[i].segments[j].buf;
+      iov[iovcount].iov_len = pkts[i].segments[j].len;
+      iovcount++;
+    }
+  }
+  return sendmmsg(s, msgs, count, flags);
+}
+
+/**
+ * Receive multiple packets with one recvmmsg(2) call.
+ * @param s socket
+ * @param pkts array of packets with preallocated buffers,
+ *   length and source address are set for each received packet
+ * @param count number of packets in the array
+ * @param flags flags for recvmmsg(2)
+ * @return number of packets received, -1 if an error happened
+ *   before the first packet
+ */
+int
+os_recvmmsg(int s, struct os_packet *pkts, int count, int flags)
+{
+  struct mmsghdr msgs[OS_MMSG_MAX];
+  struct iovec iov[OS_MMSG_MAX];
+  int i, n;
+
+  if (count > OS_MMSG_MAX) {
+    count = OS_MMSG_MAX;
+  }
+
+  memset(msgs, 0, sizeof(struct mmsghdr) * count);
+  for (i = 0; i < count; i++) {
+    iov[i].iov_base = pkts[i].buf;
+    iov[i].iov_len = pkts[i].len;
+
+    msgs[i].msg_hdr.msg_name = &pkts[i].addr.std;
+    msgs[i].msg_hdr.msg_namelen = sizeof(pkts[i].addr);
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  n = recvmmsg(s, msgs, count, flags, NULL);
+  for (i = 0; i < n; i++) {
+    pkts[i].len = msgs[i].msg_len;
+    pkts[i].addrlen = msgs[i].msg_hdr.msg_namelen;
+  }
+  return n;
+}
+
 /**
  * Wrapper for select(2)
  */
@@ -92,123 +92,134 @@ olsr_calculate_lq_mpr(void)
   }
 }
 
-static void
-olsr_calculate_lq_mpr2(void)
+/**
+ * Calculate the cost of the direct link to a 2-hop neighbor
+ * which is also a symmetric 1-hop neighbor.
+ * @param nbr2 pointer to 2-hop neighbor
+ * @return cost of direct link, ROUTE_COST_BROKEN if there is none
+ */
+static olsr_linkcost
+olsr_mpr_direct_linkcost(struct nbr2_entry *nbr2)
 {
-  struct nbr_entry *neigh, *neigh_iterator;
-
-/* use 0 to activate MPR calculation, use 1 to deactivate it */
-#if 0
-  OLSR_FOR_ALL_NBR_ENTRIES(neigh, neigh_iterator) {
-    /* just use everyone as MPR */
-    neigh->is_mpr = true;
-  }
-#else
-  struct nbr2_entry *nbr2, *nbr2_iterator;
-  struct nbr_con *walker, *walker_iterator;
+  struct nbr_entry *neigh;
   struct link_entry *lnk;
-  int k;
-  olsr_linkcost best, best_1hop;
-  bool mpr_changes = false, found_better_path;
 
-  OLSR_FOR_ALL_NBR_ENTRIES(neigh, neigh_iterator) {
-    /* Clear current MPR status. */
-    neigh->is_mpr = false;
+  /* check whether this 2-hop neighbors is also a neighbors */
+  neigh = olsr_lookup_nbr_entry(&nbr2->nbr2_addr, false);
+  if (neigh == NULL || !neigh->is_sym) {
+    return ROUTE_COST_BROKEN;
+  }
 
-    /* In this pass we are only interested in WILL_ALWAYS neighbors */
-    if (neigh->is_sym && neigh->willingness != WILL_ALWAYS) {
-      neigh->is_mpr = true;
+  /* determine the link quality of the direct link */
+  lnk = get_best_link_to_neighbor(neigh);
+  if (!lnk) {
+    /*
+     * this should not happen, a symmetric 1-hop neighbor
+     * should have a symmetric link. Do not select a MPR
+     * for this 2-hop neighbor.
+     */
+    return 0;
+  }
+  return lnk->linkcost;
+}
 
-      if (neigh->is_mpr != neigh->was_mpr) {
-        mpr_changes = true;
-      }
+/**
+ * Select the MPRs covering a single 2-hop neighbor.
+ *
+ * These are up to mpr_coverage symmetric 1-hop neighbors with the
+ * best path costs. A path is only used if it is better than the
+ * direct link to the 2-hop neighbor. Paths with equal costs are
+ * selected in the order of the connector tree.
+ *
+ * @param nbr2 pointer to 2-hop neighbor
+ */
+static void
+olsr_calculate_nbr2_mpr(struct nbr2_entry *nbr2)
+{
+  struct nbr_con *selected[MAX_MPR_COVERAGE];
+  struct nbr_con *walker, *walker_iterator;
+  olsr_linkcost best_1hop;
+  int count, i;
+
+  /* forget the last selection */
+  OLSR_FOR_ALL_NBR2_CON_ENTRIES(nbr2, walker, walker_iterator) {
+    if (walker->mpr_selected) {
+      walker->mpr_selected = false;
+      walker->nbr->mpr_cover_count--;
     }
   }
 
-  /* loop through all 2-hop neighbors */
-  OLSR_FOR_ALL_NBR2_ENTRIES(nbr2, nbr2_iterator) {
-    best_1hop = ROUTE_COST_BROKEN;
-
-    /* check whether this 2-hop neighbors is also a neighbors */
-    neigh = olsr_lookup_nbr_entry(&nbr2->nbr2_addr, false);
-
-    if (neigh != NULL && neigh->is_sym) {
-      /*
-       * if the direct link is better than the best route via
-       * an MPR, then prefer the direct link and do not select
-       * an MPR for this 2-hop neighbors
-       */
-
-      /* determine the link quality of the direct link */
-      lnk = get_best_link_to_neighbor(neigh);
-      if (!lnk) {
-        /*
-         * this should not happen, a symmetric 1-hop neighbor
-         * should have a symmetric link
-         */
-        continue;
-      }
+  /*
+   * if the direct link is better than the best route via
+   * an MPR, then prefer the direct link and do not select
+   * an MPR for this 2-hop neighbors
+   */
+  best_1hop = olsr_mpr_direct_linkcost(nbr2);
+
+  /* keep the best connectors sorted by path cost in a single pass */
+  count = 0;
+  OLSR_FOR_ALL_NBR2_CON_ENTRIES(nbr2, walker, walker_iterator) {
+    if (!walker->nbr->is_sym
+        || walker->second_hop_linkcost >= LINK_COST_BROKEN
+        || walker->path_linkcost >= best_1hop) {
+      continue;
+    }
 
-      best_1hop = lnk->linkcost;
+    for (i = count; i > 0 && selected[i - 1]->path_linkcost > walker->path_linkcost; i--) {
+      if (i < olsr_cnf->mpr_coverage) {
+        selected[i] = selected[i - 1];
+      }
     }
 
-    /* see if there is a better route via another 1-hop neighbor */
-    walker = NULL;
-    found_better_path = false;
-    OLSR_FOR_ALL_NBR2_CON_ENTRIES(nbr2, walker, walker_iterator) {
-      if (walker->path_linkcost < best_1hop) {
-        found_better_path = true;
-        break;
+    if (i < olsr_cnf->mpr_coverage) {
+      selected[i] = walker;
+      if (count < olsr_cnf->mpr_coverage) {
+        count++;
       }
     }
+  }
 
-    /* we've reached the end of the list, so we haven't found
-     * a better route via an MPR - so, skip MPR selection for
-     * this 1-hop neighbor */
+  for (i = 0; i < count; i++) {
+    selected[i]->mpr_selected = true;
+    selected[i]->nbr->mpr_cover_count++;
+  }
+}
 
-    if (!found_better_path) {
-      continue;
-    }
+static void
+olsr_calculate_lq_mpr2(void)
+{
+  struct nbr_entry *neigh, *neigh_iterator;
 
-    /*
-     * Now find the connecting 1-hop neighbors with the best total link qualities
-     */
+/* use 0 to activate MPR calculation, use 1 to deactivate it */
+#if 0
+  OLSR_FOR_ALL_NBR_ENTRIES(neigh, neigh_iterator) {
+    /* just use everyone as MPR */
+    neigh->is_mpr = true;
+  }
+#else
+  struct nbr2_entry *nbr2;
 
-    /* mark all 1-hop neighbors as not used for MPR coverage */
-    OLSR_FOR_ALL_NBR2_CON_ENTRIES(nbr2, walker, walker_iterator) {
-      walker->nbr->skip = false;
+  /*
+   * The direct link costs change without notice, so 2-hop neighbors
+   * which are also symmetric 1-hop neighbors are always checked.
+   */
+  OLSR_FOR_ALL_NBR_ENTRIES(neigh, neigh_iterator) {
+    if (neigh->is_sym && (nbr2 = olsr_lookup_nbr2_entry(&neigh->nbr_addr, false)) != NULL) {
+      olsr_nbr2_set_mpr_dirty(nbr2);
     }
+  }
 
-    for (k = 0; k < olsr_cnf->mpr_coverage; k++) {
-      /*
-       * look for the best 1-hop neighbor that we haven't yet selected
-       * that produce a better route than the direct one
-       */
-      neigh = NULL;
-      best = best_1hop;
-
-      OLSR_FOR_ALL_NBR2_CON_ENTRIES(nbr2, walker, walker_iterator) {
-        if (walker->nbr->is_sym && !walker->nbr->skip
-            && walker->second_hop_linkcost < LINK_COST_BROKEN
-            && walker->path_linkcost < best) {
-          neigh = walker->nbr;
-          best = walker->path_linkcost;
-        }
-      }
-
-      if (neigh == NULL) {
-        /* no more better 2-hop routes, stop looking */
-        break;
-      }
+  /* only the 2-hop neighbors touched since the last run are recalculated */
+  while (!list_is_empty(&nbr2_mpr_dirty_list)) {
+    nbr2 = list_first_element(&nbr2_mpr_dirty_list, nbr2, mpr_dirty_node);
+    list_remove(&nbr2->mpr_dirty_node);
 
-      /*
-       * Found a 1-hop neighbor that we haven't previously selected.
-       */
-      neigh->is_mpr = true;
+    olsr_calculate_nbr2_mpr(nbr2);
+  }
 
-      /* don't use this one for more MPR coverage */
-      neigh->skip = true;
-    }
+  OLSR_FOR_ALL_NBR_ENTRIES(neigh, neigh_iterator) {
+    /* all symmetric neighbors which are not WILL_ALWAYS are used as MPR */
+    neigh->is_mpr = (neigh->is_sym && neigh->willingness != WILL_ALWAYS) || neigh->mpr_cover_count > 0;
   }
 #endif
 }
@@ -70,9 +70,11 @@ init_lq_handler(void)
   OLSR_INFO(LOG_LQ_PLUGINS, "Initializing LQ handler %s...\n", active_lq_handler->name);
 
   tc_edge_mem_cookie = olsr_memcookie_add("tc_edge", active_lq_handler->size_tc_edge);
+  olsr_memcookie_set_slab(tc_edge_mem_cookie, false);
 
   lq_hello_neighbor_mem_cookie =
       olsr_memcookie_add("lq_hello_neighbor", active_lq_handler->size_lq_hello_neighbor);
+  olsr_memcookie_set_slab(lq_hello_neighbor_mem_cookie, false);
 
   link_entry_mem_cookie =
       olsr_memcookie_add("link_entry", active_lq_handler->size_link_entry);
@@ -215,6 +217,7 @@ olsr_neighbor_cost_may_changed(struct nbr_entry *nbr) {
 
   if (edge->cost != cost) {
     edge->cost = cost;
+    olsr_spf_edge_changed(edge);
 
     changes_neighborhood = true;
     changes_topology = true;
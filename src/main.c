@@ -64,6 +64,8 @@
 #include "neighbor_table.h"
 #include "olsr_logging.h"
 #include "olsr_callbacks.h"
+#include "olsr_profile.h"
+#include "olsr_stats.h"
 #include "os_apm.h"
 #include "os_net.h"
 #include "os_kernel_routes.h"
@@ -97,6 +99,9 @@ struct olsr_config *olsr_cnf;          /* The global configuration */
 
 enum app_state app_state = STATE_INIT;
 
+/* signal that changed app_state, logged by the main loop */
+static volatile sig_atomic_t received_signal = 0;
+
 static char copyright_string[] __attribute__ ((unused)) =
   "The olsr.org Optimized Link-State Routing daemon(olsrd) Copyright (c) 2004, Andreas Tonnesen(andreto@olsr.org) All rights reserved.";
 
@@ -227,6 +232,12 @@ main(int argc, char *argv[])
   /* initialize olsr clock */
   olsr_clock_init();
 
+  /* initialize runtime profiles */
+  olsr_profile_init();
+
+  /* initialize metrics */
+  olsr_stats_init();
+
   /* initialize cookie system */
   olsr_memcookie_init();
 
@@ -295,6 +306,9 @@ main(int argc, char *argv[])
     olsr_exit(EXIT_FAILURE);
   }
   os_socket_set_nonblocking(olsr_cnf->rtnl_s);
+  if (olsr_os_netlink_init()) {
+    olsr_exit(EXIT_FAILURE);
+  }
 #endif
 
 /*
@@ -317,6 +331,9 @@ main(int argc, char *argv[])
   /* Initialize message sequencnumber */
   init_msg_seqno();
 
+  /* Initialize change processing */
+  olsr_init_process_changes();
+
   /* Initialize dynamic willingness calculation */
   olsr_init_willingness();
 
@@ -420,17 +437,17 @@ main(int argc, char *argv[])
   /* enable default plugins */
   olsr_plugins_enable(PLUGIN_TYPE_DEFAULT, true);
 
+  /* move log output to the writer thread if configured */
+  olsr_log_start_writer();
+
   /* Starting scheduler */
   app_state = STATE_RUNNING;
   while (app_state == STATE_RUNNING) {
-    uint32_t next_interval;
-
     /*
      * Update the global timestamp. We are using a non-wallclock timer here
      * to avoid any undesired side effects if the system clock changes.
      */
     olsr_clock_update();
-    next_interval = olsr_clock_getAbsolute(olsr_cnf->pollrate);
 
     /* Process timers */
     olsr_timer_walk();
@@ -438,8 +455,20 @@ main(int argc, char *argv[])
     /* Update */
     olsr_process_changes();
 
-    /* Read incoming data and handle it immediately */
-    olsr_socket_handle(next_interval);
+    /* Send all packets generated during this round */
+    net_output_flush();
+
+    /*
+     * Sleep until the next timer is due and handle incoming data
+     * immediately if it arrives earlier
+     */
+    olsr_socket_handle(olsr_timer_getNextEvent());
+  }
+
+  /* logging is not async-signal-safe, so the signal handlers only record the signal */
+  if (received_signal != 0) {
+    OLSR_INFO(LOG_MAIN, "Received signal %d - requesting %s", (int)received_signal,
+        app_state == STATE_RECONFIGURE ? "reconfiguration" : "shutdown");
   }
 
   olsr_timer_stop(tc_gen_timer);
@@ -466,6 +495,10 @@ main(int argc, char *argv[])
     /* if we are started with -nofork, we do not weant to go into the
      * background here. So we can simply be the child process.
      */
+
+    /* the log writer thread does neither survive fork() nor execv() */
+    olsr_log_stop_writer();
+
     switch (olsr_cnf->no_fork ? 0 : fork()) {
       int i;
     case 0:
@@ -510,12 +543,10 @@ main(int argc, char *argv[])
  *@param signal the signal that triggered this callback
  */
 static void
-signal_reconfigure(int signo __attribute__ ((unused)))
+signal_reconfigure(int signo)
 {
-  const int save_errno = errno;
-  OLSR_INFO(LOG_MAIN, "Received signal %d - requesting reconfiguration", signo);
+  received_signal = signo;
   app_state = STATE_RECONFIGURE;
-  errno = save_errno;
 }
 
 #endif
@@ -530,13 +561,11 @@ int __stdcall
 SignalHandler(unsigned long signo)
 #else
 static void
-signal_shutdown(int signo __attribute__ ((unused)))
+signal_shutdown(int signo)
 #endif
 {
-  const int save_errno = errno;
-  OLSR_INFO(LOG_MAIN, "Received signal %d - requesting shutdown", (int)signo);
+  received_signal = signo;
   app_state = STATE_SHUTDOWN;
-  errno = save_errno;
 #ifdef WIN32
   return 0;
 #endif
@@ -585,6 +614,7 @@ olsr_shutdown(void)
   os_close(olsr_cnf->ioctl_s);
 
 #if defined linux
+  olsr_os_netlink_cleanup();
   os_close(olsr_cnf->rtnl_s);
 #endif
 
@@ -82,6 +82,7 @@ olsr_init_mid_set(void)
    * Get some cookies for getting stats to ease troubleshooting.
    */
   mid_validity_timer_info = olsr_timer_add("MID validity", &olsr_expire_mid_entries, false);
+  mid_validity_timer_info->coalescing = OLSR_TIMER_VALIDITY_COALESCING;
 
   mid_address_mem_cookie = olsr_memcookie_add("MID address", sizeof(struct mid_entry));
 }
@@ -495,9 +496,9 @@ olsr_input_mid(struct olsr_message *msg,
 void
 generate_mid(void *p  __attribute__ ((unused))) {
   struct interface *ifp, *allif, *iterator;
+  struct olsr_packet_buffer *pktbuf;
   struct olsr_message msg;
-  uint8_t msg_buffer[MAXMESSAGESIZE - OLSR_HEADERSIZE] __attribute__ ((aligned));
-  uint8_t *curr = msg_buffer;
+  uint8_t *msg_buffer, *curr;
   uint8_t *length_field, *last;
   bool sendMID = false;
 
@@ -511,15 +512,17 @@ generate_mid(void *p  __attribute__ ((unused))) {
   msg.hopcnt = 0;
   msg.seqno = get_msg_seqno();
 
-  curr = msg_buffer;
+  pktbuf = net_alloc_packet_buffer();
+  msg_buffer = curr = pktbuf->data;
 
   length_field = olsr_put_msg_hdr(&curr, &msg);
 
-  last = msg_buffer + sizeof(msg_buffer) - olsr_cnf->ipsize;
+  last = msg_buffer + MAXMESSAGESIZE - OLSR_HEADERSIZE - olsr_cnf->ipsize;
   OLSR_FOR_ALL_INTERFACES(allif, iterator) {
     if (olsr_ipcmp(&olsr_cnf->router_id, &allif->ip_addr) != 0) {
       if (curr > last) {
         OLSR_WARN(LOG_MID, "Warning, too many interfaces for MID packet\n");
+        net_unlock_packet_buffer(pktbuf);
         return;
       }
       pkt_put_ipaddress(&curr, &allif->ip_addr);
@@ -527,19 +530,14 @@ generate_mid(void *p  __attribute__ ((unused))) {
     }
   }
 
-  if (!sendMID) {
-    return;
-  }
-
-  pkt_put_u16(&length_field, curr - msg_buffer);
+  if (sendMID) {
+    pkt_put_u16(&length_field, curr - msg_buffer);
 
-  OLSR_FOR_ALL_INTERFACES(ifp, iterator) {
-    if (net_outbuffer_bytes_left(ifp) < curr - msg_buffer) {
-      net_output(ifp);
-      set_buffer_timer(ifp);
+    OLSR_FOR_ALL_INTERFACES(ifp, iterator) {
+      net_schedule_message(ifp, msg_buffer, curr - msg_buffer, OLSR_PRIO_LOCAL, pktbuf);
     }
-    net_outbuffer_push(ifp, msg_buffer, curr - msg_buffer);
   }
+  net_unlock_packet_buffer(pktbuf);
 }
 /*
  * Local Variables:
@@ -54,11 +54,15 @@
 #include "link_set.h"
 #include "net_olsr.h"
 #include "olsr_logging.h"
+#include "olsr_stats.h"
 
 /* Root of the one hop and two hop neighbor trees */
 struct avl_tree nbr_tree;
 struct avl_tree nbr2_tree;
 
+/* 2-hop neighbors which need a new MPR selection */
+struct list_entity nbr2_mpr_dirty_list;
+
 /* memory management */
 static struct olsr_memcookie_info *nbr2_mem_cookie = NULL;
 static struct olsr_memcookie_info *nbr_mem_cookie = NULL;
@@ -67,9 +71,30 @@ static struct olsr_memcookie_info *nbr_connector_mem_cookie = NULL;
 /* neighbor connection validity timer */
 static struct olsr_timer_info *nbr_connector_timer_info = NULL;
 
+/* size of the neighbor tables */
+static struct olsr_stats stats_nbr, stats_nbr2;
+
 static void olsr_expire_nbr_con(void *);
 static void internal_delete_nbr_con(struct nbr_con *connector);
 
+/**
+ * @return number of 1-hop neighbors
+ */
+static uint64_t
+olsr_get_nbr_count(void)
+{
+  return nbr_tree.count;
+}
+
+/**
+ * @return number of 2-hop neighbors
+ */
+static uint64_t
+olsr_get_nbr2_count(void)
+{
+  return nbr2_tree.count;
+}
+
 /*
  * Init neighbor tables.
  */
@@ -79,6 +104,7 @@ olsr_init_neighbor_table(void)
   OLSR_INFO(LOG_NEIGHTABLE, "Initializing neighbor tree.\n");
   avl_init(&nbr_tree, avl_comp_default, false, NULL);
   avl_init(&nbr2_tree, avl_comp_default, false, NULL);
+  list_init_head(&nbr2_mpr_dirty_list);
 
   nbr_connector_timer_info = olsr_timer_add("Neighbor connector", &olsr_expire_nbr_con, false);
   nbr_connector_mem_cookie = olsr_memcookie_add("Neighbor connector", sizeof(struct nbr_con));
@@ -86,6 +112,11 @@ olsr_init_neighbor_table(void)
   nbr_mem_cookie = olsr_memcookie_add("1-Hop Neighbor", sizeof(struct nbr_entry));
 
   nbr2_mem_cookie = olsr_memcookie_add("2-Hop Neighbor", sizeof(struct nbr2_entry));
+
+  olsr_stats_add(&stats_nbr, "olsr_neighbors", "Entries in the 1-hop neighbor table", OLSR_STATS_GAUGE);
+  stats_nbr.get_value = olsr_get_nbr_count;
+  olsr_stats_add(&stats_nbr2, "olsr_two_hop_neighbors", "Entries in the 2-hop neighbor table", OLSR_STATS_GAUGE);
+  stats_nbr2.get_value = olsr_get_nbr2_count;
 }
 
 /**
@@ -153,12 +184,19 @@ void
 olsr_delete_nbr_entry(struct nbr_entry *nbr)
 {
   struct nbr_con *connector, *iterator;
+  struct nbr2_entry *nbr2;
 #if !defined REMOVE_LOG_DEBUG
   struct ipaddr_str buf;
 #endif
 
   OLSR_DEBUG(LOG_NEIGHTABLE, "Delete 1-hop neighbor: %s\n", olsr_ip_to_string(&buf, &nbr->nbr_addr));
 
+  /* a 2-hop neighbor with the same address lost its direct link */
+  nbr2 = olsr_lookup_nbr2_entry(&nbr->nbr_addr, false);
+  if (nbr2) {
+    olsr_nbr2_set_mpr_dirty(nbr2);
+  }
+
   /*
    * Remove all references pointing to this neighbor.
    */
@@ -213,6 +251,27 @@ olsr_lookup_nbr_entry(const union olsr_ip_addr *addr, bool lookupalias)
   return nbr;
 }
 
+/**
+ * Queue all 2-hop neighbors for MPR calculation which are
+ * affected by a change of the symmetry of a neighbor.
+ * @param nbr pointer to neighbor
+ */
+static void
+olsr_nbr_set_mpr_dirty(struct nbr_entry *nbr)
+{
+  struct nbr_con *connector, *iterator;
+  struct nbr2_entry *nbr2;
+
+  OLSR_FOR_ALL_NBR_CON_ENTRIES(nbr, connector, iterator) {
+    olsr_nbr2_set_mpr_dirty(connector->nbr2);
+  }
+
+  nbr2 = olsr_lookup_nbr2_entry(&nbr->nbr_addr, false);
+  if (nbr2) {
+    olsr_nbr2_set_mpr_dirty(nbr2);
+  }
+}
+
 void olsr_update_nbr_status(struct nbr_entry *entry) {
 #if !defined REMOVE_LOG_DEBUG
   struct ipaddr_str buf;
@@ -240,6 +299,7 @@ void olsr_update_nbr_status(struct nbr_entry *entry) {
       if (olsr_cnf->tc_redundancy > 1 || entry->is_mpr) {
         signal_link_changes(true);
       }
+      olsr_nbr_set_mpr_dirty(entry);
     }
     entry->is_sym = true;
     OLSR_DEBUG(LOG_NEIGHTABLE, "Neighbor %s is now symmetric\n", olsr_ip_to_string(&buf, &entry->nbr_addr));
@@ -250,6 +310,7 @@ void olsr_update_nbr_status(struct nbr_entry *entry) {
         signal_link_changes(true);
         changes_topology = true;
       }
+      olsr_nbr_set_mpr_dirty(entry);
     }
     /* else N_status is set to NOT_SYM */
     entry->is_sym = false;
@@ -317,6 +378,10 @@ olsr_delete_nbr2_entry(struct nbr2_entry *nbr2) {
     internal_delete_nbr_con(connector);
   }
 
+  if (list_node_added(&nbr2->mpr_dirty_node)) {
+    list_remove(&nbr2->mpr_dirty_node);
+  }
+
   /* Remove from global neighbor tree */
   avl_delete(&nbr2_tree, &nbr2->nbr2_node);
 
@@ -380,6 +445,7 @@ olsr_link_nbr_nbr2(struct nbr_entry *nbr, const union olsr_ip_addr *nbr2_addr, u
   avl_insert(&nbr2->con_tree, &connector->nbr2_tree_node);
 
   connector->path_linkcost = LINK_COST_BROKEN;
+  olsr_nbr2_set_mpr_dirty(nbr2);
 
   connector->nbr2_con_timer = olsr_timer_start(vtime, OLSR_NBR2_LIST_JITTER,
       connector, nbr_connector_timer_info);
@@ -396,6 +462,11 @@ internal_delete_nbr_con(struct nbr_con *connector) {
   olsr_timer_stop(connector->nbr2_con_timer);
   connector->nbr2_con_timer = NULL;
 
+  if (connector->mpr_selected) {
+    connector->nbr->mpr_cover_count--;
+  }
+  olsr_nbr2_set_mpr_dirty(connector->nbr2);
+
   avl_delete(&connector->nbr->con_tree, &connector->nbr_tree_node);
   avl_delete(&connector->nbr2->con_tree, &connector->nbr2_tree_node);
 
@@ -47,10 +47,9 @@
 #include "olsr_clock.h"
 #include "olsr_types.h"
 #include "common/avl.h"
+#include "common/list.h"
 #include "tc_set.h"
 
-#define NB2S_COVERED  0x1     /* node has been covered by a MPR */
-
 /*
  * This is a connector between a neighbor and a two-hop neighbor
  */
@@ -65,6 +64,8 @@ struct nbr_con {
 
   olsr_linkcost second_hop_linkcost;
   olsr_linkcost path_linkcost;
+
+  bool mpr_selected;                   /* nbr is a MPR covering nbr2 */
 };
 
 
@@ -78,8 +79,8 @@ struct nbr_entry {
   unsigned int is_sym:1;
   unsigned int is_mpr:1;
   unsigned int was_mpr:1;              /* Used to detect changes in MPR */
-  unsigned int skip:1; 
   unsigned int mprs_count:16;          /* >0 if we are choosen as an MPR by this neighbor */
+  unsigned int mpr_cover_count;        /* number of 2-hop neighbors covered as MPR */
   unsigned int linkcount;
   struct avl_tree con_tree;            /* subtree for connectors to nbr2 */
 };
@@ -88,8 +89,7 @@ struct nbr_entry {
 struct nbr2_entry {
   struct avl_node nbr2_node;
   union olsr_ip_addr nbr2_addr;
-  unsigned int mpr_covered_count;      /* Used in mpr calculation */
-  unsigned int processed:1;            /* Used in mpr calculation */
+  struct list_entity mpr_dirty_node;   /* queue for MPR recalculation */
   struct avl_tree con_tree;            /* subtree for connectors to nbr */
 };
 
@@ -123,9 +123,22 @@ struct nbr2_entry {
  */
 extern struct avl_tree EXPORT(nbr_tree);
 extern struct avl_tree EXPORT(nbr2_tree);
+extern struct list_entity nbr2_mpr_dirty_list;
 
 void olsr_init_neighbor_table(void);
 
+/**
+ * Queue a 2-hop neighbor whose connectors have changed
+ * for the next MPR calculation.
+ */
+static INLINE void
+olsr_nbr2_set_mpr_dirty(struct nbr2_entry *nbr2)
+{
+  if (!list_node_added(&nbr2->mpr_dirty_node)) {
+    list_add_tail(&nbr2_mpr_dirty_list, &nbr2->mpr_dirty_node);
+  }
+}
+
 /* work with 1-hop neighbors */
 struct nbr_entry *olsr_add_nbr_entry(const union olsr_ip_addr *);
 void olsr_delete_nbr_entry(struct nbr_entry *);
@@ -48,6 +48,7 @@
 #include "link_set.h"
 #include "lq_packet.h"
 #include "olsr_logging.h"
+#include "olsr_memcookie.h"
 
 #include <stdlib.h>
 #include <assert.h>
@@ -56,6 +57,7 @@
 
 static void olsr_add_invalid_address(const union olsr_ip_addr *);
 static void olsr_expire_buffer_timer(void *context);
+static int net_output_enqueue(struct interface *);
 
 #if 0                           // WIN32
 #define perror(x) WinSockPError(x)
@@ -77,6 +79,33 @@ struct ptf {
 
 static struct ptf *ptf_list;
 
+/* number of packets queued for sending before the queue is flushed */
+#define OLSR_OUTPUT_QUEUE 32
+
+/*
+ * Finished packet waiting to be sent. The buffer contains the
+ * packet header and the copied messages, forwarded messages are
+ * added as segments pointing into the received packets.
+ */
+struct net_output_entry {
+  struct interface *ifp;
+  struct os_packet pkt;
+  uint8_t buffer[MAXMESSAGESIZE];
+  struct os_packet_segment segments[2 * OLSR_NETBUF_FORWARDS];
+  struct olsr_packet_buffer *refs[OLSR_NETBUF_FORWARDS];
+  int ref_count;
+};
+
+/*
+ * Packets waiting to be sent. The packets of each
+ * interface are sent together by net_output_flush().
+ */
+static struct net_output_entry output_queue[OLSR_OUTPUT_QUEUE];
+static int output_count = 0;
+
+/* memory cookie for received packets */
+static struct olsr_memcookie_info *packet_buffer_cookie = NULL;
+
 static const char *const deny_ipv4_defaults[] = {
   "0.0.0.0",
   "127.0.0.1",
@@ -118,6 +147,47 @@ init_net(void)
   }
 
   buffer_hold_timer_info = olsr_timer_add("Buffer writeback", olsr_expire_buffer_timer, false);
+
+  packet_buffer_cookie = olsr_memcookie_add("Packet buffer", sizeof(struct olsr_packet_buffer));
+}
+
+/**
+ * Allocate a buffer for receiving a packet.
+ * @return pointer to packet buffer with a reference count of one
+ */
+struct olsr_packet_buffer *
+net_alloc_packet_buffer(void)
+{
+  struct olsr_packet_buffer *pktbuf;
+
+  pktbuf = olsr_memcookie_malloc(packet_buffer_cookie);
+  pktbuf->refcount = 1;
+  return pktbuf;
+}
+
+/**
+ * Add a reference to a packet buffer.
+ * @param pktbuf pointer to packet buffer
+ */
+void
+net_lock_packet_buffer(struct olsr_packet_buffer *pktbuf)
+{
+  pktbuf->refcount++;
+}
+
+/**
+ * Remove a reference from a packet buffer and free it
+ * if the reference count went down to zero.
+ * @param pktbuf pointer to packet buffer
+ */
+void
+net_unlock_packet_buffer(struct olsr_packet_buffer *pktbuf)
+{
+  assert(pktbuf->refcount > 0);
+
+  if (--pktbuf->refcount == 0) {
+    olsr_memcookie_free(packet_buffer_cookie, pktbuf);
+  }
 }
 
 /**
@@ -140,13 +210,13 @@ olsr_expire_buffer_timer(void *context)
   /*
    * Do we have something to emit ?
    */
-  if (!net_output_pending(ifn)) {
+  if (!net_output_pending(ifn) && ifn->netbuf.scheduled_count == 0) {
     return;
   }
 
   OLSR_DEBUG(LOG_NETWORKING, "Buffer Holdtimer for %s timed out, sending data.\n", ifn->int_name);
 
-  net_output(ifn);
+  net_schedule_flush(ifn);
 }
 
 /*
@@ -215,7 +285,9 @@ net_add_buffer(struct interface *ifp)
   ifp->netbuf.maxsize = ifp->int_mtu - OLSR_HEADERSIZE;
 
   ifp->netbuf.pending = 0;
+  ifp->netbuf.copied = 0;
   ifp->netbuf.reserved = 0;
+  ifp->netbuf.forward_count = 0;
 
   return 0;
 }
@@ -232,9 +304,8 @@ void
 net_remove_buffer(struct interface *ifp)
 {
   /* Flush pending data */
-  if (ifp->netbuf.pending != 0) {
-    net_output(ifp);
-  }
+  net_schedule_flush(ifp);
+  net_output_flush();
   free(ifp->netbuf.buff);
   ifp->netbuf.buff = NULL;
 }
@@ -285,12 +356,211 @@ net_outbuffer_push(struct interface *ifp, const void *data, const uint16_t size)
   if (ifp->netbuf.pending + size > ifp->netbuf.maxsize) {
     return 0;
   }
-  memcpy(&ifp->netbuf.buff[ifp->netbuf.pending + OLSR_HEADERSIZE], data, size);
+  memcpy(&ifp->netbuf.buff[ifp->netbuf.copied + OLSR_HEADERSIZE], data, size);
+  ifp->netbuf.pending += size;
+  ifp->netbuf.copied += size;
+  ifp->netbuf.stat_messages++;
+
+  return size;
+}
+
+/**
+ * Add a forwarded message to a buffer. The message is not copied,
+ * the buffer keeps a reference to the received packet instead.
+ * The message is copied with net_outbuffer_push() if it is not
+ * stored in a packet buffer, if all references of the output
+ * buffer are in use or if packet transform functions are registered.
+ *
+ * @param ifp the interface corresponding to the buffer
+ * @param data a pointer to the message
+ * @param size the length of the message
+ * @param pktbuf the packet buffer containing the message, might be NULL
+ *
+ * @return 0 if there was not enough room in buffer or
+ *  the number of bytes added on success
+ */
+int
+net_outbuffer_forward(struct interface *ifp, const void *data, const uint16_t size, struct olsr_packet_buffer *pktbuf)
+{
+  struct olsr_netbuf_forward *fwd;
+
+  if (pktbuf == NULL || ptf_list != NULL || ifp->netbuf.forward_count == OLSR_NETBUF_FORWARDS) {
+    return net_outbuffer_push(ifp, data, size);
+  }
+
+  if (ifp->netbuf.pending + size > ifp->netbuf.maxsize) {
+    return 0;
+  }
+
+  assert((const uint8_t *)data >= pktbuf->data
+      && (const uint8_t *)data + size <= pktbuf->data + sizeof(pktbuf->data));
+
+  fwd = &ifp->netbuf.forward[ifp->netbuf.forward_count++];
+  fwd->pktbuf = pktbuf;
+  fwd->data = &pktbuf->data[(const uint8_t *)data - pktbuf->data];
+  fwd->size = size;
+  fwd->offset = ifp->netbuf.copied;
+
+  net_lock_packet_buffer(pktbuf);
   ifp->netbuf.pending += size;
+  ifp->netbuf.stat_messages++;
 
   return size;
 }
 
+/**
+ * Build one packet from the messages waiting for the output
+ * scheduler and send it. Messages are packed in order of their
+ * priority class. A message which does not fit into the remaining
+ * space is skipped in favor of smaller messages behind it, it will
+ * be the first one of its class in the next packet.
+ *
+ * @param ifp the interface to send on
+ */
+static void
+net_schedule_pack(struct interface *ifp)
+{
+  struct olsr_netbuf_message *msg;
+  int priority, i, j;
+
+  for (priority = 0; priority < OLSR_PRIO_COUNT; priority++) {
+    for (i = 0; i < ifp->netbuf.scheduled_count; i++) {
+      msg = &ifp->netbuf.scheduled[i];
+      if (msg->pktbuf == NULL || msg->priority != priority || msg->size > net_outbuffer_bytes_left(ifp)) {
+        continue;
+      }
+
+      net_outbuffer_forward(ifp, msg->data, msg->size, msg->pktbuf);
+      ifp->netbuf.scheduled_bytes -= msg->size;
+
+      /* the output buffer has its own reference now */
+      net_unlock_packet_buffer(msg->pktbuf);
+      msg->pktbuf = NULL;
+    }
+  }
+
+  /* remove the packed messages from the queue, keeping the order of the rest */
+  for (i = 0, j = 0; i < ifp->netbuf.scheduled_count; i++) {
+    if (ifp->netbuf.scheduled[i].pktbuf != NULL) {
+      ifp->netbuf.scheduled[j++] = ifp->netbuf.scheduled[i];
+    }
+  }
+  ifp->netbuf.scheduled_count = j;
+
+  net_output_enqueue(ifp);
+}
+
+/**
+ * Send all messages waiting for the output scheduler of
+ * an interface, together with the data already in its
+ * output buffer.
+ *
+ * @param ifp the interface to send on
+ */
+void
+net_schedule_flush(struct interface *ifp)
+{
+  do {
+    net_schedule_pack(ifp);
+  } while (ifp->netbuf.scheduled_count > 0);
+}
+
+/**
+ * Queue a message for the output scheduler of an interface.
+ * Messages are collected until the aggregation window of the
+ * interface ends, a full packet is sent as soon as it can be
+ * built. A HELLO ends the window immediately.
+ *
+ * @param ifp the interface to send on
+ * @param data a pointer to the message
+ * @param size the length of the message
+ * @param priority the priority class of the message
+ * @param pktbuf the packet buffer containing the message, it gets
+ *  referenced instead of copied. The core generators and the forwarding
+ *  path always pass one, NULL (plugins) makes a private copy.
+ */
+void
+net_schedule_message(struct interface *ifp, const void *data, const uint16_t size,
+    enum olsr_output_priority priority, struct olsr_packet_buffer *pktbuf)
+{
+  struct olsr_netbuf_message *msg;
+
+  if (size > ifp->netbuf.maxsize) {
+    OLSR_WARN(LOG_NETWORKING, "Message too big to be sent on %s (%d bytes)!\n", ifp->int_name, size);
+    return;
+  }
+
+  while (ifp->netbuf.scheduled_count == OLSR_NETBUF_SCHEDULED) {
+    /* queue is full, make room */
+    net_schedule_pack(ifp);
+  }
+
+  msg = &ifp->netbuf.scheduled[ifp->netbuf.scheduled_count++];
+  if (pktbuf != NULL) {
+    assert((const uint8_t *)data >= pktbuf->data
+        && (const uint8_t *)data + size <= pktbuf->data + sizeof(pktbuf->data));
+
+    net_lock_packet_buffer(pktbuf);
+    msg->data = &pktbuf->data[(const uint8_t *)data - pktbuf->data];
+  }
+  else {
+    pktbuf = net_alloc_packet_buffer();
+    memcpy(pktbuf->data, data, size);
+    msg->data = pktbuf->data;
+  }
+  msg->pktbuf = pktbuf;
+  msg->size = size;
+  msg->priority = priority;
+  ifp->netbuf.scheduled_bytes += size;
+
+  if (priority == OLSR_PRIO_HELLO) {
+    net_schedule_flush(ifp);
+    return;
+  }
+
+  /* send full packets now, the rest waits for the end of the window */
+  while (ifp->netbuf.pending + ifp->netbuf.scheduled_bytes >= ifp->netbuf.maxsize) {
+    net_schedule_pack(ifp);
+  }
+
+  if (ifp->netbuf.scheduled_count > 0) {
+    set_buffer_timer(ifp);
+  }
+}
+
+/**
+ * Copy all forwarded messages referenced by an output buffer into
+ * the buffer itself, so that the whole packet is in one piece.
+ *
+ * @param ifp the interface corresponding to the buffer
+ */
+static void
+net_outbuffer_linearize(struct interface *ifp)
+{
+  struct olsr_netbuf_forward *fwd;
+  uint8_t *payload;
+  int i, shift, end;
+
+  payload = &ifp->netbuf.buff[OLSR_HEADERSIZE];
+  shift = ifp->netbuf.pending - ifp->netbuf.copied;
+  end = ifp->netbuf.copied;
+
+  /* start with the last message, so nothing is overwritten before it has been moved */
+  for (i = ifp->netbuf.forward_count - 1; i >= 0; i--) {
+    fwd = &ifp->netbuf.forward[i];
+
+    memmove(payload + fwd->offset + shift, payload + fwd->offset, end - fwd->offset);
+    shift -= fwd->size;
+    memcpy(payload + fwd->offset + shift, fwd->data, fwd->size);
+
+    net_unlock_packet_buffer(fwd->pktbuf);
+    end = fwd->offset;
+  }
+
+  ifp->netbuf.copied = ifp->netbuf.pending;
+  ifp->netbuf.forward_count = 0;
+}
+
 #if 0
 
 /**
@@ -310,8 +580,9 @@ net_outbuffer_push_reserved(struct interface *ifp, const void *data, const uint1
   if (ifp->netbuf.pending + size > ifp->netbuf.maxsize + ifp->netbuf.reserved) {
     return 0;
   }
-  memcpy(&ifp->netbuf.buff[ifp->netbuf.pending + OLSR_HEADERSIZE], data, size);
+  memcpy(&ifp->netbuf.buff[ifp->netbuf.copied + OLSR_HEADERSIZE], data, size);
   ifp->netbuf.pending += size;
+  ifp->netbuf.copied += size;
 
   return size;
 }
@@ -366,58 +637,235 @@ del_ptf(packet_transform_function f)
 #endif
 
 /**
- *Sends a packet on a given interface.
+ * Prepare an output queue entry for a finished packet. The packet
+ * consists of the buffer with the header and the copied messages
+ * and one segment for each forwarded message, in the order the
+ * messages were added. The references of the forwarded messages
+ * are moved from the output buffer to the entry.
  *
- *@param ifp the interface to send on.
+ * @param entry pointer to output queue entry
+ * @param ifp the interface to send on
+ * @param base buffer with the packet header and the copied messages
+ * @param copied length of the data in the buffer
+ */
+static void
+net_output_prepare(struct net_output_entry *entry, struct interface *ifp, uint8_t *base, int copied)
+{
+  struct olsr_netbuf_forward *fwd;
+  struct os_packet_segment *segment;
+  int i, start, end;
+
+  entry->ifp = ifp;
+  entry->pkt.buf = base;
+  entry->pkt.addr = ifp->int_multicast;
+  entry->pkt.segments = entry->segments;
+  entry->pkt.segment_count = 0;
+
+  /* copied data in front of the first forwarded message */
+  end = copied - OLSR_HEADERSIZE;
+  if (ifp->netbuf.forward_count > 0) {
+    end = ifp->netbuf.forward[0].offset;
+  }
+  entry->pkt.len = OLSR_HEADERSIZE + end;
+
+  for (i = 0; i < ifp->netbuf.forward_count; i++) {
+    fwd = &ifp->netbuf.forward[i];
+
+    segment = &entry->segments[entry->pkt.segment_count++];
+    segment->buf = fwd->data;
+    segment->len = fwd->size;
+    entry->refs[i] = fwd->pktbuf;
+
+    /* copied data behind the forwarded message */
+    start = fwd->offset;
+    end = copied - OLSR_HEADERSIZE;
+    if (i + 1 < ifp->netbuf.forward_count) {
+      end = ifp->netbuf.forward[i + 1].offset;
+    }
+    if (end > start) {
+      segment = &entry->segments[entry->pkt.segment_count++];
+      segment->buf = base + OLSR_HEADERSIZE + start;
+      segment->len = end - start;
+    }
+  }
+
+  entry->ref_count = ifp->netbuf.forward_count;
+  ifp->netbuf.forward_count = 0;
+}
+
+/**
+ * Release the received packets referenced by an output queue entry.
  *
- *@return negative on error
+ * @param entry pointer to output queue entry
  */
-int
-net_output(struct interface *ifp)
+static void
+net_output_release(struct net_output_entry *entry)
+{
+  int i;
+
+  for (i = 0; i < entry->ref_count; i++) {
+    net_unlock_packet_buffer(entry->refs[i]);
+  }
+  entry->ref_count = 0;
+}
+
+/**
+ * Log an error while sending a packet.
+ *
+ * @param ifp the interface the packet was sent on.
+ * @param len length of the packet
+ */
+static void
+net_output_error(struct interface *ifp, size_t len)
+{
+#if !defined REMOVE_LOG_WARN
+  const int save_errno = errno;
+  struct ipaddr_str buf;
+#endif
+  OLSR_WARN(LOG_NETWORKING, "sending %d bytes (IPv%d) to %s:%d on interface %s/%d: %s (%d)\n",
+          (int)len, olsr_cnf->ip_version == AF_INET ? 4 : 6,
+          olsr_sockaddr_to_string(&buf, &ifp->int_multicast), ntohs(ifp->int_multicast.v4.sin_port),
+          ifp->int_name, ifp->if_index,
+          strerror(save_errno), save_errno);
+}
+
+/**
+ * Finish the packet in the output buffer of an interface and
+ * queue it. It is sent with the next net_output_flush(),
+ * together with the other packets for the same interface.
+ *
+ * @param ifp the interface to send on
+ * @return negative on error
+ */
+static int
+net_output_enqueue(struct interface *ifp)
 {
+  static struct net_output_entry direct;
   struct ptf *tmp_ptf;
   struct olsr_packet *outmsg;
-  int retval;
+  struct net_output_entry *entry;
+  int retval, copied, forwarded;
 
   if (ifp->netbuf.pending == 0) {
     return 0;
   }
 
-  ifp->netbuf.pending += OLSR_HEADERSIZE;
+  if (ptf_list != NULL && ifp->netbuf.forward_count > 0) {
+    /* packet transform functions work on a single buffer */
+    net_outbuffer_linearize(ifp);
+  }
 
-  retval = ifp->netbuf.pending;
+  copied = ifp->netbuf.copied + OLSR_HEADERSIZE;
+  forwarded = ifp->netbuf.pending - ifp->netbuf.copied;
 
   outmsg = (struct olsr_packet *)ifp->netbuf.buff;
   /* Add the Packet seqno */
   outmsg->seqno = htons(ifp->olsr_seqnum++);
   /* Set the packetlength */
-  outmsg->size = htons(ifp->netbuf.pending);
+  outmsg->size = htons(copied + forwarded);
 
   /*
    * Call possible packet transform functions registered by plugins
    */
   for (tmp_ptf = ptf_list; tmp_ptf != NULL; tmp_ptf = tmp_ptf->next) {
-    tmp_ptf->function(ifp->netbuf.buff, &ifp->netbuf.pending);
+    tmp_ptf->function(ifp->netbuf.buff, &copied);
   }
 
-  if (os_sendto(ifp->send_socket_fd, ifp->netbuf.buff, ifp->netbuf.pending,
-      MSG_DONTROUTE, &ifp->int_multicast) < 0) {
-#if !defined REMOVE_LOG_WARN
-    const int save_errno = errno;
-    struct ipaddr_str buf;
-#endif
-    OLSR_WARN(LOG_NETWORKING, "sending %d bytes (IPv%d) to %s:%d on interface %s/%d: %s (%d)\n",
-            ifp->netbuf.pending, olsr_cnf->ip_version == AF_INET ? 4 : 6,
-            olsr_sockaddr_to_string(&buf, &ifp->int_multicast), ntohs(ifp->int_multicast.v4.sin_port),
-            ifp->int_name, ifp->if_index,
-            strerror(save_errno), save_errno);
-    retval = -1;
+  retval = copied + forwarded;
+
+  ifp->netbuf.stat_packets++;
+  ifp->netbuf.stat_bytes += ifp->netbuf.pending;
+
+  if (copied > MAXMESSAGESIZE) {
+    /* packet is too large for the queue, send it directly but keep the order */
+    net_output_flush();
+
+    entry = &direct;
+    net_output_prepare(entry, ifp, ifp->netbuf.buff, copied);
+    if (os_sendmmsg(ifp->send_socket_fd, &entry->pkt, 1, MSG_DONTROUTE) <= 0) {
+      net_output_error(ifp, retval);
+      retval = -1;
+    }
+    net_output_release(entry);
+  }
+  else {
+    if (output_count == OLSR_OUTPUT_QUEUE) {
+      net_output_flush();
+    }
+
+    entry = &output_queue[output_count++];
+    memcpy(entry->buffer, ifp->netbuf.buff, copied);
+    net_output_prepare(entry, ifp, entry->buffer, copied);
   }
 
   ifp->netbuf.pending = 0;
+  ifp->netbuf.copied = 0;
   return retval;
 }
 
+/**
+ *Sends a packet on a given interface.
+ *This is the entry point for plugins, the packet and all packets
+ *queued before it are sent immediately. The output scheduler of the
+ *core uses net_output_enqueue() and sends once per main loop round.
+ *
+ *@param ifp the interface to send on.
+ *
+ *@return negative on error
+ */
+int
+net_output(struct interface *ifp)
+{
+  int retval;
+
+  retval = net_output_enqueue(ifp);
+  net_output_flush();
+  return retval;
+}
+
+/**
+ * Send all queued packets, one os_sendmmsg() call for all
+ * packets of an interface.
+ */
+void
+net_output_flush(void)
+{
+  struct os_packet batch[OLSR_OUTPUT_QUEUE];
+  bool done[OLSR_OUTPUT_QUEUE];
+  int i, j, count, sent, fd;
+
+  memset(done, 0, sizeof(done));
+  for (i = 0; i < output_count; i++) {
+    if (done[i]) {
+      continue;
+    }
+
+    /* collect all packets for this socket, keeping their order */
+    fd = output_queue[i].ifp->send_socket_fd;
+    count = 0;
+    for (j = i; j < output_count; j++) {
+      if (!done[j] && output_queue[j].ifp->send_socket_fd == fd) {
+        batch[count++] = output_queue[j].pkt;
+        done[j] = true;
+      }
+    }
+
+    for (j = 0; j < count; j += sent) {
+      sent = os_sendmmsg(fd, &batch[j], count - j, MSG_DONTROUTE);
+      if (sent <= 0) {
+        /* skip the failed packet */
+        net_output_error(output_queue[i].ifp, os_packet_length(&batch[j]));
+        sent = 1;
+      }
+    }
+  }
+
+  for (i = 0; i < output_count; i++) {
+    net_output_release(&output_queue[i]);
+  }
+  output_count = 0;
+}
+
 /*
  * Adds the given IP-address to the invalid list.
  */
@@ -53,6 +53,28 @@
 
 typedef int (*packet_transform_function) (uint8_t *, int *);
 
+/*
+ * Buffer of a received packet. Messages forwarded from the
+ * packet keep a reference to it until they have been sent.
+ */
+struct olsr_packet_buffer {
+  uint8_t data[MAXMESSAGESIZE];
+  uint32_t refcount;
+};
+
+/*
+ * Priority classes of the output scheduler. If not all waiting
+ * messages fit into a packet, lower values are sent first.
+ */
+enum olsr_output_priority {
+  OLSR_PRIO_HELLO,                     /* HELLO, ends the aggregation window */
+  OLSR_PRIO_LOCAL,                     /* locally generated TC, MID and HNA */
+  OLSR_PRIO_FORWARD,                   /* forwarded messages */
+
+  /* this must be the last entry */
+  OLSR_PRIO_COUNT
+};
+
 /*
  * Used for filtering addresses.
  */
@@ -107,14 +129,30 @@ int net_reserve_bufspace(struct interface *, int);
 
 int EXPORT(net_outbuffer_push) (struct interface *, const void *, const uint16_t);
 
+int net_outbuffer_forward(struct interface *, const void *, const uint16_t, struct olsr_packet_buffer *);
+
+void EXPORT(net_schedule_message) (struct interface *, const void *, const uint16_t,
+    enum olsr_output_priority, struct olsr_packet_buffer *);
+
+void net_schedule_flush(struct interface *);
+
 #if 0
 int net_outbuffer_push_reserved(struct interface *, const void *, const uint16_t);
 #endif
 
+/* sends the output buffer immediately, for use outside of the output scheduler */
 int EXPORT(net_output) (struct interface *);
 
+void EXPORT(net_output_flush) (void);
+
 void EXPORT(add_ptf) (packet_transform_function);
 
+struct olsr_packet_buffer *net_alloc_packet_buffer(void);
+
+void net_lock_packet_buffer(struct olsr_packet_buffer *);
+
+void net_unlock_packet_buffer(struct olsr_packet_buffer *);
+
 #if 0
 int del_ptf(packet_transform_function);
 #endif
@@ -66,6 +66,8 @@
 #include "net_olsr.h"
 #include "lq_plugin.h"
 #include "olsr_logging.h"
+#include "parser.h"
+#include "olsr_profile.h"
 #include "os_system.h"
 #include "os_apm.h"
 
@@ -78,6 +80,9 @@ bool changes_force = false;
 
 static uint16_t message_seqno;
 
+/* time spent in olsr_process_changes() */
+static struct olsr_profile process_changes_profile;
+
 /**
  *Initialize the message sequence number as a random value
  */
@@ -88,6 +93,15 @@ init_msg_seqno(void)
   OLSR_DEBUG(LOG_MAIN, "Settings initial message sequence number to %u\n", message_seqno);
 }
 
+/**
+ *Register the runtime profile of the change processing
+ */
+void
+olsr_init_process_changes(void)
+{
+  olsr_profile_add(&process_changes_profile, "olsr_process_changes");
+}
+
 /**
  * Get and increment the message sequence number
  *
@@ -109,6 +123,8 @@ get_msg_seqno(void)
 void
 olsr_process_changes(void)
 {
+  uint64_t start;
+
   if (changes_neighborhood)
     OLSR_DEBUG(LOG_MAIN, "CHANGES IN NEIGHBORHOOD\n");
   if (changes_topology)
@@ -119,6 +135,8 @@ olsr_process_changes(void)
   if (!changes_neighborhood && !changes_topology && !changes_hna)
     return;
 
+  start = olsr_profile_start();
+
   if (olsr_cnf->log_target_stderr && olsr_cnf->clear_screen && isatty(STDOUT_FILENO)) {
     os_clear_console();
     printf("       *** %s (%s on %s) ***\n", olsrd_version, build_date, build_host);
@@ -145,6 +163,8 @@ olsr_process_changes(void)
   changes_topology = false;
   changes_hna = false;
   changes_force = false;
+
+  olsr_profile_stop(&process_changes_profile, start);
 }
 
 /**
@@ -53,6 +53,8 @@ extern bool changes_force;             /* Maybe static */
 
 void olsr_process_changes(void);
 
+void olsr_init_process_changes(void);
+
 void init_msg_seqno(void);
 
 uint16_t EXPORT(get_msg_seqno) (void);
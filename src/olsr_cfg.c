@@ -71,6 +71,7 @@ enum cfg_long_options {
   CFG_LOG_STDERR,
   CFG_LOG_SYSLOG,
   CFG_LOG_FILE,
+  CFG_LOG_ASYNC,
 
   CFG_OLSRPORT,
   CFG_DLPATH,
@@ -86,6 +87,16 @@ enum cfg_long_options {
   CFG_MID_VTIME,
   CFG_TC_HTIME,
   CFG_TC_VTIME,
+
+  CFG_SPF_INCREMENTAL,
+  CFG_SPF_CHECK_INTERVAL,
+  CFG_SPF_INITIAL_DELAY,
+  CFG_SPF_HOLD_TIME,
+  CFG_SPF_MAX_HOLD_TIME,
+  CFG_RT_BATCH,
+  CFG_TC_CACHE,
+  CFG_TC_COST_HYSTERESIS,
+  CFG_TC_REFRESH_INTERVAL,
 };
 
 /* remember which log severities have been explicitly set */
@@ -918,6 +929,9 @@ parse_cfg_option(const int optint, char *argstr, const int line, struct olsr_con
   case CFG_LOG_FILE:
     rcfg->log_target_file = strdup(argstr);
     break;
+  case CFG_LOG_ASYNC:
+    rcfg->log_async = true;
+    break;
 
   case 's':                    /* SourceIpMode (string) */
     rcfg->source_ip_mode = (0 == strcasecmp("yes", argstr)) ? 1 : 0;
@@ -1002,6 +1016,47 @@ parse_cfg_option(const int optint, char *argstr, const int line, struct olsr_con
     rcfg->tc_params.validity_time = olsr_clock_parse_string(argstr);
     OLSR_INFO_NH(LOG_CONFIG, "TC validity: %u ms\n", rcfg->tc_params.validity_time);
     break;
+  case CFG_SPF_INCREMENTAL:
+    rcfg->spf_incremental = (0 == strcasecmp("yes", argstr));
+    OLSR_INFO_NH(LOG_CONFIG, "Incremental SPF %s\n", rcfg->spf_incremental ? "enabled" : "disabled");
+    break;
+  case CFG_SPF_CHECK_INTERVAL:
+    rcfg->spf_check_interval = olsr_clock_parse_string(argstr);
+    OLSR_INFO_NH(LOG_CONFIG, "SPF check interval: %u ms\n", rcfg->spf_check_interval);
+    break;
+  case CFG_SPF_INITIAL_DELAY:
+    rcfg->spf_initial_delay = olsr_clock_parse_string(argstr);
+    OLSR_INFO_NH(LOG_CONFIG, "SPF initial delay: %u ms\n", rcfg->spf_initial_delay);
+    break;
+  case CFG_SPF_HOLD_TIME:
+    rcfg->spf_hold_time = olsr_clock_parse_string(argstr);
+    OLSR_INFO_NH(LOG_CONFIG, "SPF hold time: %u ms\n", rcfg->spf_hold_time);
+    break;
+  case CFG_SPF_MAX_HOLD_TIME:
+    rcfg->spf_max_hold_time = olsr_clock_parse_string(argstr);
+    OLSR_INFO_NH(LOG_CONFIG, "SPF maximum hold time: %u ms\n", rcfg->spf_max_hold_time);
+    break;
+  case CFG_RT_BATCH:
+    rcfg->rt_batch = (0 == strcasecmp("yes", argstr));
+    OLSR_INFO_NH(LOG_CONFIG, "Batched route updates %s\n", rcfg->rt_batch ? "enabled" : "disabled");
+    break;
+  case CFG_TC_CACHE:
+    rcfg->tc_cache = (0 == strcasecmp("yes", argstr));
+    OLSR_INFO_NH(LOG_CONFIG, "TC cache %s\n", rcfg->tc_cache ? "enabled" : "disabled");
+    break;
+  case CFG_TC_COST_HYSTERESIS:
+    {
+      int arg = -1;
+      sscanf(argstr, "%d", &arg);
+      if (0 <= arg && arg <= 100)
+        rcfg->tc_cost_hysteresis = arg;
+      OLSR_INFO_NH(LOG_CONFIG, "TC cost hysteresis %d%%\n", rcfg->tc_cost_hysteresis);
+    }
+    break;
+  case CFG_TC_REFRESH_INTERVAL:
+    rcfg->tc_refresh_interval = olsr_clock_parse_string(argstr);
+    OLSR_INFO_NH(LOG_CONFIG, "TC refresh interval: %u ms\n", rcfg->tc_refresh_interval);
+    break;
 
   default:
     OLSR_ERROR(LOG_CONFIG, "Unknown arg in line %d.\n", line);
@@ -1078,6 +1133,7 @@ olsr_parse_cfg(int argc, char *argv[], const char *file, struct olsr_config ** r
     {"log_stderr",               no_argument,       0, CFG_LOG_STDERR},
     {"log_syslog",               no_argument,       0, CFG_LOG_SYSLOG},
     {"log_file",                 required_argument, 0, CFG_LOG_FILE}, /* (filename) */
+    {"log_async",                no_argument,       0, CFG_LOG_ASYNC},
     {"nofork",                   no_argument,       0, 'n'},
     {"version",                  no_argument,       0, 'v'},
     {"AllowNoInt",               required_argument, 0, 'A'}, /* (yes/no) */
@@ -1115,6 +1171,15 @@ olsr_parse_cfg(int argc, char *argv[], const char *file, struct olsr_config ** r
     {"MidValidityTime",          required_argument, 0, CFG_MID_VTIME},  /* (f) */
     {"HnaInterval",              required_argument, 0, CFG_HNA_HTIME},  /* (f) */
     {"HnaValidityTime",          required_argument, 0, CFG_HNA_VTIME},  /* (f) */
+    {"IncrementalSpf",           required_argument, 0, CFG_SPF_INCREMENTAL},    /* (yes/no) */
+    {"SpfCheckInterval",         required_argument, 0, CFG_SPF_CHECK_INTERVAL}, /* (f) */
+    {"SpfInitialDelay",          required_argument, 0, CFG_SPF_INITIAL_DELAY},  /* (f) */
+    {"SpfHoldTime",              required_argument, 0, CFG_SPF_HOLD_TIME},      /* (f) */
+    {"SpfMaxHoldTime",           required_argument, 0, CFG_SPF_MAX_HOLD_TIME},  /* (f) */
+    {"RtBatch",                  required_argument, 0, CFG_RT_BATCH},           /* (yes/no) */
+    {"TcCache",                  required_argument, 0, CFG_TC_CACHE},           /* (yes/no) */
+    {"TcCostHysteresis",         required_argument, 0, CFG_TC_COST_HYSTERESIS}, /* (i) */
+    {"TcRefreshInterval",        required_argument, 0, CFG_TC_REFRESH_INTERVAL},/* (f) */
 
     {"IpcConnect",               required_argument, 0,  0 }, /* ignored */
     {"UseHysteresis",            required_argument, 0,  0 }, /* ignored */
@@ -1356,6 +1421,13 @@ olsr_sanity_check_cfg(struct olsr_config *cfg)
     return -1;
   }
 
+  /* SPF throttling */
+  if (cfg->spf_hold_time > cfg->spf_max_hold_time) {
+    fprintf(stderr, "SPF hold time %s is larger than the maximum hold time\n",
+        olsr_clock_to_string(&tbuf, cfg->spf_hold_time));
+    return -1;
+  }
+
   /* check OLSR port */
   if (cfg->olsr_port == 0) {
     fprintf(stderr, "0 is not a valid UDP port\n");
@@ -1371,6 +1443,13 @@ olsr_sanity_check_cfg(struct olsr_config *cfg)
     return -1;
   }
 
+  /* TC cache, refreshing more often than the TC interval makes no sense */
+  if (cfg->tc_cache && cfg->tc_refresh_interval < cfg->tc_params.emission_interval) {
+    fprintf(stderr, "Warning, TC refresh interval %s is smaller than the TC interval, using the TC interval\n",
+        olsr_clock_to_string(&tbuf, cfg->tc_refresh_interval));
+    cfg->tc_refresh_interval = cfg->tc_params.emission_interval;
+  }
+
   /* MID interval */
   if (cfg->mid_params.emission_interval < cfg->pollrate ||
       cfg->mid_params.emission_interval > cfg->mid_params.validity_time) {
@@ -1522,6 +1601,7 @@ olsr_get_default_cfg(void)
   cfg->log_target_stderr = true;
   assert(cfg->log_target_file == NULL);
   assert(cfg->log_target_syslog == false);
+  assert(cfg->log_async == false);
 
   assert(cfg->plugins == NULL);
   list_init_head(&cfg->hna_entries);
@@ -1533,6 +1613,15 @@ olsr_get_default_cfg(void)
   cfg->tc_redundancy = TC_REDUNDANCY;
   cfg->mpr_coverage = MPR_COVERAGE;
   cfg->lq_fish = DEF_LQ_FISH;
+  cfg->spf_incremental = DEF_SPF_INCREMENTAL;
+  cfg->spf_check_interval = DEF_SPF_CHECK_INTERVAL;
+  cfg->spf_initial_delay = DEF_SPF_INITIAL_DELAY;
+  cfg->spf_hold_time = DEF_SPF_HOLD_TIME;
+  cfg->spf_max_hold_time = DEF_SPF_MAX_HOLD_TIME;
+  cfg->rt_batch = DEF_RT_BATCH;
+  cfg->tc_cache = DEF_TC_CACHE;
+  cfg->tc_cost_hysteresis = DEF_TC_COST_HYSTERESIS;
+  cfg->tc_refresh_interval = DEF_TC_REFRESH_INTERVAL;
 
   cfg->olsr_port = OLSRPORT;
   assert(cfg->dlPath == NULL);
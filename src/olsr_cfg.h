@@ -60,6 +60,15 @@
 #define DEF_HTTPLIMIT          3
 #define DEF_TXTPORT            2006
 #define DEF_TXTLIMIT           3
+#define DEF_SPF_INCREMENTAL    false
+#define DEF_SPF_CHECK_INTERVAL 60000
+#define DEF_SPF_INITIAL_DELAY  50
+#define DEF_SPF_HOLD_TIME      1000
+#define DEF_SPF_MAX_HOLD_TIME  5000
+#define DEF_RT_BATCH           true
+#define DEF_TC_CACHE           false
+#define DEF_TC_COST_HYSTERESIS 10
+#define DEF_TC_REFRESH_INTERVAL 30000
 
 /* Bounds */
 
@@ -187,6 +196,9 @@ struct olsr_config {
   unsigned char willingness_auto:1;    /* Willingness in auto mode? */
   unsigned char clear_screen:1;        /* Clear screen during debug output? */
   unsigned char source_ip_mode:1;      /* Run OLSR routing in sourceip mode */
+  unsigned char spf_incremental:1;     /* Update SPF results incrementally? */
+  unsigned char rt_batch:1;            /* Batch kernel route updates (linux only) */
+  unsigned char tc_cache:1;            /* Cache generated TC messages between changes? */
 
   uint16_t tos;                        /* IP Type of Service Byte */
   uint8_t rt_proto;                     /* Policy routing proto, 0 == operating sys default */
@@ -199,6 +211,7 @@ struct olsr_config {
   bool log_target_stderr;              /* Log output to stderr? */
   char *log_target_file;               /* Filename for log output file, NULL if unused */
   bool log_target_syslog;              /* Log output also to syslog? */
+  bool log_async;                      /* Write log output from a separate thread? */
 
   struct plugin_entry *plugins;        /* List of plugins to load with plparams */
   struct list_entity hna_entries;      /* List of manually configured HNA entries */
@@ -206,10 +219,16 @@ struct olsr_config {
 
   uint32_t pollrate;               /* Main loop poll rate, in milliseconds */
   uint32_t nic_chgs_pollrate;      /* Interface poll rate */
+  uint32_t spf_check_interval;     /* Interval of full SPF runs checking the incremental SPF, 0 == off */
+  uint32_t spf_initial_delay;      /* Delay of the first SPF run after a quiet period */
+  uint32_t spf_hold_time;          /* Minimum time between two SPF runs */
+  uint32_t spf_max_hold_time;      /* Maximum time between two SPF runs during bursts of changes */
+  uint32_t tc_refresh_interval;    /* Interval of full TC regenerations if the TC cache is used */
   uint32_t lq_nat_thresh;              /* Link quality NAT threshold, 1000 == unused */
   uint8_t tc_redundancy;               /* TC anncoument mode, 0=only MPR, 1=MPR+MPRS, 2=All sym neighs */
   uint8_t mpr_coverage;                /* How many additional MPRs should be selected */
   uint8_t lq_fish;                     /* 0==Fisheye off, 1=Fisheye on */
+  uint8_t tc_cost_hysteresis;          /* Relative link cost change (percent) that invalidates the TC cache */
   uint8_t willingness;                 /* Manual Configured Willingness value */
 
   uint16_t olsr_port;                  /* port number used for OLSR packages */
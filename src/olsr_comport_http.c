@@ -52,6 +52,7 @@
 #include "olsr_comport.h"
 #include "olsr_comport_http.h"
 #include "olsr_comport_txt.h"
+#include "olsr_stats.h"
 #include "olsr_cfg.h"
 #include "ipcalc.h"
 
@@ -59,6 +60,7 @@
 
 static const char HTTP_VERSION[] = "HTTP/1.0";
 static const char TELNET_PATH[] = "/telnet/";
+static const char METRICS_PATH[] = "/metrics/";
 
 static struct olsr_memcookie_info *htmlsite_cookie;
 struct avl_tree http_handler_tree;
@@ -143,6 +145,15 @@ olsr_com_html2telnet_gate(struct comport_connection *con, struct http_request *r
   }
 }
 
+static void
+olsr_com_html_metrics(struct comport_connection *con,
+    struct http_request *request __attribute__ ((unused))) {
+  con->http_contenttype = "text/plain; version=0.0.4";
+  if (olsr_stats_print(&con->out) < 0) {
+    con->send_as = HTTP_503_SERVICE_UNAVAILABLE;
+  }
+}
+
 void
 olsr_com_init_http(void) {
   avl_init(&http_handler_tree, &avl_comp_strcasecmp, false, NULL);
@@ -151,6 +162,9 @@ olsr_com_init_http(void) {
 
   /* activate telnet gateway */
   olsr_com_add_htmlhandler(olsr_com_html2telnet_gate, TELNET_PATH);
+
+  /* Prometheus scrape target */
+  olsr_com_add_htmlhandler(olsr_com_html_metrics, METRICS_PATH);
 #ifdef HTTP_TESTSITE
   init_test();
 #endif
@@ -52,6 +52,7 @@
 #include "ipcalc.h"
 #include "olsr_timer.h"
 #include "olsr_socket.h"
+#include "olsr_stats.h"
 #include "olsr_comport.h"
 #include "olsr_comport_txt.h"
 #include "plugin_loader.h"
@@ -86,6 +87,8 @@ static enum olsr_txtcommand_result olsr_txtcmd_version(
     struct comport_connection *con, const char *cmd, const char *param);
 static enum olsr_txtcommand_result olsr_txtcmd_plugin(
     struct comport_connection *con, const char *cmd, const char *param);
+static enum olsr_txtcommand_result olsr_txtcmd_metrics(
+    struct comport_connection *con, const char *cmd, const char *param);
 static enum olsr_txtcommand_result olsr_txtcmd_displayhelp(
     struct comport_connection *con, const char *cmd, const char *param);
 
@@ -98,7 +101,8 @@ static const char *txt_internal_names[] = {
   "repeat",
   "timeout",
   "version",
-  "plugin"
+  "plugin",
+  "metrics"
 };
 
 static const char *txt_internal_help[] = {
@@ -110,7 +114,8 @@ static const char *txt_internal_help[] = {
   "timeout <interval>: set the timeout interval to <interval> seconds, 0 means no timeout\n",
   "displays the version of the olsrd\n",
   "control olsr plugins dynamically, parameters are 'list', 'activate <plugin>', 'deactivate <plugin>', "
-    "'load <plugin>' and 'unload <plugin>'\n"
+    "'load <plugin>' and 'unload <plugin>'\n",
+  "displays the statistics of olsrd in Prometheus text format\n"
 };
 
 static olsr_txthandler txt_internal_handlers[] = {
@@ -121,7 +126,8 @@ static olsr_txthandler txt_internal_handlers[] = {
   olsr_txtcmd_repeat,
   olsr_txtcmd_timeout,
   olsr_txtcmd_version,
-  olsr_txtcmd_plugin
+  olsr_txtcmd_plugin,
+  olsr_txtcmd_metrics
 };
 
 static struct olsr_txtcommand *txt_internal_normalcmd[ARRAYSIZE(txt_internal_names)];
@@ -481,6 +487,15 @@ olsr_txtcmd_version(struct comport_connection *con,
   return CONTINUE;
 }
 
+static enum olsr_txtcommand_result
+olsr_txtcmd_metrics(struct comport_connection *con,
+    const char *cmd __attribute__ ((unused)), const char *param __attribute__ ((unused))) {
+  if (olsr_stats_print(&con->out) < 0) {
+    return ABUF_ERROR;
+  }
+  return CONTINUE;
+}
+
 static enum olsr_txtcommand_result
 olsr_txtcmd_plugin(struct comport_connection *con, const char *cmd, const char *param) {
   struct olsr_plugin *plugin, *iterator;
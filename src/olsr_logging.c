@@ -46,9 +46,16 @@
 #include <string.h>
 #include <time.h>
 
+#ifndef WIN32
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
 #include "common/list.h"
 #include "olsr.h"
 #include "olsr_cfg.h"
+#include "olsr_stats.h"
 #include "os_system.h"
 #include "os_time.h"
 #include "olsr_logging.h"
@@ -76,6 +83,72 @@ static void olsr_log_syslog(enum log_severity severity, enum log_source source,
 static void olsr_log_file(enum log_severity severity, enum log_source source,
                           bool no_header, const char *file, int line, char *buffer,
                           int timeLength, int prefixLength);
+static void olsr_log_async(enum log_severity severity, enum log_source source,
+                           bool no_header, const char *file, int line, char *buffer,
+                           int timeLength, int prefixLength);
+
+#ifndef WIN32
+/*
+ * Asynchronous logging
+ *
+ * The main thread copies the formatted log events into a single producer,
+ * single consumer byte ring. A writer thread drains the ring in batches,
+ * so the main loop never waits for the disk, the console or syslog.
+ * If the ring is full the event is dropped and counted.
+ */
+
+/* size of the ring in bytes, must be a power of two */
+#define LOG_RING_SIZE 65536
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+
+/* records are aligned, so the space left at the end of the ring always fits a header */
+#define LOG_RING_ALIGN(size) (((size) + 7) & ~7u)
+
+/* maximum time in milliseconds an event waits in the ring */
+#define LOG_WRITER_INTERVAL 50
+
+/* output buffer of the writer thread */
+#define LOG_WRITER_BUFFER 16384
+
+struct log_record {
+  /* size of the record including header and padding */
+  uint16_t size;
+
+  /* length of the timestamp and the text without terminating zero */
+  uint16_t time_length;
+  uint16_t text_length;
+
+  uint8_t severity;
+
+  /* record only fills the end of the ring */
+  uint8_t padding;
+
+  /* zero terminated text follows here */
+};
+
+static uint8_t *log_ring = NULL;
+
+/* free running byte counters, head is written by the producer, tail by the writer */
+static uint32_t log_ring_head, log_ring_tail;
+
+/* number of dropped events, only written by the producer */
+static uint32_t log_ring_dropped;
+
+static pthread_t log_writer_thread;
+static bool log_writer_running = false;
+static bool log_writer_stop;
+
+/* the writer thread exists only in the process that created it */
+static pid_t log_writer_pid;
+
+static struct olsr_stats log_dropped_stats;
+
+static void olsr_log_write_batch(char *batch, size_t *len);
+#endif
+
+/* time of the last log event, localtime() is only called when the second changes */
+static time_t log_last_second = -1;
+static struct tm log_last_tm;
 
 /**
  * Called by main method just after configuration options have been parsed
@@ -107,6 +180,8 @@ olsr_log_cleanup(void)
 {
   struct log_handler_entry *h, *iterator;
 
+  olsr_log_stop_writer();
+
   /* remove all handlers */
   FOR_ALL_LOGHANDLERS(h, iterator) {
     olsr_log_removehandler(h);
@@ -126,12 +201,27 @@ void
 olsr_log_applyconfig(void) {
   if (olsr_cnf->log_target_file) {
     log_fileoutput = fopen(olsr_cnf->log_target_file, "a");
-    if (log_fileoutput) {
-      olsr_log_addhandler(&olsr_log_file, &olsr_cnf->log_event);
-    } else {
+    if (log_fileoutput == NULL) {
       OLSR_WARN(LOG_LOGGING, "Cannot open log output file %s.", olsr_cnf->log_target_file);
     }
   }
+
+#ifdef WIN32
+  if (olsr_cnf->log_async) {
+    OLSR_WARN(LOG_LOGGING, "Asynchronous logging is not supported on this platform.\n");
+    olsr_cnf->log_async = false;
+  }
+#endif
+
+  if (olsr_cnf->log_async) {
+    /* one handler for all targets, they are written by the writer thread */
+    olsr_log_addhandler(&olsr_log_async, &olsr_cnf->log_event);
+    return;
+  }
+
+  if (log_fileoutput) {
+    olsr_log_addhandler(&olsr_log_file, &olsr_cnf->log_event);
+  }
   if (olsr_cnf->log_target_syslog) {
     olsr_log_addhandler(&olsr_log_syslog, &olsr_cnf->log_event);
   }
@@ -140,6 +230,187 @@ olsr_log_applyconfig(void) {
   }
 }
 
+#ifndef WIN32
+/**
+ * @return number of log events dropped because the ring was full
+ */
+static uint64_t
+olsr_log_get_dropped(void)
+{
+  return log_ring_dropped;
+}
+
+/**
+ * Write all log events of the ring to the configured targets.
+ * Called by the writer thread.
+ */
+static void
+olsr_log_drain(void)
+{
+  static char batch[LOG_WRITER_BUFFER];
+  static uint32_t reported_drops = 0;
+  struct log_record *record;
+  uint32_t head, tail, drops;
+  size_t len = 0;
+  char *text;
+
+  head = __atomic_load_n(&log_ring_head, __ATOMIC_ACQUIRE);
+  tail = log_ring_tail;
+
+  while (tail != head) {
+    record = (struct log_record *)&log_ring[tail & LOG_RING_MASK];
+    text = (char *)(record + 1);
+
+    if (!record->padding) {
+      if (len + record->text_length + 1 > sizeof(batch)) {
+        olsr_log_write_batch(batch, &len);
+      }
+      memcpy(&batch[len], text, record->text_length);
+      len += record->text_length;
+      batch[len++] = '\n';
+
+      if (olsr_cnf->log_target_syslog) {
+        os_printline(record->severity, &text[record->time_length]);
+      }
+    }
+
+    tail += record->size;
+    __atomic_store_n(&log_ring_tail, tail, __ATOMIC_RELEASE);
+  }
+
+  drops = __atomic_load_n(&log_ring_dropped, __ATOMIC_RELAXED);
+  if (drops != reported_drops) {
+    if (len + 64 > sizeof(batch)) {
+      olsr_log_write_batch(batch, &len);
+    }
+    len += snprintf(&batch[len], sizeof(batch) - len, "%u log events dropped\n", drops - reported_drops);
+    reported_drops = drops;
+  }
+
+  olsr_log_write_batch(batch, &len);
+}
+
+/**
+ * Write a batch of log lines to the file and stderr targets
+ * @param batch pointer to buffer with log lines
+ * @param len pointer to length of buffer, will be reset to zero
+ */
+static void
+olsr_log_write_batch(char *batch, size_t *len)
+{
+  if (*len == 0) {
+    return;
+  }
+
+  if (log_fileoutput) {
+    fwrite(batch, 1, *len, log_fileoutput);
+    fflush(log_fileoutput);
+  }
+  if (olsr_cnf->log_target_stderr) {
+    fwrite(batch, 1, *len, stderr);
+    fflush(stderr);
+  }
+  *len = 0;
+}
+
+/**
+ * Main function of the writer thread
+ * @param ptr unused
+ * @return always NULL
+ */
+static void *
+olsr_log_writer(void *ptr __attribute__ ((unused)))
+{
+  struct timespec interval;
+  bool stop;
+
+  interval.tv_sec = 0;
+  interval.tv_nsec = LOG_WRITER_INTERVAL * 1000000L;
+
+  do {
+    /* read the flag first, so all events logged before the stop are written */
+    stop = __atomic_load_n(&log_writer_stop, __ATOMIC_ACQUIRE);
+    olsr_log_drain();
+
+    if (!stop) {
+      nanosleep(&interval, NULL);
+    }
+  } while (!stop);
+
+  return NULL;
+}
+#endif
+
+/**
+ * Start the writer thread for asynchronous logging. Must be called
+ * after olsrd has detached from the console, because the thread
+ * does not survive a fork. Until then the events are written directly.
+ */
+void
+olsr_log_start_writer(void)
+{
+#ifndef WIN32
+  sigset_t all, old;
+  int error;
+
+  if (!olsr_cnf->log_async || log_writer_running) {
+    return;
+  }
+
+  log_ring = olsr_malloc(LOG_RING_SIZE, "Log ring");
+  log_ring_head = 0;
+  log_ring_tail = 0;
+  log_ring_dropped = 0;
+  log_writer_stop = false;
+
+  /* signals are handled by the main thread */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  error = pthread_create(&log_writer_thread, NULL, &olsr_log_writer, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  if (error) {
+    OLSR_WARN(LOG_LOGGING, "Cannot start log writer thread, logging synchronously: %s\n", strerror(error));
+    free(log_ring);
+    log_ring = NULL;
+    return;
+  }
+
+  olsr_stats_add(&log_dropped_stats, "olsr_log_events_dropped_total",
+      "Log events dropped because the asynchronous log ring was full", OLSR_STATS_COUNTER);
+  log_dropped_stats.get_value = olsr_log_get_dropped;
+
+  log_writer_pid = getpid();
+  log_writer_running = true;
+#endif
+}
+
+/**
+ * Stop the writer thread of asynchronous logging after it has
+ * written all waiting events. Later events are written directly.
+ * Must be called before a fork(), the child has no writer thread.
+ */
+void
+olsr_log_stop_writer(void)
+{
+#ifndef WIN32
+  if (!log_writer_running) {
+    return;
+  }
+  log_writer_running = false;
+
+  if (getpid() == log_writer_pid) {
+    /* the writer drains the ring before it stops */
+    __atomic_store_n(&log_writer_stop, true, __ATOMIC_RELEASE);
+    pthread_join(log_writer_thread, NULL);
+  }
+
+  olsr_stats_remove(&log_dropped_stats);
+  free(log_ring);
+  log_ring = NULL;
+#endif
+}
+
 /**
  * Registers a custom logevent handler
  * @param handler pointer to handler function
@@ -250,7 +521,6 @@ olsr_log(enum log_severity severity, enum log_source source, bool no_header, con
   struct log_handler_entry *h, *iterator;
   va_list ap;
   int p1 = 0, p2 = 0, p3 = 0;
-  struct tm now, *tm_ptr;
   struct timeval timeval;
 
   /* test if event is consumed by any log handler */
@@ -262,14 +532,16 @@ olsr_log(enum log_severity severity, enum log_source source, bool no_header, con
   /* calculate local time */
   os_gettimeofday(&timeval, NULL);
 
-  /* there is no localtime_r in win32 */
-  tm_ptr = localtime((time_t *) & timeval.tv_sec);
-  now = *tm_ptr;
+  if (timeval.tv_sec != log_last_second) {
+    /* there is no localtime_r in win32 */
+    log_last_tm = *localtime((time_t *) & timeval.tv_sec);
+    log_last_second = timeval.tv_sec;
+  }
 
   /* generate log string (insert file/line in DEBUG mode) */
   if (!no_header) {
     p1 = snprintf(logbuffer, LOGBUFFER_SIZE, "%d:%02d:%02d.%03ld ",
-                  now.tm_hour, now.tm_min, now.tm_sec, (long)(timeval.tv_usec / 1000));
+                  log_last_tm.tm_hour, log_last_tm.tm_min, log_last_tm.tm_sec, (long)(timeval.tv_usec / 1000));
 
     p2 = snprintf(&logbuffer[p1], LOGBUFFER_SIZE - p1, "%s(%s) %s %d: ",
         LOG_SEVERITY_NAMES[severity], LOG_SOURCE_NAMES[source], file, line);
@@ -333,3 +605,66 @@ olsr_log_syslog(enum log_severity severity __attribute__ ((unused)),
 {
   os_printline(severity, &buffer[timeLength]);
 }
+
+static void
+olsr_log_async(enum log_severity severity, enum log_source source,
+               bool no_header, const char *file, int line,
+               char *buffer, int timeLength, int prefixLength)
+{
+#ifndef WIN32
+  struct log_record *record;
+  uint32_t head, used, contiguous, size;
+  size_t length;
+
+  if (!log_writer_running) {
+    /* no writer yet, write directly */
+    if (log_fileoutput) {
+      olsr_log_file(severity, source, no_header, file, line, buffer, timeLength, prefixLength);
+    }
+    if (olsr_cnf->log_target_syslog) {
+      olsr_log_syslog(severity, source, no_header, file, line, buffer, timeLength, prefixLength);
+    }
+    if (olsr_cnf->log_target_stderr) {
+      olsr_log_stderr(severity, source, no_header, file, line, buffer, timeLength, prefixLength);
+    }
+    return;
+  }
+
+  length = strlen(buffer);
+  size = LOG_RING_ALIGN(sizeof(*record) + length + 1);
+
+  head = log_ring_head;
+  used = head - __atomic_load_n(&log_ring_tail, __ATOMIC_ACQUIRE);
+
+  /* records are never split, the rest of the ring is filled with a padding record */
+  contiguous = LOG_RING_SIZE - (head & LOG_RING_MASK);
+  if (contiguous >= size) {
+    contiguous = 0;
+  }
+
+  if (used + contiguous + size > LOG_RING_SIZE) {
+    __atomic_store_n(&log_ring_dropped, log_ring_dropped + 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  if (contiguous) {
+    record = (struct log_record *)&log_ring[head & LOG_RING_MASK];
+    record->size = contiguous;
+    record->padding = true;
+    head += contiguous;
+  }
+
+  record = (struct log_record *)&log_ring[head & LOG_RING_MASK];
+  record->size = size;
+  record->time_length = timeLength;
+  record->text_length = length;
+  record->severity = severity;
+  record->padding = false;
+  memcpy(record + 1, buffer, length + 1);
+
+  /* publish the record to the writer thread */
+  __atomic_store_n(&log_ring_head, head + size, __ATOMIC_RELEASE);
+#else
+  olsr_log_stderr(severity, source, no_header, file, line, buffer, timeLength, prefixLength);
+#endif
+}
@@ -62,7 +62,7 @@ enum log_severity {
   LOG_SEVERITY_COUNT                   //!< LOG_SEVERITY_COUNT
 };
 
-extern const char *LOG_SEVERITY_NAMES[];
+extern const char *EXPORT(LOG_SEVERITY_NAMES)[];
 
 /**
  * these four macros should be used to generate OLSR logging output
@@ -129,6 +129,8 @@ void EXPORT(olsr_log_init) (void);
 void EXPORT(olsr_log_cleanup) (void);
 
 void EXPORT(olsr_log_applyconfig) (void);
+void olsr_log_start_writer(void);
+void olsr_log_stop_writer(void);
 
 struct log_handler_entry * EXPORT(olsr_log_addhandler) (void (*handler) (enum log_severity, enum log_source, bool,
                                                    const char *, int, char *, int, int),
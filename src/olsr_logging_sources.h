@@ -8,6 +8,8 @@
 #ifndef OLSR_LOGGING_SOURCES_H_
 #define OLSR_LOGGING_SOURCES_H_
 
+#include "common/common_types.h"
+
 /**
  * defines the source of a logging event
  */
@@ -46,6 +48,6 @@ enum log_source {
   LOG_SOURCE_COUNT
 };
 
-extern const char *LOG_SOURCE_NAMES[];
+extern const char *EXPORT(LOG_SOURCE_NAMES)[];
 
 #endif /* OLSR_LOGGING_SOURCES_H_ */
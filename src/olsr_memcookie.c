@@ -122,6 +122,169 @@ olsr_memcookie_cleanup(void)
   }
 }
 
+/**
+ * Get the slab of a memory block carved from a slab.
+ * @param mem pointer to memory prefix
+ * @return pointer to slab header
+ */
+static inline struct olsr_memcookie_slab *
+olsr_memcookie_get_slab(struct olsr_memory_prefix *mem)
+{
+  return (struct olsr_memcookie_slab *)((uintptr_t)mem & ~((uintptr_t)COOKIE_SLAB_SIZE - 1));
+}
+
+/**
+ * Get a memory block of a slab.
+ * @param slab pointer to slab header
+ * @param idx index of the block
+ * @return pointer to memory prefix of the block
+ */
+static inline struct olsr_memory_prefix *
+olsr_memcookie_get_slab_block(struct olsr_memcookie_slab *slab, uint32_t idx)
+{
+  return (struct olsr_memory_prefix *)((uint8_t *)slab
+      + calc_aligned_size(sizeof(struct olsr_memcookie_slab)) + idx * slab->block_size);
+}
+
+/**
+ * Allocate a new slab for a memcookie and put all its blocks
+ * on the free list.
+ * @param ci pointer to memcookie info
+ * @return true if a slab was added, false if the memory blocks
+ *   of the cookie are too large for a slab
+ */
+static bool
+olsr_memcookie_add_slab(struct olsr_memcookie_info *ci)
+{
+  struct olsr_memcookie_slab *slab;
+  struct olsr_memory_prefix *mem;
+  void *ptr;
+  uint32_t count, i;
+
+  count = (COOKIE_SLAB_SIZE - calc_aligned_size(sizeof(struct olsr_memcookie_slab))) / ci->ci_total_size;
+  if (count < COOKIE_SLAB_MIN_BLOCKS) {
+    return false;
+  }
+
+  /* slabs are aligned to their size to find them from a block in O(1) */
+#ifdef WIN32
+  ptr = _aligned_malloc(COOKIE_SLAB_SIZE, COOKIE_SLAB_SIZE);
+#else
+  if (posix_memalign(&ptr, COOKIE_SLAB_SIZE, COOKIE_SLAB_SIZE) != 0) {
+    ptr = NULL;
+  }
+#endif
+  if (ptr == NULL) {
+    OLSR_ERROR(LOG_COOKIE, "Out of memory for slab of '%s': %s\n", ci->ci_name, strerror(errno));
+    olsr_exit(EXIT_FAILURE);
+  }
+  memset(ptr, 0, COOKIE_SLAB_SIZE);
+
+  slab = ptr;
+  slab->block_size = ci->ci_total_size;
+  slab->block_count = count;
+
+  /* fill the free list in address order */
+  for (i = 0; i < count; i++) {
+    mem = olsr_memcookie_get_slab_block(slab, i);
+    mem->is_slab = true;
+    list_add_tail(&ci->ci_free_list, &mem->node);
+  }
+  ci->ci_free_list_usage += count;
+
+  list_add_tail(&ci->ci_slab_list, &slab->node);
+  ci->ci_slab_count++;
+
+  OLSR_DEBUG(LOG_COOKIE, "MEMORY: new slab for %s, %p, %u blocks\n", ci->ci_name, slab, count);
+  return true;
+}
+
+/**
+ * Release a slab without used memory blocks.
+ * @param ci pointer to memcookie info
+ * @param slab pointer to slab header
+ */
+static void
+olsr_memcookie_remove_slab(struct olsr_memcookie_info *ci, struct olsr_memcookie_slab *slab)
+{
+  struct olsr_memory_prefix *mem;
+  uint32_t i;
+
+  for (i = 0; i < slab->block_count; i++) {
+    mem = olsr_memcookie_get_slab_block(slab, i);
+    if (list_node_added(&mem->node)) {
+      list_remove(&mem->node);
+      ci->ci_free_list_usage--;
+    }
+  }
+
+  list_remove(&slab->node);
+  ci->ci_slab_count--;
+
+  OLSR_DEBUG(LOG_COOKIE, "MEMORY: free slab for %s, %p\n", ci->ci_name, slab);
+
+#ifdef WIN32
+  _aligned_free(slab);
+#else
+  free(slab);
+#endif
+}
+
+/**
+ * Remove all blocks from the free list of a memcookie
+ * because their size does not match the cookie anymore.
+ * Slabs are released as soon as all their blocks are free.
+ * @param ci pointer to memcookie info
+ */
+static void
+olsr_memcookie_flush_free_list(struct olsr_memcookie_info *ci)
+{
+  struct olsr_memory_prefix *mem, *mem_iterator;
+  struct olsr_memcookie_slab *slab, *slab_iterator;
+
+  OLSR_FOR_ALL_FREE_MEM(ci, mem, mem_iterator) {
+    list_remove(&mem->node);
+    if (!mem->is_slab) {
+      free(mem);
+    }
+  }
+  ci->ci_free_list_usage = 0;
+
+  OLSR_FOR_ALL_SLABS(ci, slab, slab_iterator) {
+    if (slab->used == 0) {
+      olsr_memcookie_remove_slab(ci, slab);
+    }
+  }
+}
+
+/**
+ * Call a function for all used memory blocks of a memcookie.
+ * @param ci pointer to memcookie info
+ * @param cb callback for each memory block
+ * @param data custom pointer for callback
+ */
+static void
+olsr_memcookie_walk_used(struct olsr_memcookie_info *ci,
+    void (*cb)(struct olsr_memcookie_info *, struct olsr_memory_prefix *, void *), void *data)
+{
+  struct olsr_memory_prefix *mem, *mem_iterator;
+  struct olsr_memcookie_slab *slab, *slab_iterator;
+  uint32_t i;
+
+  OLSR_FOR_ALL_USED_MEM(ci, mem, mem_iterator) {
+    cb(ci, mem, data);
+  }
+
+  OLSR_FOR_ALL_SLABS(ci, slab, slab_iterator) {
+    for (i = 0; i < slab->block_count && slab->used > 0; i++) {
+      mem = olsr_memcookie_get_slab_block(slab, i);
+      if (mem->is_used) {
+        cb(ci, mem, data);
+      }
+    }
+  }
+}
+
 /**
  * Allocate a new memcookie.
  * @param cookie_name id of the cookie
@@ -150,6 +313,7 @@ olsr_memcookie_add(const char *cookie_name, size_t size)
   list_init_head(&ci->ci_free_list);
   list_init_head(&ci->ci_used_list);
   list_init_head(&ci->ci_custom_list);
+  list_init_head(&ci->ci_slab_list);
 
   avl_insert(&olsr_cookie_tree, &ci->ci_node);
   return ci;
@@ -163,6 +327,8 @@ void
 olsr_memcookie_remove(struct olsr_memcookie_info *ci)
 {
   struct olsr_memory_prefix *memory_entity, *iterator;
+  struct olsr_memcookie_slab *slab, *slab_iterator;
+  uint32_t i;
 
   /* remove from tree */
   avl_delete(&olsr_cookie_tree, &ci->ci_node);
@@ -178,18 +344,58 @@ olsr_memcookie_remove(struct olsr_memcookie_info *ci)
 
   /* remove all free memory blocks */
   OLSR_FOR_ALL_FREE_MEM(ci, memory_entity, iterator) {
-    free(memory_entity);
+    if (!memory_entity->is_slab) {
+      free(memory_entity);
+    }
   }
 
   /* free all used memory blocks */
   OLSR_FOR_ALL_USED_MEM(ci, memory_entity, iterator) {
-    free(memory_entity->custom);
+    if (!memory_entity->is_inline) {
+      free(memory_entity->custom);
+    }
     free(memory_entity);
   }
 
+  /* free all slabs */
+  OLSR_FOR_ALL_SLABS(ci, slab, slab_iterator) {
+    for (i = 0; i < slab->block_count; i++) {
+      memory_entity = olsr_memcookie_get_slab_block(slab, i);
+      if (memory_entity->is_used && !memory_entity->is_inline) {
+        free(memory_entity->custom);
+      }
+    }
+#ifdef WIN32
+    _aligned_free(slab);
+#else
+    free(slab);
+#endif
+  }
+
   free(ci);
 }
 
+/**
+ * Switch a memcookie to slab mode. Memory blocks are carved from
+ * page sized slabs and recycled through a free stack, a slab is
+ * released when all its blocks are free again.
+ * Must be called before the first block of the cookie is allocated.
+ * @param ci pointer to memcookie info
+ * @param lazy_zero true if reused blocks should not be cleared, the
+ *   user of the cookie has to initialize all fields it relies on.
+ *   Blocks of a fresh slab are always cleared.
+ */
+void
+olsr_memcookie_set_slab(struct olsr_memcookie_info *ci, bool lazy_zero)
+{
+  assert (ci->ci_usage == 0);
+
+  olsr_memcookie_flush_free_list(ci);
+
+  ci->ci_slab = true;
+  ci->ci_lazy_zero = lazy_zero;
+}
+
 /**
  * Allocate a fixed amount of memory based on a passed in cookie type.
  * @param ci pointer to memcookie info
@@ -205,6 +411,11 @@ olsr_memcookie_malloc(struct olsr_memcookie_info *ci)
   bool reuse = false;
 #endif
 
+  if (ci->ci_slab && list_is_empty(&ci->ci_free_list)) {
+    /* fails if the blocks have grown too large for slabs */
+    olsr_memcookie_add_slab(ci);
+  }
+
   /*
    * Check first if we have reusable memory.
    */
@@ -222,7 +433,16 @@ olsr_memcookie_malloc(struct olsr_memcookie_info *ci)
     mem = list_first_element(&ci->ci_free_list, mem, node);
     list_remove(&mem->node);
 
-    memset(mem, 0, ci->ci_total_size);
+    if (mem->is_slab) {
+      olsr_memcookie_get_slab(mem)->used++;
+
+      if (!ci->ci_lazy_zero) {
+        memset(mem + 1, 0, ci->ci_total_size - sizeof(*mem));
+      }
+    }
+    else {
+      memset(mem, 0, ci->ci_total_size);
+    }
 
     ci->ci_free_list_usage--;
 #if !defined REMOVE_LOG_DEBUG
@@ -230,8 +450,14 @@ olsr_memcookie_malloc(struct olsr_memcookie_info *ci)
 #endif
   }
 
-  /* add to used list */
-  list_add_tail(&ci->ci_used_list, &mem->node);
+  mem->is_inline = true;
+  mem->is_used = true;
+  mem->custom = NULL;
+
+  /* add to used list, slab blocks are found through their slab */
+  if (!mem->is_slab) {
+    list_add_tail(&ci->ci_used_list, &mem->node);
+  }
 
   /* handle custom initialization */
   if (!list_is_empty(&ci->ci_custom_list)) {
@@ -262,6 +488,7 @@ void
 olsr_memcookie_free(struct olsr_memcookie_info *ci, void *ptr)
 {
   struct olsr_memory_prefix *mem;
+  struct olsr_memcookie_slab *slab;
 #if !defined REMOVE_LOG_DEBUG
   bool reuse = false;
 #endif
@@ -270,30 +497,59 @@ olsr_memcookie_free(struct olsr_memcookie_info *ci, void *ptr)
   mem = ptr;
   mem--;
 
-  /* remove from used_memory list */
-  list_remove(&mem->node);
+  mem->is_used = false;
 
-  /*
-   * Rather than freeing the memory right away, try to reuse at a later
-   * point. Keep at least ten percent of the active used blocks or at least
-   * ten blocks on the free list.
-   */
-  if (mem->is_inline && ((ci->ci_free_list_usage < ci->ci_min_free_count)
-      || (ci->ci_free_list_usage < ci->ci_usage / COOKIE_FREE_LIST_THRESHOLD))) {
+  if (mem->is_slab) {
+    /* custom data which has been moved out of the block */
+    if (!mem->is_inline) {
+      free(mem->custom);
+    }
 
-    list_add_tail(&ci->ci_free_list, &mem->node);
+    slab = olsr_memcookie_get_slab(mem);
+    slab->used--;
+
+    /* blocks with an outdated size are not recycled */
+    if (slab->block_size == ci->ci_total_size) {
+      list_add_head(&ci->ci_free_list, &mem->node);
 
-    ci->ci_free_list_usage++;
+      ci->ci_free_list_usage++;
 #if !defined REMOVE_LOG_DEBUG
-    reuse = true;
+      reuse = true;
 #endif
-  } else {
+    }
 
-    /* No interest in reusing memory. */
-    if (!mem->is_inline) {
-      free (mem->custom);
+    /* release empty slabs, but keep the minimum number of free blocks */
+    if (slab->used == 0 && (slab->block_size != ci->ci_total_size
+        || ci->ci_free_list_usage >= slab->block_count + ci->ci_min_free_count)) {
+      olsr_memcookie_remove_slab(ci, slab);
+    }
+  }
+  else {
+    /* remove from used_memory list */
+    list_remove(&mem->node);
+
+    /*
+     * Rather than freeing the memory right away, try to reuse at a later
+     * point. Keep at least ten percent of the active used blocks or at least
+     * ten blocks on the free list. Slab cookies only recycle slab blocks.
+     */
+    if (mem->is_inline && !ci->ci_slab && ((ci->ci_free_list_usage < ci->ci_min_free_count)
+        || (ci->ci_free_list_usage < ci->ci_usage / COOKIE_FREE_LIST_THRESHOLD))) {
+
+      list_add_tail(&ci->ci_free_list, &mem->node);
+
+      ci->ci_free_list_usage++;
+#if !defined REMOVE_LOG_DEBUG
+      reuse = true;
+#endif
+    } else {
+
+      /* No interest in reusing memory. */
+      if (!mem->is_inline) {
+        free (mem->custom);
+      }
+      free(mem);
     }
-    free(mem);
   }
 
   /* Stats keeping */
@@ -303,6 +559,48 @@ olsr_memcookie_free(struct olsr_memcookie_info *ci, void *ptr)
              ci->ci_name, ptr, (unsigned long)ci->ci_total_size, reuse ? ", reuse" : "");
 }
 
+/**
+ * Move the custom data of a used memory block into a larger
+ * external block and initialize the new custom extension.
+ * @param ci pointer to memcookie info
+ * @param mem pointer to memory prefix
+ * @param data pointer to new custom extension
+ */
+static void
+olsr_memcookie_add_custom_block(struct olsr_memcookie_info *ci, struct olsr_memory_prefix *mem, void *data)
+{
+  struct olsr_memcookie_custom *custom_cookie = data;
+  struct olsr_memcookie_custom *custom, *custom_iterator;
+  size_t old_total_size;
+  uint8_t *new_custom;
+
+  old_total_size = custom_cookie->offset;
+  new_custom = olsr_malloc(old_total_size + custom_cookie->size, ci->ci_name);
+
+  /* copy old data */
+  if (old_total_size > 0) {
+    memmove(new_custom, mem->custom, old_total_size);
+  }
+  if (!mem->is_inline) {
+    free(mem->custom);
+  }
+
+  mem->is_inline = false;
+  mem->custom = new_custom;
+
+  /* call up necessary initialization */
+  if (custom_cookie->init) {
+    custom_cookie->init(ci, mem + 1, new_custom + old_total_size);
+  }
+
+  /* inform the custom cookie managers that their memory has moved */
+  OLSR_FOR_ALL_CUSTOM_MEM(ci, custom, custom_iterator) {
+    if (custom->move) {
+      custom->move(ci, mem+1, new_custom + custom->offset);
+    }
+  }
+}
+
 /**
  * Add a custom memory section to an existing memcookie.
  *
@@ -330,9 +628,6 @@ olsr_memcookie_add_custom(const char *memcookie_name, const char *name, size_t s
     void (*move)(struct olsr_memcookie_info *, void *, void *)) {
   struct olsr_memcookie_info *ci;
   struct olsr_memcookie_custom *custom_cookie;
-  struct olsr_memcookie_custom *custom = NULL, *custom_iterator;
-  struct olsr_memory_prefix *mem, *mem_iterator;
-  size_t old_total_size, new_total_size;
 
   ci = avl_find_element(&olsr_cookie_tree, memcookie_name, ci, ci_node);
   if (ci == NULL) {
@@ -348,49 +643,55 @@ olsr_memcookie_add_custom(const char *memcookie_name, const char *name, size_t s
   custom_cookie->move = move;
 
   /* recalculate custom data block size */
-  old_total_size = ci->ci_total_size - ci->ci_custom_offset;
-  new_total_size = old_total_size + custom_cookie->size;
-
-  custom_cookie->offset = old_total_size;
+  custom_cookie->offset = ci->ci_total_size - ci->ci_custom_offset;
   ci->ci_total_size += custom_cookie->size;
 
   /* reallocate custom data blocks on used memory blocks*/
-  OLSR_FOR_ALL_USED_MEM(ci, mem, mem_iterator) {
-    uint8_t *new_custom;
+  olsr_memcookie_walk_used(ci, olsr_memcookie_add_custom_block, custom_cookie);
 
-    new_custom = olsr_malloc(new_total_size, ci->ci_name);
+  /* remove all free data blocks, they have the wrong size */
+  olsr_memcookie_flush_free_list(ci);
 
-    /* copy old data */
-    if (old_total_size > 0) {
-      memmove(new_custom, mem->custom, old_total_size);
-    }
+  /* add the custom data object to the list */
+  list_add_tail(&ci->ci_custom_list, &custom_cookie->node);
+  return custom_cookie;
+}
 
-    mem->is_inline = false;
-    mem->custom = new_custom;
+/* parameters for removing a custom extension from the used memory blocks */
+struct olsr_memcookie_custom_removal {
+  struct olsr_memcookie_custom *custom;
+  size_t prefix_block;
+  size_t suffix_block;
+};
 
-    /* call up necessary initialization */
-    if (custom->init) {
-      custom->init(ci, mem + 1, new_custom + old_total_size);
-    }
+/**
+ * Remove the data of a custom extension from a used memory block
+ * and inform all moved custom extensions.
+ * @param ci pointer to memcookie info
+ * @param mem pointer to memory prefix
+ * @param data pointer to olsr_memcookie_custom_removal
+ */
+static void
+olsr_memcookie_remove_custom_block(struct olsr_memcookie_info *ci, struct olsr_memory_prefix *mem, void *data)
+{
+  struct olsr_memcookie_custom_removal *removal = data;
+  struct olsr_memcookie_custom *c_ptr, *c_iterator;
+  bool match = false;
 
-    /* inform the custom cookie managers that their memory has moved */
-    OLSR_FOR_ALL_CUSTOM_MEM(ci, custom, custom_iterator) {
-      if (custom->move) {
-        custom->move(ci, mem+1, new_custom + custom->offset);
-      }
+  memmove(mem->custom + removal->prefix_block,
+      mem->custom + removal->prefix_block + removal->custom->size, removal->suffix_block);
+
+  /* inform callbacks of moved blocks */
+  OLSR_FOR_ALL_CUSTOM_MEM(ci, c_ptr, c_iterator) {
+    if (c_ptr == removal->custom) {
+      match = true;
+      continue;
     }
-  }
 
-  /* remove all free data blocks, they have the wrong size */
-  OLSR_FOR_ALL_FREE_MEM(ci, mem, mem_iterator) {
-    list_remove(&mem->node);
-    free(mem);
+    if (match && c_ptr->move) {
+      c_ptr->move(ci, mem+1, mem->custom + c_ptr->offset);
+    }
   }
-  ci->ci_free_list_usage = 0;
-
-  /* add the custom data object to the list */
-  list_add_tail(&ci->ci_custom_list, &custom_cookie->node);
-  return custom_cookie;
 }
 
 /**
@@ -401,9 +702,8 @@ olsr_memcookie_add_custom(const char *memcookie_name, const char *name, size_t s
 void
 olsr_memcookie_remove_custom(const char*memcookie_name, struct olsr_memcookie_custom *custom) {
   struct olsr_memcookie_info *ci;
-  struct olsr_memory_prefix *mem, *mem_iterator;
   struct olsr_memcookie_custom *c_ptr, *c_iterator;
-  size_t prefix_block, suffix_block;
+  struct olsr_memcookie_custom_removal removal;
   bool match;
 
   ci = avl_find_element(&olsr_cookie_tree, memcookie_name, ci, ci_node);
@@ -413,11 +713,12 @@ olsr_memcookie_remove_custom(const char*memcookie_name, struct olsr_memcookie_cu
     return;
   }
 
-  prefix_block = 0;
-  suffix_block = 0;
+  removal.custom = custom;
+  removal.prefix_block = 0;
+  removal.suffix_block = 0;
   match = false;
 
-  /* calculate size of (not) modified custom data block */
+  /* calculate size of (not) modified custom data block and recalculate offsets */
   OLSR_FOR_ALL_CUSTOM_MEM(ci, c_ptr, c_iterator) {
     if (c_ptr == custom) {
       match = true;
@@ -425,44 +726,22 @@ olsr_memcookie_remove_custom(const char*memcookie_name, struct olsr_memcookie_cu
     }
 
     if (match) {
-      suffix_block += c_ptr->size;
+      removal.suffix_block += c_ptr->size;
+      c_ptr->offset -= custom->size;
     }
     else {
-      prefix_block += c_ptr->size;
+      removal.prefix_block += c_ptr->size;
     }
   }
 
   /* move the custom memory back into a continous block */
-  if (suffix_block > 0) {
-    OLSR_FOR_ALL_USED_MEM(ci, mem, mem_iterator) {
-      memmove(mem->custom + prefix_block, mem->custom + prefix_block + custom->size, suffix_block);
-
-      /* recalculate offsets of moved blocks and inform callbacks */
-      OLSR_FOR_ALL_CUSTOM_MEM(ci, c_ptr, c_iterator) {
-        if (c_ptr == custom) {
-          match = true;
-          continue;
-        }
-
-        if (match) {
-          c_ptr->offset -= custom->size;
-
-          if (c_ptr->move) {
-            c_ptr->move(ci, mem+1, mem->custom + c_ptr->offset);
-          }
-        }
-      }
-
-    }
+  if (removal.suffix_block > 0) {
+    olsr_memcookie_walk_used(ci, olsr_memcookie_remove_custom_block, &removal);
   }
   ci->ci_total_size -= custom->size;
 
   /* remove all free data blocks, they have the wrong size */
-  OLSR_FOR_ALL_FREE_MEM(ci, mem, mem_iterator) {
-    list_remove(&mem->node);
-    free(mem);
-  }
-  ci->ci_free_list_usage = 0;
+  olsr_memcookie_flush_free_list(ci);
 
   /* remove the custom data object from the list */
   list_remove(&custom->node);
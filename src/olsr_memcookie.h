@@ -90,6 +90,35 @@ struct olsr_memcookie_info {
 
   /* Length of free list */
   uint32_t ci_free_list_usage;
+
+  /* true if memory blocks are carved from slabs */
+  bool ci_slab;
+
+  /* true if reused slab blocks are not cleared before handing them out */
+  bool ci_lazy_zero;
+
+  /* List head for slabs */
+  struct list_entity ci_slab_list;
+
+  /* Stats, number of slabs */
+  uint32_t ci_slab_count;
+};
+
+/*
+ * Header of a page sized slab. The memory blocks of the slab
+ * follow directly after the (aligned) header.
+ */
+struct olsr_memcookie_slab {
+  struct list_entity node;
+
+  /* size of each memory block including prefix and custom data */
+  size_t block_size;
+
+  /* number of memory blocks in the slab */
+  uint32_t block_count;
+
+  /* number of memory blocks in use */
+  uint32_t used;
 };
 
 /* Custom addition to existing cookie */
@@ -130,16 +159,22 @@ struct olsr_memory_prefix {
   struct list_entity node;
   uint8_t *custom;
   uint8_t is_inline;
-  uint8_t padding[sizeof(size_t) - sizeof(uint8_t)];
+  uint8_t is_slab;
+  uint8_t is_used;
+  uint8_t padding[sizeof(size_t) - 3 * sizeof(uint8_t)];
 };
 
 #define OLSR_FOR_ALL_COOKIES(ci, iterator) avl_for_each_element_safe(&olsr_cookie_tree, ci, ci_node, iterator)
 #define OLSR_FOR_ALL_USED_MEM(ci, mem, iterator) list_for_each_element_safe(&ci->ci_used_list, mem, node, iterator)
 #define OLSR_FOR_ALL_FREE_MEM(ci, mem, iterator) list_for_each_element_safe(&ci->ci_free_list, mem, node, iterator)
 #define OLSR_FOR_ALL_CUSTOM_MEM(ci, custom, iterator) list_for_each_element_safe(&ci->ci_custom_list, custom, node, iterator)
+#define OLSR_FOR_ALL_SLABS(ci, slab, iterator) list_for_each_element_safe(&ci->ci_slab_list, slab, node, iterator)
 
 #define COOKIE_FREE_LIST_THRESHOLD 10   /* Blocks / Percent  */
 
+#define COOKIE_SLAB_SIZE 4096           /* Bytes, must be a power of two */
+#define COOKIE_SLAB_MIN_BLOCKS 4        /* smaller slabs are not worth it */
+
 /* Externals. */
 void olsr_memcookie_init(void);
 void olsr_memcookie_cleanup(void);
@@ -147,6 +182,8 @@ void olsr_memcookie_cleanup(void);
 struct olsr_memcookie_info *EXPORT(olsr_memcookie_add) (const char *, size_t size);
 void EXPORT(olsr_memcookie_remove)(struct olsr_memcookie_info *);
 
+void EXPORT(olsr_memcookie_set_slab) (struct olsr_memcookie_info *, bool lazy_zero);
+
 void *EXPORT(olsr_memcookie_malloc) (struct olsr_memcookie_info *);
 void EXPORT(olsr_memcookie_free) (struct olsr_memcookie_info *, void *);
 
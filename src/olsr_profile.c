@@ -0,0 +1,202 @@
+
+/*
+ * The olsr.org Optimized Link-State Routing daemon(olsrd)
+ * Copyright (c) 2004-2009, the olsr.org team - see HISTORY file
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of olsr.org, olsrd nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Visit http://www.olsr.org for more information.
+ *
+ * If you find this software useful feel free to make a donation
+ * to the project. For more information see the website or contact
+ * the copyright holders.
+ *
+ */
+
+#include <string.h>
+
+#include "common/string.h"
+#include "olsr_profile.h"
+
+/* list of all registered profiles */
+struct list_entity profile_list;
+
+/**
+ * Initialize the profile list
+ */
+void
+olsr_profile_init(void)
+{
+  list_init_head(&profile_list);
+}
+
+/**
+ * Register a profile. The profile is cleared before it is added.
+ * @param profile pointer to profile
+ * @param name name of the profiled code path
+ */
+void
+olsr_profile_add(struct olsr_profile *profile, const char *name)
+{
+  memset(profile, 0, sizeof(*profile));
+  strscpy(profile->name, name, sizeof(profile->name));
+
+  list_add_tail(&profile_list, &profile->node);
+}
+
+/**
+ * Unregister a profile
+ * @param profile pointer to profile
+ */
+void
+olsr_profile_remove(struct olsr_profile *profile)
+{
+  if (list_node_added(&profile->node)) {
+    list_remove(&profile->node);
+  }
+}
+
+/**
+ * @param duration duration in nanoseconds
+ * @return histogram bucket of the duration
+ */
+static unsigned int
+olsr_profile_get_bucket(uint64_t duration)
+{
+  unsigned int msb, idx;
+
+  if (duration < OLSR_PROFILE_SUBBUCKETS) {
+    return duration;
+  }
+
+  msb = 63 - __builtin_clzll(duration);
+  idx = OLSR_PROFILE_SUBBUCKETS * (msb - OLSR_PROFILE_SUBBUCKET_BITS + 1)
+      + ((duration >> (msb - OLSR_PROFILE_SUBBUCKET_BITS)) & (OLSR_PROFILE_SUBBUCKETS - 1));
+
+  return idx < OLSR_PROFILE_BUCKETS ? idx : OLSR_PROFILE_BUCKETS - 1;
+}
+
+/**
+ * @param idx histogram bucket
+ * @return largest duration of the histogram bucket
+ */
+uint64_t
+olsr_profile_get_bucket_limit(unsigned int idx)
+{
+  unsigned int shift;
+
+  if (idx < OLSR_PROFILE_SUBBUCKETS) {
+    return idx;
+  }
+
+  shift = idx / OLSR_PROFILE_SUBBUCKETS - 1;
+  return ((uint64_t)(OLSR_PROFILE_SUBBUCKETS + idx % OLSR_PROFILE_SUBBUCKETS + 1) << shift) - 1;
+}
+
+/**
+ * Add a measurement to a profile
+ * @param profile pointer to profile
+ * @param duration measured duration in nanoseconds
+ */
+void
+olsr_profile_record(struct olsr_profile *profile, uint64_t duration)
+{
+  profile->count++;
+  profile->total += duration;
+  if (duration > profile->max) {
+    profile->max = duration;
+  }
+  profile->buckets[olsr_profile_get_bucket(duration)]++;
+}
+
+/**
+ * Clear all measurements of a profile
+ * @param profile pointer to profile
+ */
+void
+olsr_profile_reset(struct olsr_profile *profile)
+{
+  profile->count = 0;
+  profile->total = 0;
+  profile->max = 0;
+  memset(profile->buckets, 0, sizeof(profile->buckets));
+}
+
+/**
+ * Clear all measurements of all registered profiles
+ */
+void
+olsr_profile_reset_all(void)
+{
+  struct olsr_profile *profile, *iterator;
+
+  OLSR_FOR_ALL_PROFILES(profile, iterator) {
+    olsr_profile_reset(profile);
+  }
+}
+
+/**
+ * Estimate a percentile of the measured durations from the histogram.
+ * @param profile pointer to profile
+ * @param percent percentile (1-100)
+ * @return upper limit of the duration (nanoseconds) of the percentile,
+ *   0 if there are no measurements
+ */
+uint64_t
+olsr_profile_get_percentile(const struct olsr_profile *profile, unsigned int percent)
+{
+  uint64_t rank, sum = 0, limit;
+  unsigned int idx;
+
+  if (profile->count == 0) {
+    return 0;
+  }
+
+  rank = ((uint64_t)profile->count * percent + 99) / 100;
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  for (idx = 0; idx < OLSR_PROFILE_BUCKETS; idx++) {
+    sum += profile->buckets[idx];
+    if (sum >= rank) {
+      break;
+    }
+  }
+
+  limit = olsr_profile_get_bucket_limit(idx);
+  return limit < profile->max ? limit : profile->max;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * End:
+ */
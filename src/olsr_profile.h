@@ -0,0 +1,124 @@
+
+/*
+ * The olsr.org Optimized Link-State Routing daemon(olsrd)
+ * Copyright (c) 2004-2009, the olsr.org team - see HISTORY file
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of olsr.org, olsrd nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Visit http://www.olsr.org for more information.
+ *
+ * If you find this software useful feel free to make a donation
+ * to the project. For more information see the website or contact
+ * the copyright holders.
+ *
+ */
+
+#ifndef _OLSR_PROFILE_H
+#define _OLSR_PROFILE_H
+
+#include "common/list.h"
+#include "common/common_types.h"
+#include "os_time.h"
+#include "defs.h"
+
+/*
+ * Runtime profiles of the hot code paths of olsrd.
+ *
+ * Every profile keeps a histogram of the measured durations in
+ * nanoseconds. Each power of two is split into four buckets, so the
+ * percentiles calculated from the histogram are exact up to 25%.
+ */
+#define OLSR_PROFILE_SUBBUCKET_BITS 2
+#define OLSR_PROFILE_SUBBUCKETS     (1 << OLSR_PROFILE_SUBBUCKET_BITS)
+
+/* durations above 2^40 ns (about 18 minutes) end up in the last bucket */
+#define OLSR_PROFILE_MAX_BITS       40
+#define OLSR_PROFILE_BUCKETS        (OLSR_PROFILE_SUBBUCKETS * (OLSR_PROFILE_MAX_BITS - OLSR_PROFILE_SUBBUCKET_BITS + 1))
+
+#define OLSR_PROFILE_NAME_LENGTH    32
+
+struct olsr_profile {
+  /* node of profile list */
+  struct list_entity node;
+
+  /* name of the profiled code path */
+  char name[OLSR_PROFILE_NAME_LENGTH];
+
+  /* number of measurements, sum and maximum of durations (nanoseconds) */
+  uint32_t count;
+  uint64_t total;
+  uint64_t max;
+
+  /* histogram of durations */
+  uint32_t buckets[OLSR_PROFILE_BUCKETS];
+};
+
+#define OLSR_FOR_ALL_PROFILES(profile, iterator) list_for_each_element_safe(&profile_list, profile, node, iterator)
+
+extern struct list_entity EXPORT(profile_list);
+
+void olsr_profile_init(void);
+
+void EXPORT(olsr_profile_add)(struct olsr_profile *, const char *);
+void EXPORT(olsr_profile_remove)(struct olsr_profile *);
+void EXPORT(olsr_profile_record)(struct olsr_profile *, uint64_t);
+void EXPORT(olsr_profile_reset)(struct olsr_profile *);
+void EXPORT(olsr_profile_reset_all)(void);
+uint64_t EXPORT(olsr_profile_get_percentile)(const struct olsr_profile *, unsigned int);
+uint64_t EXPORT(olsr_profile_get_bucket_limit)(unsigned int);
+
+/**
+ * Start a measurement
+ * @return timestamp for olsr_profile_stop()
+ */
+static INLINE uint64_t
+olsr_profile_start(void)
+{
+  return os_getnanotime();
+}
+
+/**
+ * Finish a measurement and add it to a profile
+ * @param profile pointer to profile
+ * @param start timestamp returned by olsr_profile_start()
+ */
+static INLINE void
+olsr_profile_stop(struct olsr_profile *profile, uint64_t start)
+{
+  olsr_profile_record(profile, os_getnanotime() - start);
+}
+
+#endif /* _OLSR_PROFILE_H */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * End:
+ */
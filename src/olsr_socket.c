@@ -45,6 +45,10 @@
 #include <string.h>
 #include <errno.h>
 
+#if defined linux
+#include <sys/epoll.h>
+#endif
+
 #include "common/avl.h"
 #include "common/avl_comp.h"
 #include "olsr_clock.h"
@@ -58,6 +62,19 @@ struct list_entity socket_head;
 
 static struct olsr_memcookie_info *socket_memcookie;
 
+#if defined linux
+/* maximum number of events fetched by a single epoll_wait() call */
+#define OLSR_SOCKET_EPOLL_EVENTS 64
+
+/* epoll instance, -1 if we fall back to select() */
+static int socket_epoll_fd = -1;
+
+static void olsr_socket_epoll_update(struct olsr_socket_entry *entry, unsigned int old_flags);
+static int olsr_socket_poll_epoll(int32_t remaining);
+#endif
+
+static int olsr_socket_poll_select(int32_t remaining);
+
 /* helper function to free socket entry */
 static inline void
 olsr_socket_intfree(struct olsr_socket_entry *sock) {
@@ -73,6 +90,15 @@ olsr_socket_init(void) {
   list_init_head(&socket_head);
 
   socket_memcookie = olsr_memcookie_add("socket entry", sizeof(struct olsr_socket_entry));
+
+#if defined linux
+  /* the size argument is only a hint for old kernels */
+  socket_epoll_fd = epoll_create(OLSR_SOCKET_EPOLL_EVENTS);
+  if (socket_epoll_fd == -1) {
+    OLSR_WARN(LOG_SCHEDULER, "Cannot create epoll instance, falling back to select(): %s (%d)\n",
+        strerror(errno), errno);
+  }
+#endif
 }
 
 /**
@@ -93,6 +119,13 @@ olsr_socket_cleanup(void)
     olsr_socket_intfree(entry);
   }
 
+#if defined linux
+  if (socket_epoll_fd != -1) {
+    close(socket_epoll_fd);
+    socket_epoll_fd = -1;
+  }
+#endif
+
   olsr_memcookie_remove(socket_memcookie);
 }
 
@@ -127,6 +160,9 @@ olsr_socket_add(int fd, socket_handler_func pf_imm, void *data, unsigned int fla
   /* Queue */
   list_add_before(&socket_head, &new_entry->node);
 
+#if defined linux
+  olsr_socket_epoll_update(new_entry, 0);
+#endif
   return new_entry;
 }
 
@@ -137,33 +173,110 @@ olsr_socket_add(int fd, socket_handler_func pf_imm, void *data, unsigned int fla
 void
 olsr_socket_remove(struct olsr_socket_entry *entry)
 {
+  unsigned int old_flags;
+
   OLSR_DEBUG(LOG_SCHEDULER, "Removing OLSR socket entry %d\n", entry->fd);
 
+  old_flags = entry->flags;
+
   entry->process = NULL;
   entry->flags = 0;
+
+#if defined linux
+  olsr_socket_epoll_update(entry, old_flags);
+#else
+  (void)old_flags;
+#endif
+}
+
+/**
+ * Enable one or both flags of a socket handler
+ * @param sock pointer to socket entry
+ * @param flags OLSR_SOCKET_READ/OLSR_SOCKET_WRITE (or both)
+ */
+void
+olsr_socket_enable(struct olsr_socket_entry *entry, unsigned int flags)
+{
+  unsigned int old_flags = entry->flags;
+
+  entry->flags |= flags;
+#if defined linux
+  olsr_socket_epoll_update(entry, old_flags);
+#else
+  (void)old_flags;
+#endif
+}
+
+/**
+ * Disable one or both flags of a socket handler
+ * @param sock pointer to socket entry
+ * @param flags OLSR_SOCKET_READ/OLSR_SOCKET_WRITE (or both)
+ */
+void
+olsr_socket_disable(struct olsr_socket_entry *entry, unsigned int flags)
+{
+  unsigned int old_flags = entry->flags;
+
+  entry->flags &= ~flags;
+#if defined linux
+  olsr_socket_epoll_update(entry, old_flags);
+#else
+  (void)old_flags;
+#endif
 }
 
 /**
- * Handle all incoming socket events until a certain time
- * @param next_interval
+ * Wait for socket events until a certain time and handle them.
+ * Returns after the first batch of events has been handled, so
+ * the caller can react on the results.
+ * @param until_time absolute time to wait for events
  */
 void
 olsr_socket_handle(uint32_t until_time)
 {
   struct olsr_socket_entry *entry, *iterator;
-  struct timeval tvp;
   int32_t remaining;
 
   /* Update time since this is much used by the parsing functions */
   olsr_clock_update();
 
   remaining = olsr_clock_getRelative(until_time);
-  if (remaining <= 0) {
-    /* we are already over the interval */
-    if (list_is_empty(&socket_head)) {
-      /* If there are no registered sockets we do not call select(2) */
-      return;
+  if (remaining <= 0 && list_is_empty(&socket_head)) {
+    /* If there are no registered sockets we do not call select(2) */
+    return;
+  }
+
+#if defined linux
+  if (socket_epoll_fd != -1) {
+    olsr_socket_poll_epoll(remaining);
+  } else
+#endif
+  {
+    olsr_socket_poll_select(remaining);
+  }
+
+  OLSR_FOR_ALL_SOCKETS(entry, iterator) {
+    if (entry->process == NULL) {
+      olsr_socket_intfree(entry);
     }
+  }
+}
+
+/**
+ * Wait for socket events with select(2) and call the handlers
+ * of all ready sockets.
+ * @param remaining maximum time to wait in milliseconds
+ * @return number of ready sockets, 0 for timeout, -1 for an error
+ */
+static int
+olsr_socket_poll_select(int32_t remaining)
+{
+  struct olsr_socket_entry *entry, *iterator;
+  struct timeval tvp;
+  fd_set ibits, obits;
+  int n, hfd = 0, fdsets = 0;
+
+  if (remaining <= 0) {
     tvp.tv_sec = 0;
     tvp.tv_usec = 0;
   } else {
@@ -172,87 +285,173 @@ olsr_socket_handle(uint32_t until_time)
     tvp.tv_usec = (remaining % MSEC_PER_SEC) * USEC_PER_MSEC;
   }
 
-  /* do at least one select */
-  for (;;) {
-    fd_set ibits, obits;
-    int n, hfd = 0, fdsets = 0;
-    FD_ZERO(&ibits);
-    FD_ZERO(&obits);
-
-    /* Adding file-descriptors to FD set */
-    OLSR_FOR_ALL_SOCKETS(entry, iterator) {
-      if (entry->process == NULL) {
-        continue;
-      }
-      if ((entry->flags & OLSR_SOCKET_READ) != 0) {
-        fdsets |= OLSR_SOCKET_READ;
-        FD_SET((unsigned int)entry->fd, &ibits);        /* And we cast here since we get a warning on Win32 */
-      }
-      if ((entry->flags & OLSR_SOCKET_WRITE) != 0) {
-        fdsets |= OLSR_SOCKET_WRITE;
-        FD_SET((unsigned int)entry->fd, &obits);        /* And we cast here since we get a warning on Win32 */
-      }
-      if ((entry->flags & (OLSR_SOCKET_READ | OLSR_SOCKET_WRITE)) != 0 && entry->fd >= hfd) {
-        hfd = entry->fd + 1;
-      }
-    }
+  FD_ZERO(&ibits);
+  FD_ZERO(&obits);
 
-    if (hfd == 0 && (long)remaining <= 0) {
-      /* we are over the interval and we have no fd's. Skip the select() etc. */
-      return;
+  /* Adding file-descriptors to FD set */
+  OLSR_FOR_ALL_SOCKETS(entry, iterator) {
+    if (entry->process == NULL) {
+      continue;
+    }
+    if ((entry->flags & OLSR_SOCKET_READ) != 0) {
+      fdsets |= OLSR_SOCKET_READ;
+      FD_SET((unsigned int)entry->fd, &ibits);        /* And we cast here since we get a warning on Win32 */
     }
+    if ((entry->flags & OLSR_SOCKET_WRITE) != 0) {
+      fdsets |= OLSR_SOCKET_WRITE;
+      FD_SET((unsigned int)entry->fd, &obits);        /* And we cast here since we get a warning on Win32 */
+    }
+    if ((entry->flags & (OLSR_SOCKET_READ | OLSR_SOCKET_WRITE)) != 0 && entry->fd >= hfd) {
+      hfd = entry->fd + 1;
+    }
+  }
 
-    do {
-      n = os_select(hfd,
-          fdsets & OLSR_SOCKET_READ ? &ibits : NULL,
-          fdsets & OLSR_SOCKET_WRITE ? &obits : NULL,
-          NULL, &tvp);
-    } while (n == -1 && errno == EINTR);
+  if (hfd == 0 && remaining <= 0) {
+    /* we are over the interval and we have no fd's. Skip the select() etc. */
+    return 0;
+  }
+
+  do {
+    n = os_select(hfd,
+        fdsets & OLSR_SOCKET_READ ? &ibits : NULL,
+        fdsets & OLSR_SOCKET_WRITE ? &obits : NULL,
+        NULL, &tvp);
+  } while (n == -1 && errno == EINTR);
+
+  if (n == -1) {              /* Did something go wrong? */
+    OLSR_WARN(LOG_SCHEDULER, "select error: %s (%d)", strerror(errno), errno);
+  }
+  if (n <= 0) {
+    return n;
+  }
 
-    if (n == 0) {               /* timeout! */
-      break;
+  /* Update time since this is much used by the parsing functions */
+  olsr_clock_update();
+  OLSR_FOR_ALL_SOCKETS(entry, iterator) {
+    unsigned int flags;
+    if (entry->process == NULL) {
+      continue;
     }
-    if (n == -1) {              /* Did something go wrong? */
-      OLSR_WARN(LOG_SCHEDULER, "select error: %s (%d)", strerror(errno), errno);
-      break;
+    flags = 0;
+    if (FD_ISSET(entry->fd, &ibits)) {
+      flags |= OLSR_SOCKET_READ;
     }
-
-    /* Update time since this is much used by the parsing functions */
-    olsr_clock_update();
-    OLSR_FOR_ALL_SOCKETS(entry, iterator) {
-      int flags;
-      if (entry->process == NULL) {
-        continue;
-      }
-      flags = 0;
-      if (FD_ISSET(entry->fd, &ibits)) {
-        flags |= OLSR_SOCKET_READ;
-      }
-      if (FD_ISSET(entry->fd, &obits)) {
-        flags |= OLSR_SOCKET_WRITE;
-      }
-      if (flags != 0) {
-        entry->process(entry->fd, entry->data, flags);
-      }
+    if (FD_ISSET(entry->fd, &obits)) {
+      flags |= OLSR_SOCKET_WRITE;
+    }
+    if (flags != 0) {
+      entry->process(entry->fd, entry->data, flags);
     }
+  }
+  return n;
+}
 
-    /* calculate the next timeout */
-    remaining = olsr_clock_getRelative(until_time);
-    if (remaining <= 0) {
-      /* we are already over the interval */
-      break;
+#if defined linux
+/**
+ * Synchronize the kernel epoll registration of a socket entry
+ * with its current flags.
+ * @param entry pointer to socket entry
+ * @param old_flags flags of the entry before the last change
+ */
+static void
+olsr_socket_epoll_update(struct olsr_socket_entry *entry, unsigned int old_flags)
+{
+  struct epoll_event event;
+  unsigned int new_flags;
+  int op;
+
+  if (socket_epoll_fd == -1) {
+    return;
+  }
+
+  old_flags &= (OLSR_SOCKET_READ | OLSR_SOCKET_WRITE);
+  new_flags = entry->flags & (OLSR_SOCKET_READ | OLSR_SOCKET_WRITE);
+  if (old_flags == new_flags) {
+    return;
+  }
+
+  /*
+   * sockets without flags are not registered at all, otherwise
+   * EPOLLHUP/EPOLLERR would wake us up for sockets nobody listens to
+   */
+  if (old_flags == 0) {
+    op = EPOLL_CTL_ADD;
+  } else if (new_flags == 0) {
+    op = EPOLL_CTL_DEL;
+  } else {
+    op = EPOLL_CTL_MOD;
+  }
+
+  memset(&event, 0, sizeof(event));
+  event.data.ptr = entry;
+  if ((new_flags & OLSR_SOCKET_READ) != 0) {
+    event.events |= EPOLLIN;
+  }
+  if ((new_flags & OLSR_SOCKET_WRITE) != 0) {
+    event.events |= EPOLLOUT;
+  }
+
+  if (epoll_ctl(socket_epoll_fd, op, entry->fd, &event) == -1) {
+    /* closing a socket before removing it already unregisters it */
+    if (op != EPOLL_CTL_DEL || (errno != EBADF && errno != ENOENT)) {
+      OLSR_WARN(LOG_SCHEDULER, "epoll_ctl error for socket %d: %s (%d)\n",
+          entry->fd, strerror(errno), errno);
     }
-    /* we need an absolute time - milliseconds */
-    tvp.tv_sec = remaining / MSEC_PER_SEC;
-    tvp.tv_usec = (remaining % MSEC_PER_SEC) * USEC_PER_MSEC;
   }
+}
 
-  OLSR_FOR_ALL_SOCKETS(entry, iterator) {
+/**
+ * Wait for socket events with epoll_wait(2) and call the handlers
+ * of all ready sockets.
+ * @param remaining maximum time to wait in milliseconds
+ * @return number of ready sockets, 0 for timeout, -1 for an error
+ */
+static int
+olsr_socket_poll_epoll(int32_t remaining)
+{
+  struct epoll_event events[OLSR_SOCKET_EPOLL_EVENTS];
+  struct olsr_socket_entry *entry;
+  unsigned int flags;
+  int i, n;
+
+  do {
+    n = epoll_wait(socket_epoll_fd, events, OLSR_SOCKET_EPOLL_EVENTS, remaining > 0 ? remaining : 0);
+  } while (n == -1 && errno == EINTR);
+
+  if (n == -1) {
+    OLSR_WARN(LOG_SCHEDULER, "epoll_wait error: %s (%d)", strerror(errno), errno);
+  }
+  if (n <= 0) {
+    return n;
+  }
+
+  /* Update time since this is much used by the parsing functions */
+  olsr_clock_update();
+  for (i = 0; i < n; i++) {
+    /* removed entries are only freed at the end of olsr_socket_handle() */
+    entry = events[i].data.ptr;
     if (entry->process == NULL) {
-      olsr_socket_intfree(entry);
+      continue;
+    }
+
+    /* select(2) reports errors as readable/writeable, so do we */
+    flags = 0;
+    if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0) {
+      flags |= OLSR_SOCKET_READ;
+    }
+    if ((events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0) {
+      flags |= OLSR_SOCKET_WRITE;
+    }
+
+    /* an earlier handler might have changed the flags of this socket */
+    flags &= entry->flags;
+    if (flags != 0) {
+      entry->process(entry->fd, entry->data, flags);
     }
   }
+  return n;
 }
+#endif
 
 /*
  * Local Variables:
@@ -83,25 +83,8 @@ struct olsr_socket_entry *EXPORT(olsr_socket_add) (int fd,
     socket_handler_func pf_imm, void *data, unsigned int flags);
 void EXPORT(olsr_socket_remove) (struct olsr_socket_entry *);
 
-/**
- * Enable one or both flags of a socket handler
- * @param sock pointer to socket entry
- */
-static inline void
-olsr_socket_enable(struct olsr_socket_entry *entry, unsigned int flags)
-{
-  entry->flags |= flags;
-}
-
-/**
- * Disable one or both flags of a socket handler
- * @param sock pointer to socket entry
- */
-static inline void
-olsr_socket_disable(struct olsr_socket_entry *entry, unsigned int flags)
-{
-  entry->flags &= ~flags;
-}
+void EXPORT(olsr_socket_enable) (struct olsr_socket_entry *, unsigned int flags);
+void EXPORT(olsr_socket_disable) (struct olsr_socket_entry *, unsigned int flags);
 
 void olsr_socket_handle(uint32_t until_time);
 
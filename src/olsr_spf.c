@@ -47,72 +47,54 @@
 #include "routing_table.h"
 #include "lq_plugin.h"
 #include "process_routes.h"
+#include "link_set.h"
+#include "olsr_cfg.h"
+#include "olsr_clock.h"
 #include "olsr_logging.h"
+#include "olsr_profile.h"
 
 struct olsr_timer_info *spf_backoff_timer_info = NULL;
 struct olsr_timer_entry *spf_backoff_timer = NULL;
 
-/*
- * avl_comp_etx
- *
- * compare two etx metrics.
- * return 0 if there is an exact match and
- * -1 / +1 depending on being smaller or bigger.
- * note that this results in the most optimal code
- * after compiler optimization.
- */
-static int
-avl_comp_etx(const void *etx1, const void *etx2, void *ptr __attribute__ ((unused)))
-{
-  if (*(const olsr_linkcost *)etx1 < *(const olsr_linkcost *)etx2) {
-    return -1;
-  }
+/* vertices changed since the last SPF run, used by the incremental SPF */
+static struct list_entity spf_dirty_list;
+static unsigned int spf_dirty_count;
 
-  if (*(const olsr_linkcost *)etx1 > *(const olsr_linkcost *)etx2) {
-    return +1;
-  }
+/* true if the SPF results in the lsdb can be updated incrementally */
+static bool spf_results_valid;
 
-  return 0;
-}
+/* time of the next incremental SPF self check */
+static uint32_t spf_check_time;
+
+/* SPF throttling, current hold time and time of the last SPF run */
+static uint32_t spf_hold_time;
+static uint32_t spf_last_run;
+static bool spf_has_run;
+
+/* time spent in the routing table calculation */
+static struct olsr_profile spf_profile;
 
 /*
- * olsr_spf_add_cand_tree
+ * olsr_spf_add_cand_heap
  *
- * Key an existing vertex to a candidate tree.
+ * Key an existing vertex to the candidate heap or
+ * lower its key if it is already on the heap.
  */
 static void
-olsr_spf_add_cand_tree(struct avl_tree *tree, struct tc_entry *tc)
+olsr_spf_add_cand_heap(struct pairing_heap *heap, struct tc_entry *tc)
 {
 #if !defined REMOVE_LOG_DEBUG
   struct ipaddr_str buf;
   char lqbuffer[LQTEXT_MAXLENGTH];
 #endif
-  tc->cand_tree_node.key = &tc->path_cost;
-
   OLSR_DEBUG(LOG_ROUTING, "SPF: insert candidate %s, cost %s\n",
              olsr_ip_to_string(&buf, &tc->addr), olsr_get_linkcost_text(tc->path_cost, false, lqbuffer, sizeof(lqbuffer)));
 
-  avl_insert(tree, &tc->cand_tree_node);
-}
-
-/*
- * olsr_spf_del_cand_tree
- *
- * Unkey an existing vertex from a candidate tree.
- */
-static void
-olsr_spf_del_cand_tree(struct avl_tree *tree, struct tc_entry *tc)
-{
-  if (tc->cand_tree_node.key) {
-#if !defined REMOVE_LOG_DEBUG
-    struct ipaddr_str buf;
-    char lqbuffer[LQTEXT_MAXLENGTH];
-#endif
-    OLSR_DEBUG(LOG_ROUTING, "SPF: delete candidate %s, cost %s\n",
-        olsr_ip_to_string(&buf, &tc->addr), olsr_get_linkcost_text(tc->path_cost, false, lqbuffer, sizeof(lqbuffer)));
-
-    avl_delete(tree, &tc->cand_tree_node);
-    tc->cand_tree_node.key = NULL;
+  if (pairing_heap_is_node_added(heap, &tc->cand_heap_node)) {
+    pairing_heap_decrease_key(heap, &tc->cand_heap_node, tc->path_cost);
+  }
+  else {
+    pairing_heap_insert(heap, &tc->cand_heap_node, tc->path_cost);
   }
 }
 
@@ -141,28 +123,77 @@ olsr_spf_add_path_list(struct list_entity *head, int *path_count, struct tc_entr
 /*
  * olsr_spf_extract_best
  *
- * return the node with the minimum pathcost.
+ * remove and return the node with the minimum pathcost.
  */
 static struct tc_entry *
-olsr_spf_extract_best(struct avl_tree *tree)
+olsr_spf_extract_best(struct pairing_heap *heap)
 {
-  struct tc_entry *tc = NULL;
-  if (tree->count) {
-    tc = avl_first_element(tree, tc, cand_tree_node);
+  struct tc_entry *tc;
+
+  tc = pairing_heap_extract_min_element(heap, tc, cand_heap_node);
+#if !defined REMOVE_LOG_DEBUG
+  if (tc) {
+    struct ipaddr_str buf;
+    char lqbuffer[LQTEXT_MAXLENGTH];
+
+    OLSR_DEBUG(LOG_ROUTING, "SPF: extract candidate %s, cost %s\n",
+        olsr_ip_to_string(&buf, &tc->addr), olsr_get_linkcost_text(tc->path_cost, false, lqbuffer, sizeof(lqbuffer)));
   }
+#endif
   return tc;
 }
 
 
+/*
+ * olsr_spf_edge_cost
+ *
+ * return the cost of an edge as used by the SPF calculation.
+ * virtual edges use the cost of their inverse edge.
+ */
+static olsr_linkcost
+olsr_spf_edge_cost(struct tc_edge_entry *tc_edge)
+{
+  if (tc_edge->edge_inv == NULL) {
+    return LINK_COST_BROKEN;
+  }
+  if (tc_edge->virtual) {
+    return tc_edge->edge_inv->cost;
+  }
+  return tc_edge->cost;
+}
+
+/*
+ * olsr_spf_next_hop
+ *
+ * return the link to the first hop neighbor for a vertex
+ * reached through a predecessor. Vertices reached directly
+ * from us use the best link of their symmetric neighbor.
+ */
+static struct link_entry *
+olsr_spf_next_hop(struct tc_entry *parent, struct tc_entry *tc)
+{
+  struct nbr_entry *nbr;
+
+  if (parent->next_hop) {
+    return parent->next_hop;
+  }
+
+  nbr = olsr_lookup_nbr_entry(&tc->addr, false);
+  if (nbr == NULL || !nbr->is_sym) {
+    return NULL;
+  }
+  return get_best_link_to_neighbor(nbr);
+}
+
 /*
  * olsr_spf_relax
  *
  * Explore all edges of a node and add the node
- * to the candidate tree if the if the aggregate
+ * to the candidate heap if the if the aggregate
  * path cost is better.
  */
 static void
-olsr_spf_relax(struct avl_tree *cand_tree, struct tc_entry *tc)
+olsr_spf_relax(struct pairing_heap *cand_heap, struct tc_entry *tc)
 {
   struct tc_edge_entry *tc_edge, *iterator;
   olsr_linkcost new_cost;
@@ -183,12 +214,7 @@ olsr_spf_relax(struct avl_tree *cand_tree, struct tc_entry *tc)
 
     assert (tc_edge->edge_inv);
 
-    if (tc_edge->virtual) {
-      new_cost = tc_edge->edge_inv->cost;
-    }
-    else {
-      new_cost = tc_edge->cost;
-    }
+    new_cost = olsr_spf_edge_cost(tc_edge);
 
     /* check for broken link */
     if (new_cost >= LINK_COST_BROKEN) {
@@ -209,30 +235,24 @@ olsr_spf_relax(struct avl_tree *cand_tree, struct tc_entry *tc)
 
     if (new_cost < new_tc->path_cost) {
 
-      /* if this node has been on the candidate tree delete it */
-      if (new_tc->path_cost < ROUTE_COST_BROKEN) {
-        olsr_spf_del_cand_tree(cand_tree, new_tc);
-      }
-
       /* remove from result list if necessary */
       if (list_node_added(&new_tc->path_list_node)) {
         list_remove(&new_tc->path_list_node);
       }
 
-      /* re-insert on candidate tree with the better metric */
+      /* insert into the candidate heap or lower the key to the better metric */
       new_tc->path_cost = new_cost;
-      olsr_spf_add_cand_tree(cand_tree, new_tc);
+      olsr_spf_add_cand_heap(cand_heap, new_tc);
 
       /* pull-up the next-hop and bump the hop count */
-      if (tc->next_hop) {
-        new_tc->next_hop = tc->next_hop;
-      }
+      new_tc->spf_parent = tc;
+      new_tc->next_hop = olsr_spf_next_hop(tc, new_tc);
       new_tc->hops = tc->hops + 1;
 
       OLSR_DEBUG(LOG_ROUTING, "SPF:   better path to %s, cost %s, via %s, hops %d\n",
                  olsr_ip_to_string(&buf, &new_tc->addr),
                  olsr_get_linkcost_text(new_cost, true, lqbuffer, sizeof(lqbuffer)),
-                 tc->next_hop ? olsr_ip_to_string(&nbuf, &tc->next_hop->neighbor_iface_addr) : "<none>", new_tc->hops);
+                 new_tc->next_hop ? olsr_ip_to_string(&nbuf, &new_tc->next_hop->neighbor_iface_addr) : "<none>", new_tc->hops);
     }
   }
 }
@@ -242,138 +262,565 @@ olsr_spf_relax(struct avl_tree *cand_tree, struct tc_entry *tc)
  *
  * Run the Dijkstra algorithm.
  *
- * A node gets added to the candidate tree when one of its edges has
+ * A node gets added to the candidate heap when one of its edges has
  * an overall better root path cost than the node itself.
- * The node with the shortest metric gets moved from the candidate to
+ * The node with the shortest metric gets moved from the candidate heap to
  * the path list every pass.
  * The SPF computation is completed when there are no more nodes
- * on the candidate tree.
+ * on the candidate heap.
  */
 static void
-olsr_spf_run_full(struct avl_tree *cand_tree, struct list_entity *path_list, int *path_count)
+olsr_spf_run_full(struct pairing_heap *cand_heap, struct list_entity *path_list, int *path_count)
 {
   struct tc_entry *tc;
 
   *path_count = 0;
 
-  while ((tc = olsr_spf_extract_best(cand_tree))) {
-    olsr_spf_relax(cand_tree, tc);
+  while ((tc = olsr_spf_extract_best(cand_heap))) {
+    olsr_spf_relax(cand_heap, tc);
 
     /*
-     * move the best path from the candidate tree
-     * to the path list.
+     * move the best path to the path list.
      */
-    olsr_spf_del_cand_tree(cand_tree, tc);
     olsr_spf_add_path_list(path_list, path_count, tc);
   }
 }
 
+/*
+ * olsr_spf_mark_dirty
+ *
+ * Remember a vertex whose edges have changed since the last SPF run.
+ */
+static void
+olsr_spf_mark_dirty(struct tc_entry *tc)
+{
+  if (!list_node_added(&tc->spf_dirty_node)) {
+    list_add_tail(&spf_dirty_list, &tc->spf_dirty_node);
+    spf_dirty_count++;
+  }
+}
+
+/*
+ * olsr_spf_flush_dirty
+ *
+ * Forget all collected changes, the SPF results are up to date.
+ */
+static void
+olsr_spf_flush_dirty(void)
+{
+  struct tc_entry *tc;
+
+  while (!list_is_empty(&spf_dirty_list)) {
+    tc = list_first_element(&spf_dirty_list, tc, spf_dirty_node);
+    list_remove(&tc->spf_dirty_node);
+  }
+  spf_dirty_count = 0;
+}
+
+/**
+ * Notify the SPF that the cost or the state of an edge has changed.
+ * @param tc_edge pointer to edge
+ */
+void
+olsr_spf_edge_changed(struct tc_edge_entry *tc_edge)
+{
+  olsr_spf_mark_dirty(tc_edge->tc);
+  if (tc_edge->edge_inv) {
+    olsr_spf_mark_dirty(tc_edge->edge_inv->tc);
+  }
+}
+
+/**
+ * Notify the SPF that an edge and its inverse edge are about to
+ * be removed. Must be called while both edges are still connected.
+ * @param tc_edge pointer to edge
+ */
+void
+olsr_spf_edge_deleted(struct tc_edge_entry *tc_edge)
+{
+  struct tc_entry *tc = tc_edge->tc;
+  struct tc_entry *tc_inv = tc_edge->edge_inv->tc;
+
+  /* do not keep references to a predecessor we cannot reach anymore */
+  if (tc_inv->spf_parent == tc) {
+    tc_inv->spf_parent = NULL;
+  }
+  if (tc->spf_parent == tc_inv) {
+    tc->spf_parent = NULL;
+  }
+
+  olsr_spf_mark_dirty(tc);
+  olsr_spf_mark_dirty(tc_inv);
+}
+
+/**
+ * Notify the SPF that a vertex is about to be freed.
+ * @param tc pointer to vertex
+ */
+void
+olsr_spf_vertex_deleted(struct tc_entry *tc)
+{
+  if (list_node_added(&tc->spf_dirty_node)) {
+    list_remove(&tc->spf_dirty_node);
+    spf_dirty_count--;
+  }
+}
+
+/*
+ * olsr_spf_check_vertex
+ *
+ * Check if the SPF result of a vertex still matches the edge to its
+ * predecessor on the shortest path tree.
+ * return false if the vertex has to be calculated again.
+ */
+static bool
+olsr_spf_check_vertex(struct tc_entry *tc)
+{
+  struct tc_entry *parent = tc->spf_parent;
+  struct tc_edge_entry *tc_edge;
+  olsr_linkcost cost;
+
+  if (tc == tc_myself) {
+    return true;
+  }
+  if (parent == NULL || tc->path_cost >= ROUTE_COST_BROKEN || parent->path_cost >= ROUTE_COST_BROKEN) {
+    return false;
+  }
+
+  tc_edge = olsr_lookup_tc_edge(parent, &tc->addr);
+  if (tc_edge == NULL) {
+    return false;
+  }
+
+  cost = olsr_spf_edge_cost(tc_edge);
+  if (cost >= LINK_COST_BROKEN || parent->path_cost + cost != tc->path_cost) {
+    return false;
+  }
+
+  return tc->next_hop == olsr_spf_next_hop(parent, tc);
+}
+
+/*
+ * olsr_spf_invalidate_subtree
+ *
+ * Reset the SPF result of a vertex and of all vertices which use it
+ * as predecessor. The vertices are collected on the invalid list.
+ */
+static void
+olsr_spf_invalidate_subtree(struct list_entity *invalid_list, struct tc_entry *root)
+{
+  struct tc_entry *tc;
+  struct tc_edge_entry *tc_edge, *iterator;
+#if !defined REMOVE_LOG_DEBUG
+  struct ipaddr_str buf;
+#endif
+
+  if (list_node_added(&root->path_list_node)) {
+    return;
+  }
+
+  OLSR_DEBUG(LOG_ROUTING, "SPF: invalidate subtree of %s\n", olsr_ip_to_string(&buf, &root->addr));
+
+  /* the invalid list doubles as work queue for the subtree walk */
+  list_add_tail(invalid_list, &root->path_list_node);
+
+  for (tc = root; &tc->path_list_node != invalid_list; tc = list_next_element(tc, path_list_node)) {
+    OLSR_FOR_ALL_TC_EDGE_ENTRIES(tc, tc_edge, iterator) {
+      struct tc_entry *child;
+
+      if (tc_edge->edge_inv == NULL) {
+        continue;
+      }
+
+      child = tc_edge->edge_inv->tc;
+      if (child->spf_parent == tc && !list_node_added(&child->path_list_node)) {
+        list_add_tail(invalid_list, &child->path_list_node);
+      }
+    }
+
+    tc->path_cost = ROUTE_COST_BROKEN;
+    tc->spf_parent = NULL;
+    tc->next_hop = NULL;
+    tc->hops = 0;
+  }
+}
+
+/*
+ * olsr_spf_pull_best
+ *
+ * Find the best predecessor of an invalidated vertex among its
+ * reachable neighbors and put the vertex on the candidate heap.
+ */
+static void
+olsr_spf_pull_best(struct pairing_heap *cand_heap, struct tc_entry *tc)
+{
+  struct tc_edge_entry *tc_edge, *iterator;
+  olsr_linkcost cost;
+
+  OLSR_FOR_ALL_TC_EDGE_ENTRIES(tc, tc_edge, iterator) {
+    struct tc_entry *pred;
+
+    if (tc_edge->edge_inv == NULL) {
+      continue;
+    }
+
+    pred = tc_edge->edge_inv->tc;
+    if (pred->path_cost >= ROUTE_COST_BROKEN) {
+      continue;
+    }
+
+    cost = olsr_spf_edge_cost(tc_edge->edge_inv);
+    if (cost >= LINK_COST_BROKEN) {
+      continue;
+    }
+
+    cost += pred->path_cost;
+    if (cost < tc->path_cost) {
+      tc->path_cost = cost;
+      tc->spf_parent = pred;
+    }
+  }
+
+  if (tc->spf_parent) {
+    tc->next_hop = olsr_spf_next_hop(tc->spf_parent, tc);
+    tc->hops = tc->spf_parent->hops + 1;
+    olsr_spf_add_cand_heap(cand_heap, tc);
+  }
+}
+
+/*
+ * olsr_spf_run_incremental
+ *
+ * Update the results of the last SPF run based on the vertices
+ * whose edges have changed since then.
+ *
+ * All vertices whose shortest path does not match the current edge
+ * costs anymore are invalidated together with their subtree. The
+ * invalidated vertices get their best remaining predecessor, the
+ * changed vertices are relaxed again and the Dijkstra algorithm
+ * propagates the improvements from there.
+ */
+static void
+olsr_spf_run_incremental(struct pairing_heap *cand_heap)
+{
+  struct list_entity invalid_list;
+  struct tc_entry *tc;
+  struct tc_edge_entry *tc_edge, *edge_iterator;
+  struct nbr_entry *neigh, *neigh_iterator;
+
+  list_init_head(&invalid_list);
+
+  /* the first hop of our neighbors might have changed without any edge change */
+  OLSR_FOR_ALL_NBR_ENTRIES(neigh, neigh_iterator) {
+    if (neigh->tc_edge && neigh->tc_edge->edge_inv) {
+      tc = neigh->tc_edge->edge_inv->tc;
+      if (tc->path_cost < ROUTE_COST_BROKEN && !olsr_spf_check_vertex(tc)) {
+        olsr_spf_invalidate_subtree(&invalid_list, tc);
+      }
+    }
+  }
+
+  /* check the changed vertices and their successors */
+  list_for_each_element(&spf_dirty_list, tc, spf_dirty_node) {
+    if (!olsr_spf_check_vertex(tc)) {
+      olsr_spf_invalidate_subtree(&invalid_list, tc);
+    }
+
+    OLSR_FOR_ALL_TC_EDGE_ENTRIES(tc, tc_edge, edge_iterator) {
+      struct tc_entry *child;
+
+      if (tc_edge->edge_inv == NULL) {
+        continue;
+      }
+
+      child = tc_edge->edge_inv->tc;
+      if (child->spf_parent == tc && !olsr_spf_check_vertex(child)) {
+        olsr_spf_invalidate_subtree(&invalid_list, child);
+      }
+    }
+  }
+
+  /* reconnect the invalidated vertices */
+  list_for_each_element(&invalid_list, tc, path_list_node) {
+    olsr_spf_pull_best(cand_heap, tc);
+  }
+  while (!list_is_empty(&invalid_list)) {
+    tc = list_first_element(&invalid_list, tc, path_list_node);
+    list_remove(&tc->path_list_node);
+  }
+
+  /* propagate cheaper paths through the changed vertices */
+  list_for_each_element(&spf_dirty_list, tc, spf_dirty_node) {
+    if (tc->path_cost < ROUTE_COST_BROKEN) {
+      olsr_spf_relax(cand_heap, tc);
+    }
+  }
+
+  while ((tc = olsr_spf_extract_best(cand_heap))) {
+    olsr_spf_relax(cand_heap, tc);
+  }
+
+  olsr_spf_flush_dirty();
+}
+
+static void olsr_spf_run(bool);
+
 /**
  * Callback for the SPF backoff timer.
+ * Runs the SPF calculation deferred by olsr_calculate_routing_table().
  */
 static void
 olsr_expire_spf_backoff(void *context __attribute__ ((unused)))
 {
   spf_backoff_timer = NULL;
+  olsr_spf_run(false);
 }
 
 void
 olsr_init_spf(void) {
   spf_backoff_timer_info = olsr_timer_add("SPF backoff", olsr_expire_spf_backoff, false);
+
+  list_init_head(&spf_dirty_list);
+  spf_dirty_count = 0;
+  spf_results_valid = false;
+
+  spf_hold_time = olsr_cnf->spf_hold_time;
+  spf_has_run = false;
+
+  olsr_profile_add(&spf_profile, "olsr_calculate_routing_table");
 }
 
+/*
+ * olsr_spf_check_results
+ *
+ * Compare the path costs of the last incremental run (saved in
+ * spf_check_cost) with the results of a full SPF run.
+ */
+static void
+olsr_spf_check_results(void)
+{
+  struct tc_entry *tc, *iterator;
+  unsigned int mismatch = 0;
+
+  OLSR_FOR_ALL_TC_ENTRIES(tc, iterator) {
+    if (tc->spf_check_cost != tc->path_cost) {
+#if !defined REMOVE_LOG_DEBUG
+      struct ipaddr_str buf;
+      char lqbuffer1[LQTEXT_MAXLENGTH], lqbuffer2[LQTEXT_MAXLENGTH];
+#endif
+      OLSR_DEBUG(LOG_ROUTING, "SPF: incremental cost %s for %s differs from full cost %s\n",
+                 olsr_get_linkcost_text(tc->spf_check_cost, false, lqbuffer1, sizeof(lqbuffer1)),
+                 olsr_ip_to_string(&buf, &tc->addr),
+                 olsr_get_linkcost_text(tc->path_cost, false, lqbuffer2, sizeof(lqbuffer2)));
+      mismatch++;
+    }
+  }
+
+  if (mismatch > 0) {
+    OLSR_WARN(LOG_ROUTING, "SPF: incremental result differs from full SPF for %u of %u nodes\n",
+              mismatch, tc_tree.count);
+  }
+}
+
+/*
+ * olsr_spf_update_hold_time
+ *
+ * Adapt the SPF hold time to the rate of topology changes.
+ * A run triggered within one hold time after the last throttled run
+ * doubles the hold time (up to the configured maximum), every quiet
+ * hold time period halves it again (down to the configured minimum).
+ */
+static void
+olsr_spf_update_hold_time(void)
+{
+  uint32_t now, quiet;
+
+  now = olsr_clock_getNow();
+
+  if (spf_has_run) {
+    quiet = now - spf_last_run;
+
+    if (quiet < 2 * spf_hold_time) {
+      spf_hold_time = MIN(2 * spf_hold_time, olsr_cnf->spf_max_hold_time);
+    }
+    else {
+      quiet -= spf_hold_time;
+      while (quiet >= spf_hold_time && spf_hold_time > olsr_cnf->spf_hold_time) {
+        quiet -= spf_hold_time;
+        spf_hold_time /= 2;
+      }
+      spf_hold_time = MAX(spf_hold_time, olsr_cnf->spf_hold_time);
+    }
+  }
+
+  spf_has_run = true;
+  spf_last_run = now;
+}
+
+/**
+ * Trigger a SPF calculation and an update of the RIB and kernel routes.
+ *
+ * The calculation is throttled: the first run after a quiet period
+ * starts after SpfInitialDelay, further runs are delayed until the
+ * current hold time since the last run has passed. All changes
+ * reported in the meantime are handled by the deferred run.
+ *
+ * @param force true to run a full calculation immediately
+ */
 void
 olsr_calculate_routing_table(bool force)
+{
+  uint32_t delay;
+  int32_t since;
+
+  if (force) {
+    olsr_timer_stop(spf_backoff_timer);
+    spf_backoff_timer = NULL;
+    olsr_spf_run(true);
+    return;
+  }
+
+  /* We are done if a run is already scheduled */
+  if (spf_backoff_timer != NULL) {
+    return;
+  }
+
+  delay = olsr_cnf->spf_initial_delay;
+  if (spf_has_run) {
+    since = -olsr_clock_getRelative(spf_last_run);
+    if (since >= 0 && (uint32_t)since < spf_hold_time) {
+      delay = MAX(delay, spf_hold_time - (uint32_t)since);
+    }
+  }
+
+  if (delay == 0) {
+    olsr_spf_run(false);
+    return;
+  }
+
+  OLSR_DEBUG(LOG_ROUTING, "SPF: delay run for %u ms (hold time %u ms)\n", delay, spf_hold_time);
+  olsr_timer_set(&spf_backoff_timer, delay, 0, NULL, spf_backoff_timer_info);
+}
+
+/*
+ * olsr_spf_calculate
+ *
+ * Run the SPF calculation and push the results into the RIB
+ * and the kernel. If force is set the incremental mode is skipped.
+ */
+static void
+olsr_spf_calculate(bool force)
 {
 #ifdef SPF_PROFILING
   struct timeval t1, t2, t3, t4, t5, spf_init, spf_run, route, kernel, total;
 #endif
-  struct avl_tree cand_tree;
+  struct pairing_heap cand_heap;
   struct list_entity path_list;          /* head of the path_list */
   struct tc_entry *tc, *tc_iterator;
-  struct rt_path *rtp, *rtp_iterator;
-  struct tc_edge_entry *tc_edge;
-  struct nbr_entry *neigh, *neigh_iterator;
-  struct link_entry *link;
   int path_count = 0;
+  bool full, check;
 #if !defined(REMOVE_LOG_DEBUG)
   struct timeval_buf timebuf;
 #endif
 
-  /* We are done if our backoff timer is running */
-  if (!force && spf_backoff_timer != NULL) {
-    return;
-  }
-
-  olsr_timer_set(&spf_backoff_timer, OLSR_SPF_BACKOFF_TIME, OLSR_SPF_BACKOFF_JITTER,
-      NULL, spf_backoff_timer_info);
+  olsr_spf_update_hold_time();
 
 #ifdef SPF_PROFILING
   gettimeofday(&t1, NULL);
 #endif
 
   /*
-   * Prepare the candidate tree and result list.
+   * Prepare the candidate heap and result list.
    */
-  avl_init(&cand_tree, avl_comp_etx, true, NULL);
+  pairing_heap_init(&cand_heap);
   list_init_head(&path_list);
-  olsr_bump_routingtree_version();
 
   /*
-   * Initialize vertices in the lsdb.
+   * Update the last results if possible. A change of the main IP address
+   * or a large number of changes are handled by a full SPF run.
    */
-  OLSR_FOR_ALL_TC_ENTRIES(tc, tc_iterator) {
-    tc->next_hop = NULL;
-    tc->path_cost = ROUTE_COST_BROKEN;
-    tc->hops = 0;
-    tc->cand_tree_node.key = NULL;
-    list_init_head(&tc->path_list_node);
+  full = force || !olsr_cnf->spf_incremental || !spf_results_valid
+    || tc_myself == NULL || olsr_ipcmp(&tc_myself->addr, &olsr_cnf->router_id) != 0
+    || spf_dirty_count > tc_tree.count / 4;
+  check = false;
+
+  if (!full) {
+    OLSR_DEBUG(LOG_ROUTING, "SPF: incremental run for %u changed nodes\n", spf_dirty_count);
+
+    olsr_spf_run_incremental(&cand_heap);
+
+    /* verify the incremental results with a full run from time to time */
+    check = olsr_cnf->spf_check_interval > 0 && olsr_clock_isPast(spf_check_time);
+
+    if (check) {
+      OLSR_FOR_ALL_TC_ENTRIES(tc, tc_iterator) {
+        tc->spf_check_cost = tc->path_cost;
+      }
+    }
   }
 
-  /*
-   * Check if there was a change in the main IP address.
-   * Bail if there is no main IP address.
-   */
-  olsr_change_myself_tc();
-  if (!tc_myself) {
+  if (full || check) {
+    /*
+     * Initialize vertices in the lsdb.
+     */
+    OLSR_FOR_ALL_TC_ENTRIES(tc, tc_iterator) {
+      tc->next_hop = NULL;
+      tc->spf_parent = NULL;
+      tc->path_cost = ROUTE_COST_BROKEN;
+      tc->hops = 0;
+      pairing_heap_init_node(&tc->cand_heap_node);
+      list_init_node(&tc->path_list_node);
+    }
 
     /*
-     * All gone now. Flush all routes.
+     * Check if there was a change in the main IP address.
+     * Bail if there is no main IP address.
      */
-    olsr_update_rib_routes();
-    olsr_update_kernel_routes();
-    return;
-  }
+    olsr_change_myself_tc();
+    if (!tc_myself) {
 
-  /*
-   * zero ourselves and add us to the candidate tree.
-   */
-  tc_myself->path_cost = ZERO_ROUTE_COST;
-  olsr_spf_add_cand_tree(&cand_tree, tc_myself);
+      /*
+       * All gone now. Flush all routes.
+       */
+      spf_results_valid = false;
+      OLSR_FOR_ALL_TC_ENTRIES(tc, tc_iterator) {
+        olsr_update_tc_routes(tc, NULL);
+      }
+      olsr_update_rib_routes();
+      olsr_update_kernel_routes();
+      return;
+    }
 
-  /*
-   * Set the next-hops of our neighbor link.
-   */
-  OLSR_FOR_ALL_NBR_ENTRIES(neigh, neigh_iterator) {
-    tc_edge = neigh->tc_edge;
+    /*
+     * zero ourselves and add us to the candidate heap.
+     * The next-hops of our neighbors are set up while relaxing our edges.
+     */
+    tc_myself->path_cost = ZERO_ROUTE_COST;
+    olsr_spf_add_cand_heap(&cand_heap, tc_myself);
 
-    if (neigh->is_sym) {
-      /* edges are always symmetric */
-      assert(tc_edge->edge_inv);
+#ifdef SPF_PROFILING
+    gettimeofday(&t2, NULL);
+#endif
 
-      tc_edge->edge_inv->tc->next_hop = get_best_link_to_neighbor(neigh);
+    /*
+     * Run the SPF calculation.
+     */
+    olsr_spf_run_full(&cand_heap, &path_list, &path_count);
+
+    olsr_spf_flush_dirty();
+    spf_results_valid = true;
+    spf_check_time = olsr_clock_getAbsolute(olsr_cnf->spf_check_interval);
+
+    if (check) {
+      olsr_spf_check_results();
     }
   }
-
 #ifdef SPF_PROFILING
-  gettimeofday(&t2, NULL);
+  else {
+    gettimeofday(&t2, NULL);
+  }
 #endif
 
-  /*
-   * Run the SPF calculation.
-   */
-  olsr_spf_run_full(&cand_tree, &path_list, &path_count);
-
   OLSR_DEBUG(LOG_ROUTING, "\n--- %s ------------------------------------------------- DIJKSTRA\n\n",
       olsr_clock_getWallclockString(&timebuf));
 
@@ -381,51 +828,28 @@ olsr_calculate_routing_table(bool force)
   gettimeofday(&t3, NULL);
 #endif
 
-  /*
-   * In the path list we have all the reachable nodes in our topology.
-   */
+  /* the path list is only needed by the SPF run itself */
   while (!list_is_empty(&path_list)) {
     tc = list_first_element(&path_list, tc, path_list_node);
     list_remove(&tc->path_list_node);
+  }
 
-    link = tc->next_hop;
-
-    if (!link) {
-      /*
-       * Supress the error msg when our own tc_entry
-       * does not contain a next-hop.
-       */
-      if (tc != tc_myself) {
+  /*
+   * Push the results into the RIB. Only nodes whose nexthop or
+   * metric has changed put their prefixes on the RIB dirty list.
+   */
+  OLSR_FOR_ALL_TC_ENTRIES(tc, tc_iterator) {
+    if (tc->path_cost < ROUTE_COST_BROKEN && tc->next_hop != NULL) {
+      olsr_update_tc_routes(tc, tc->next_hop);
+    }
+    else {
+      if (tc != tc_myself && tc->path_cost < ROUTE_COST_BROKEN) {
 #if !defined REMOVE_LOG_DEBUG
         struct ipaddr_str buf;
 #endif
         OLSR_DEBUG(LOG_ROUTING, "SPF: %s no next-hop\n", olsr_ip_to_string(&buf, &tc->addr));
       }
-      continue;
-    }
-
-    /*
-     * Now walk all prefixes advertised by that node.
-     * Since the node is reachable, insert the prefix into the global RIB.
-     * If the prefix is already in the RIB, refresh the entry such
-     * that olsr_delete_outdated_routes() does not purge it off.
-     */
-    OLSR_FOR_ALL_PREFIX_ENTRIES(tc, rtp, rtp_iterator) {
-      if (rtp->rtp_rt) {
-
-        /*
-         * If there is a route entry, the prefix is already in the global RIB.
-         */
-        olsr_update_rt_path(rtp, tc, link);
-
-      } else {
-
-        /*
-         * The prefix is reachable and not yet in the global RIB.
-         * Build a rt_entry for it.
-         */
-        olsr_insert_rt_path(rtp, tc, link);
-      }
+      olsr_update_tc_routes(tc, NULL);
     }
   }
 
@@ -458,6 +882,21 @@ olsr_calculate_routing_table(bool force)
 #endif
 }
 
+/*
+ * olsr_spf_run
+ *
+ * Run the SPF calculation and account the time spent in it.
+ */
+static void
+olsr_spf_run(bool force)
+{
+  uint64_t start;
+
+  start = olsr_profile_start();
+  olsr_spf_calculate(force);
+  olsr_profile_stop(&spf_profile, start);
+}
+
 /*
  * Local Variables:
  * c-basic-offset: 2
@@ -44,12 +44,17 @@
 
 #include "olsr_types.h"
 
-#define OLSR_SPF_BACKOFF_TIME  (1*1000) /* milliseconds */
-#define OLSR_SPF_BACKOFF_JITTER 5       /* percent */
+struct tc_entry;
+struct tc_edge_entry;
 
 void olsr_init_spf(void);
 void olsr_calculate_routing_table(bool);
 
+/* change notifications for incremental SPF */
+void olsr_spf_edge_changed(struct tc_edge_entry *);
+void olsr_spf_edge_deleted(struct tc_edge_entry *);
+void olsr_spf_vertex_deleted(struct tc_entry *);
+
 #endif
 
 /*
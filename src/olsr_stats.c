@@ -0,0 +1,373 @@
+
+/*
+ * The olsr.org Optimized Link-State Routing daemon(olsrd)
+ * Copyright (c) 2004-2009, the olsr.org team - see HISTORY file
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of olsr.org, olsrd nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Visit http://www.olsr.org for more information.
+ *
+ * If you find this software useful feel free to make a donation
+ * to the project. For more information see the website or contact
+ * the copyright holders.
+ *
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "olsr_memcookie.h"
+#include "olsr_profile.h"
+#include "olsr_timer.h"
+#include "olsr_stats.h"
+
+/* list of all registered counters and gauges */
+struct list_entity stats_list;
+
+/* smallest histogram limit in the output, durations below are not interesting */
+#define OLSR_STATS_MIN_LIMIT 1024
+
+/**
+ * Initialize the stats list
+ */
+void
+olsr_stats_init(void)
+{
+  list_init_head(&stats_list);
+}
+
+/**
+ * Register a counter or gauge. The value is cleared before it is added.
+ * @param stats pointer to counter or gauge
+ * @param name metric name, must consist of [a-zA-Z0-9_:]
+ * @param help description of the metric
+ * @param type counter or gauge
+ */
+void
+olsr_stats_add(struct olsr_stats *stats, const char *name, const char *help, enum olsr_stats_type type)
+{
+  stats->name = name;
+  stats->help = help;
+  stats->type = type;
+  stats->value = 0;
+  stats->get_value = NULL;
+
+  list_add_tail(&stats_list, &stats->node);
+}
+
+/**
+ * Unregister a counter or gauge
+ * @param stats pointer to counter or gauge
+ */
+void
+olsr_stats_remove(struct olsr_stats *stats)
+{
+  if (list_node_added(&stats->node)) {
+    list_remove(&stats->node);
+  }
+}
+
+/**
+ * Append a string as a label value, escaping backslashes,
+ * quotes and line feeds.
+ * @param abuf pointer to output buffer
+ * @param value label value
+ * @return -1 if an error happened, 0 otherwise
+ */
+static int
+olsr_stats_print_label(struct autobuf *abuf, const char *value)
+{
+  char tmp[2] = { 0, 0 };
+
+  for (; *value; value++) {
+    if (*value == '\\' || *value == '"') {
+      tmp[0] = *value;
+      if (abuf_puts(abuf, "\\") < 0 || abuf_puts(abuf, tmp) < 0) {
+        return -1;
+      }
+    }
+    else if (*value == '\n') {
+      if (abuf_puts(abuf, "\\n") < 0) {
+        return -1;
+      }
+    }
+    else {
+      tmp[0] = *value;
+      if (abuf_puts(abuf, tmp) < 0) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * Append the header of a metric family
+ * @param abuf pointer to output buffer
+ * @param name metric name
+ * @param help description of the metric
+ * @param type Prometheus type of the metric
+ * @return -1 if an error happened, 0 otherwise
+ */
+static int
+olsr_stats_print_header(struct autobuf *abuf, const char *name, const char *help, const char *type)
+{
+  if (abuf_appendf(abuf, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Append a labeled value of a metric family
+ * @param abuf pointer to output buffer
+ * @param name metric name
+ * @param label name of the label
+ * @param label_value value of the label
+ * @param value value of the metric
+ * @return -1 if an error happened, 0 otherwise
+ */
+static int
+olsr_stats_print_labeled(struct autobuf *abuf, const char *name, const char *label,
+    const char *label_value, uint64_t value)
+{
+  if (abuf_appendf(abuf, "%s{%s=\"", name, label) < 0
+      || olsr_stats_print_label(abuf, label_value) < 0
+      || abuf_appendf(abuf, "\"} %" PRIu64 "\n", value) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Names of profiles and timer classes are not unique, e.g.
+ * all handlers of a message type share one profile name and a plugin
+ * can register a timer class named like one of the core. A series must
+ * appear only once in the output, so all entries with the same name
+ * are merged into the first one and the others are skipped.
+ */
+
+/**
+ * @param profile pointer to profile
+ * @return true if a profile with the same name comes first in the list
+ */
+static bool
+olsr_stats_profile_is_duplicate(const struct olsr_profile *profile)
+{
+  struct olsr_profile *other, *iterator;
+
+  OLSR_FOR_ALL_PROFILES(other, iterator) {
+    if (other == profile) {
+      return false;
+    }
+    if (strcmp(other->name, profile->name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @param ti pointer to timer class
+ * @return true if a timer class with the same name comes first in the list
+ */
+static bool
+olsr_stats_timer_is_duplicate(const struct olsr_timer_info *ti)
+{
+  struct olsr_timer_info *other, *iterator;
+
+  OLSR_FOR_ALL_TIMERS(other, iterator) {
+    if (other == ti) {
+      return false;
+    }
+    if (strcmp(other->name, ti->name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Append the histogram of a runtime profile, merged with all
+ * other profiles of the same name. The bucket limits
+ * are the powers of four, converted to seconds.
+ * @param abuf pointer to output buffer
+ * @param first pointer to the first profile with this name
+ * @return -1 if an error happened, 0 otherwise
+ */
+static int
+olsr_stats_print_profile(struct autobuf *abuf, const struct olsr_profile *first)
+{
+  static const char name[] = "olsr_profile_duration_seconds";
+  struct olsr_profile *other, *iterator;
+  struct olsr_profile merged, *profile = &merged;
+  uint64_t sum = 0, limit;
+  unsigned int idx;
+
+  memcpy(&merged, first, sizeof(merged));
+  OLSR_FOR_ALL_PROFILES(other, iterator) {
+    if (other == first || strcmp(other->name, first->name) != 0) {
+      continue;
+    }
+    merged.count += other->count;
+    merged.total += other->total;
+    for (idx = 0; idx < OLSR_PROFILE_BUCKETS; idx++) {
+      merged.buckets[idx] += other->buckets[idx];
+    }
+  }
+
+  for (idx = 0; idx < OLSR_PROFILE_BUCKETS - 1; idx++) {
+    sum += profile->buckets[idx];
+
+    /* the bucket ends right below a power of four */
+    limit = olsr_profile_get_bucket_limit(idx) + 1;
+    if (limit < OLSR_STATS_MIN_LIMIT || (limit & (limit - 1)) != 0 || (__builtin_ctzll(limit) & 1) != 0) {
+      continue;
+    }
+
+    if (abuf_appendf(abuf, "%s_bucket{path=\"", name) < 0
+        || olsr_stats_print_label(abuf, profile->name) < 0
+        || abuf_appendf(abuf, "\",le=\"%.9f\"} %" PRIu64 "\n", (double)limit / 1000000000.0, sum) < 0) {
+      return -1;
+    }
+  }
+
+  if (abuf_appendf(abuf, "%s_bucket{path=\"", name) < 0
+      || olsr_stats_print_label(abuf, profile->name) < 0
+      || abuf_appendf(abuf, "\",le=\"+Inf\"} %u\n", profile->count) < 0
+      || abuf_appendf(abuf, "%s_sum{path=\"", name) < 0
+      || olsr_stats_print_label(abuf, profile->name) < 0
+      || abuf_appendf(abuf, "\"} %.9f\n", (double)profile->total / 1000000000.0) < 0
+      || abuf_appendf(abuf, "%s_count{path=\"", name) < 0
+      || olsr_stats_print_label(abuf, profile->name) < 0
+      || abuf_appendf(abuf, "\"} %u\n", profile->count) < 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Print all counters, gauges, runtime profiles, memory cookies and
+ * timers in the Prometheus text exposition format.
+ * @param abuf pointer to output buffer
+ * @return -1 if an error happened, 0 otherwise
+ */
+int
+olsr_stats_print(struct autobuf *abuf)
+{
+  struct olsr_stats *stats, *stats_iterator;
+  struct olsr_profile *profile, *profile_iterator;
+  struct olsr_memcookie_info *ci, *ci_iterator;
+  struct olsr_timer_info *ti, *ti_iterator, *ti_other, *ti_other_iterator;
+  uint64_t value;
+
+  OLSR_FOR_ALL_STATS(stats, stats_iterator) {
+    value = stats->get_value != NULL ? stats->get_value() : stats->value;
+
+    if (olsr_stats_print_header(abuf, stats->name, stats->help,
+          stats->type == OLSR_STATS_COUNTER ? "counter" : "gauge") < 0
+        || abuf_appendf(abuf, "%s %" PRIu64 "\n", stats->name, value) < 0) {
+      return -1;
+    }
+  }
+
+  if (olsr_stats_print_header(abuf, "olsr_profile_duration_seconds",
+        "Duration of the profiled code paths", "histogram") < 0) {
+    return -1;
+  }
+  OLSR_FOR_ALL_PROFILES(profile, profile_iterator) {
+    if (!olsr_stats_profile_is_duplicate(profile) && olsr_stats_print_profile(abuf, profile) < 0) {
+      return -1;
+    }
+  }
+
+  if (olsr_stats_print_header(abuf, "olsr_memory_blocks", "Memory blocks in use", "gauge") < 0) {
+    return -1;
+  }
+  OLSR_FOR_ALL_COOKIES(ci, ci_iterator) {
+    if (olsr_stats_print_labeled(abuf, "olsr_memory_blocks", "cookie", ci->ci_name, ci->ci_usage) < 0) {
+      return -1;
+    }
+  }
+
+  if (olsr_stats_print_header(abuf, "olsr_memory_allocations_total", "Memory blocks allocated and freed", "counter") < 0) {
+    return -1;
+  }
+  OLSR_FOR_ALL_COOKIES(ci, ci_iterator) {
+    if (olsr_stats_print_labeled(abuf, "olsr_memory_allocations_total", "cookie", ci->ci_name, ci->ci_changes) < 0) {
+      return -1;
+    }
+  }
+
+  if (olsr_stats_print_header(abuf, "olsr_timers", "Running timers", "gauge") < 0) {
+    return -1;
+  }
+  OLSR_FOR_ALL_TIMERS(ti, ti_iterator) {
+    if (olsr_stats_timer_is_duplicate(ti)) {
+      continue;
+    }
+
+    value = 0;
+    OLSR_FOR_ALL_TIMERS(ti_other, ti_other_iterator) {
+      if (strcmp(ti_other->name, ti->name) == 0) {
+        value += ti_other->usage;
+      }
+    }
+    if (olsr_stats_print_labeled(abuf, "olsr_timers", "timer", ti->name, value) < 0) {
+      return -1;
+    }
+  }
+
+  if (olsr_stats_print_header(abuf, "olsr_timer_changes_total", "Timer starts, stops and expirations", "counter") < 0) {
+    return -1;
+  }
+  OLSR_FOR_ALL_TIMERS(ti, ti_iterator) {
+    if (olsr_stats_timer_is_duplicate(ti)) {
+      continue;
+    }
+
+    value = 0;
+    OLSR_FOR_ALL_TIMERS(ti_other, ti_other_iterator) {
+      if (strcmp(ti_other->name, ti->name) == 0) {
+        value += ti_other->changes;
+      }
+    }
+    if (olsr_stats_print_labeled(abuf, "olsr_timer_changes_total", "timer", ti->name, value) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * End:
+ */
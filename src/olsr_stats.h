@@ -0,0 +1,118 @@
+
+/*
+ * The olsr.org Optimized Link-State Routing daemon(olsrd)
+ * Copyright (c) 2004-2009, the olsr.org team - see HISTORY file
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of olsr.org, olsrd nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Visit http://www.olsr.org for more information.
+ *
+ * If you find this software useful feel free to make a donation
+ * to the project. For more information see the website or contact
+ * the copyright holders.
+ *
+ */
+
+#ifndef _OLSR_STATS_H
+#define _OLSR_STATS_H
+
+#include "common/autobuf.h"
+#include "common/list.h"
+#include "common/common_types.h"
+#include "defs.h"
+
+/*
+ * Named counters and gauges of olsrd and its plugins.
+ *
+ * Updating a value is a plain memory access, so the counters can be
+ * used in the packet path. All values, together with the duration
+ * histograms of the runtime profiles, can be read in the Prometheus
+ * text format with the "metrics" command or the /metrics http path.
+ */
+enum olsr_stats_type {
+  OLSR_STATS_COUNTER,
+  OLSR_STATS_GAUGE
+};
+
+struct olsr_stats {
+  /* node of stats list */
+  struct list_entity node;
+
+  /* metric name and description, both must stay valid while registered */
+  const char *name;
+  const char *help;
+
+  enum olsr_stats_type type;
+
+  /* current value */
+  uint64_t value;
+
+  /* optional callback to read the value of a gauge on output */
+  uint64_t (*get_value)(void);
+};
+
+#define OLSR_FOR_ALL_STATS(stats, iterator) list_for_each_element_safe(&stats_list, stats, node, iterator)
+
+extern struct list_entity EXPORT(stats_list);
+
+void olsr_stats_init(void);
+
+void EXPORT(olsr_stats_add)(struct olsr_stats *, const char *, const char *, enum olsr_stats_type);
+void EXPORT(olsr_stats_remove)(struct olsr_stats *);
+int EXPORT(olsr_stats_print)(struct autobuf *);
+
+/**
+ * Increment a counter
+ * @param stats pointer to counter
+ */
+static INLINE void
+olsr_stats_inc(struct olsr_stats *stats)
+{
+  stats->value++;
+}
+
+/**
+ * Set the value of a gauge
+ * @param stats pointer to gauge
+ * @param value new value
+ */
+static INLINE void
+olsr_stats_set(struct olsr_stats *stats, uint64_t value)
+{
+  stats->value = value;
+}
+
+#endif /* _OLSR_STATS_H */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 2
+ * indent-tabs-mode: nil
+ * End:
+ */
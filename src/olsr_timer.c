@@ -41,6 +41,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -51,9 +52,12 @@
 #include "olsr_memcookie.h"
 #include "olsr_timer.h"
 
-/* Hashed root of all timers */
+/* Hashed root of all timers, root level slots followed by the higher levels */
 static struct list_entity timer_wheel[TIMER_WHEEL_SLOTS];
-static uint32_t timer_last_run;        /* remember the last timeslot walk */
+static uint32_t timer_last_run;        /* next clocktick the timer walk has to process */
+
+/* bitmap of root level slots that might contain timers */
+static uint32_t timer_root_bitmap[TIMER_WHEEL_ROOT_SLOTS / 32];
 
 /* Memory cookie for the timer manager */
 struct list_entity timerinfo_list;
@@ -62,6 +66,24 @@ static struct olsr_memcookie_info *timerinfo_cookie = NULL;
 
 /* Prototypes */
 static uint32_t calc_jitter(unsigned int rel_time, uint8_t jitter_pct, unsigned int random_val);
+static uint32_t calc_coalescing(uint32_t clock, uint32_t window);
+static void olsr_timer_enqueue(struct olsr_timer_entry *timer);
+static void olsr_timer_cascade(int level);
+static uint32_t olsr_timer_find_root_slot(uint32_t slot);
+static uint32_t olsr_timer_next_root_slot(uint32_t clock);
+
+/**
+ * Calculate the timer wheel slot of a higher wheel level
+ * @param level wheel level (0 is the first level above the root)
+ * @param clock absolute time
+ * @return index in the timer wheel array
+ */
+static inline uint32_t
+timer_wheel_level_slot(int level, uint32_t clock)
+{
+  return TIMER_WHEEL_ROOT_SLOTS + level * TIMER_WHEEL_LEVEL_SLOTS
+      + ((clock >> (TIMER_WHEEL_ROOT_BITS + level * TIMER_WHEEL_LEVEL_BITS)) & TIMER_WHEEL_LEVEL_MASK);
+}
 
 /**
  * Init datastructures for maintaining timers.
@@ -86,6 +108,9 @@ olsr_timer_init(void)
   /* Allocate a cookie for the block based memory manager. */
   timer_mem_cookie = olsr_memcookie_add("timer_entry", sizeof(struct olsr_timer_entry));
 
+  /* olsr_timer_start() sets all fields, timer_random is kept on purpose */
+  olsr_memcookie_set_slab(timer_mem_cookie, true);
+
   list_init_head(&timerinfo_list);
   timerinfo_cookie = olsr_memcookie_add("timerinfo", sizeof(struct olsr_timer_info));
 }
@@ -107,7 +132,7 @@ olsr_timer_cleanup(void)
   }
 
   for (wheel_slot = 0; wheel_slot < TIMER_WHEEL_SLOTS; wheel_slot++) {
-    timer_head_node = &timer_wheel[wheel_slot & TIMER_WHEEL_MASK];
+    timer_head_node = &timer_wheel[wheel_slot];
 
     /* Kill all entries hanging off this hash bucket. */
     while (!list_is_empty(timer_head_node)) {
@@ -121,6 +146,7 @@ olsr_timer_cleanup(void)
   /* free all timerinfos */
   OLSR_FOR_ALL_TIMERS(ti, iterator) {
     list_remove(&ti->node);
+    olsr_profile_remove(&ti->profile);
     free(ti->name);
     olsr_memcookie_free(timerinfo_cookie, ti);
   }
@@ -139,12 +165,16 @@ olsr_timer_cleanup(void)
 struct olsr_timer_info *
 olsr_timer_add(const char *name, timer_cb_func callback, bool periodic) {
   struct olsr_timer_info *ti;
+  char profile_name[OLSR_PROFILE_NAME_LENGTH];
 
   ti = olsr_memcookie_malloc(timerinfo_cookie);
   ti->name = strdup(name);
   ti->callback = callback;
   ti->periodic = periodic;
 
+  snprintf(profile_name, sizeof(profile_name), "timer %s", name);
+  olsr_profile_add(&ti->profile, profile_name);
+
   list_add_tail(&timerinfo_list, &ti->node);
   return ti;
 }
@@ -169,6 +199,7 @@ olsr_timer_remove(struct olsr_timer_info *info) {
   }
 
   list_remove(&info->node);
+  olsr_profile_remove(&info->profile);
   free (info->name);
 
   olsr_memcookie_free(timerinfo_cookie, info);
@@ -207,6 +238,7 @@ olsr_timer_start(unsigned int rel_time,
 
   /* Fill entry */
   timer->timer_clock = calc_jitter(rel_time, jitter_pct, timer->timer_random);
+  timer->timer_clock = calc_coalescing(timer->timer_clock, ti->coalescing);
   timer->timer_cb_context = context;
   timer->timer_jitter_pct = jitter_pct;
   timer->timer_running = true;
@@ -222,7 +254,7 @@ olsr_timer_start(unsigned int rel_time,
   /*
    * Now insert in the respective timer_wheel slot.
    */
-  list_add_before(&timer_wheel[timer->timer_clock & TIMER_WHEEL_MASK], &timer->timer_list);
+  olsr_timer_enqueue(timer);
 
   OLSR_DEBUG(LOG_TIMER, "TIMER: start %s timer %p firing in %s, ctx %p\n",
              ti->name, timer, olsr_clock_toClockString(&timebuf, timer->timer_clock), context);
@@ -290,6 +322,7 @@ olsr_timer_change(struct olsr_timer_entry *timer, unsigned int rel_time, uint8_t
   timer->timer_period = timer->timer_info->periodic ? rel_time : 0;
 
   timer->timer_clock = calc_jitter(rel_time, jitter_pct, timer->timer_random);
+  timer->timer_clock = calc_coalescing(timer->timer_clock, timer->timer_info->coalescing);
   timer->timer_jitter_pct = jitter_pct;
 
   /*
@@ -297,7 +330,7 @@ olsr_timer_change(struct olsr_timer_entry *timer, unsigned int rel_time, uint8_t
    * and reinsert into the new slot.
    */
   list_remove(&timer->timer_list);
-  list_add_before(&timer_wheel[timer->timer_clock & TIMER_WHEEL_MASK], &timer->timer_list);
+  olsr_timer_enqueue(timer);
 
   OLSR_DEBUG(LOG_TIMER, "TIMER: change %s timer %p, firing to %s, ctx %p\n",
              timer->timer_info->name, timer,
@@ -367,6 +400,197 @@ calc_jitter(unsigned int rel_time, uint8_t jitter_pct, unsigned int random_val)
   return olsr_clock_getAbsolute(rel_time - jitter_time);
 }
 
+/**
+ * Delay an absolute timestamp to the next multiple of a coalescing window,
+ * so that all timers with the same window in this range fire together.
+ *
+ * @param clock absolute timestamp
+ * @param window coalescing window in milliseconds, 0 to disable
+ * @return coalesced absolute timestamp
+ */
+static uint32_t
+calc_coalescing(uint32_t clock, uint32_t window)
+{
+  if (window <= 1) {
+    return clock;
+  }
+
+  clock += window - 1;
+  return clock - (clock % window);
+}
+
+/**
+ * Insert a timer into the wheel slot matching its expiration time.
+ * Timers which expire within one revolution of the root level go
+ * directly into a root slot, all others into the lowest wheel level
+ * that can represent their distance.
+ * @param timer pointer to timer entry
+ */
+static void
+olsr_timer_enqueue(struct olsr_timer_entry *timer)
+{
+  uint32_t delta, slot;
+  int level;
+
+  delta = timer->timer_clock - timer_last_run;
+
+  if ((int32_t)delta < 0) {
+    /* already expired, fire with the next processed clocktick */
+    slot = timer_last_run & TIMER_WHEEL_ROOT_MASK;
+  }
+  else if (delta < TIMER_WHEEL_ROOT_SLOTS) {
+    slot = timer->timer_clock & TIMER_WHEEL_ROOT_MASK;
+  }
+  else {
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+      if (delta < (1u << (TIMER_WHEEL_ROOT_BITS + (level + 1) * TIMER_WHEEL_LEVEL_BITS))) {
+        break;
+      }
+    }
+    slot = timer_wheel_level_slot(level, timer->timer_clock);
+  }
+
+  if (slot < TIMER_WHEEL_ROOT_SLOTS) {
+    timer_root_bitmap[slot / 32] |= (1u << (slot % 32));
+  }
+  list_add_tail(&timer_wheel[slot], &timer->timer_list);
+}
+
+/**
+ * Move all timers of the current slot of a wheel level
+ * one or more levels down.
+ * @param level wheel level (0 is the first level above the root)
+ */
+static void
+olsr_timer_cascade(int level)
+{
+  struct list_entity tmp_head_node;
+  struct olsr_timer_entry *timer;
+
+  list_init_head(&tmp_head_node);
+  list_merge(&tmp_head_node, &timer_wheel[timer_wheel_level_slot(level, timer_last_run)]);
+
+  while (!list_is_empty(&tmp_head_node)) {
+    timer = list_first_element(&tmp_head_node, timer, timer_list);
+
+    list_remove(&timer->timer_list);
+    olsr_timer_enqueue(timer);
+  }
+}
+
+/**
+ * Find the first root slot containing timers, starting at a certain slot.
+ * Bits left behind in the bitmap by stopped timers are cleared on the way.
+ * @param slot first root slot to check
+ * @return index of root slot, TIMER_WHEEL_ROOT_SLOTS if no timer was found
+ */
+static uint32_t
+olsr_timer_find_root_slot(uint32_t slot)
+{
+  uint32_t bits;
+
+  while (slot < TIMER_WHEEL_ROOT_SLOTS) {
+    bits = timer_root_bitmap[slot / 32] >> (slot % 32);
+    if (bits == 0) {
+      slot = (slot | 31) + 1;
+      continue;
+    }
+
+    while ((bits & 1) == 0) {
+      bits >>= 1;
+      slot++;
+    }
+    if (!list_is_empty(&timer_wheel[slot])) {
+      return slot;
+    }
+
+    timer_root_bitmap[slot / 32] &= ~(1u << (slot % 32));
+    slot++;
+  }
+  return TIMER_WHEEL_ROOT_SLOTS;
+}
+
+/**
+ * Calculate the number of clockticks until the next root slot which
+ * contains timers. The search stops at the end of the root level
+ * because the higher levels have to be cascaded there.
+ * @param clock absolute time to start the search
+ * @return number of clockticks that can be skipped
+ */
+static uint32_t
+olsr_timer_next_root_slot(uint32_t clock)
+{
+  uint32_t slot;
+
+  slot = clock & TIMER_WHEEL_ROOT_MASK;
+  if (slot == 0) {
+    /* start of a new revolution, we need to cascade first */
+    return 0;
+  }
+
+  return olsr_timer_find_root_slot(slot) - slot;
+}
+
+/**
+ * Calculate when the next timer will fire, so the scheduler
+ * can sleep until then.
+ * @return absolute timestamp of the next timer event
+ */
+uint32_t
+olsr_timer_getNextEvent(void)
+{
+  struct olsr_timer_entry *timer;
+  uint32_t slot, idx, clock, best, rel;
+  int i, level;
+
+  slot = timer_last_run & TIMER_WHEEL_ROOT_MASK;
+
+  /* timers in the remaining part of the current root revolution */
+  if (slot != 0) {
+    idx = olsr_timer_find_root_slot(slot);
+    if (idx < TIMER_WHEEL_ROOT_SLOTS) {
+      return timer_last_run + (idx - slot);
+    }
+  }
+
+  /* start of the next root revolution, relative to the last timer walk */
+  clock = (TIMER_WHEEL_ROOT_SLOTS - slot) & TIMER_WHEEL_ROOT_MASK;
+  best = ~0u;
+
+  /* the lower part of the root level belongs to the next revolution */
+  idx = olsr_timer_find_root_slot(0);
+  if (idx < TIMER_WHEEL_ROOT_SLOTS) {
+    best = clock + idx;
+  }
+
+  /*
+   * Timers in higher levels fire at the earliest when their slot is
+   * cascaded, so look at the cascading slots of the next revolutions until
+   * they cannot contain anything earlier than the best candidate.
+   */
+  for (i = 0; i < TIMER_WHEEL_LEVEL_SLOTS && clock < best; i++, clock += TIMER_WHEEL_ROOT_SLOTS) {
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+      list_for_each_element(&timer_wheel[timer_wheel_level_slot(level, timer_last_run + clock)], timer, timer_list) {
+        rel = timer->timer_clock - timer_last_run;
+        if (rel < best) {
+          best = rel;
+        }
+      }
+
+      if ((((timer_last_run + clock) >> (TIMER_WHEEL_ROOT_BITS + level * TIMER_WHEEL_LEVEL_BITS))
+          & TIMER_WHEEL_LEVEL_MASK) != 0) {
+        break;
+      }
+    }
+  }
+
+  /* everything not checked fires after the last checked revolution */
+  if (clock < best) {
+    best = clock;
+  }
+  return timer_last_run + best;
+}
+
 /**
  * Walk through the timer list and check if any timer is ready to fire.
  * Callback the provided function with the context pointer.
@@ -376,103 +600,103 @@ olsr_timer_walk(void)
 {
   unsigned int total_timers_walked = 0, total_timers_fired = 0;
   unsigned int wheel_slot_walks = 0;
+  uint32_t now, slot, skip;
+  uint64_t start;
+  int level;
+
+  now = olsr_clock_getNow();
 
   /*
-   * Check the required wheel slots since the last time a timer walk was invoked,
-   * or check *all* the wheel slots, whatever is less work.
-   * The latter is meant as a safety belt if the scheduler falls behind.
+   * Process all clockticks since the last walk. Empty root slots are
+   * skipped, so the work only depends on the number of expired or
+   * cascaded timers and the number of root level revolutions.
    */
-  while ((timer_last_run <= olsr_clock_getNow()) && (wheel_slot_walks < TIMER_WHEEL_SLOTS)) {
+  while ((int32_t)(now - timer_last_run) >= 0) {
     struct list_entity tmp_head_node;
-    /* keep some statistics */
-    unsigned int timers_walked = 0, timers_fired = 0;
 
-    /* Get the hash slot for this clocktick */
-    struct list_entity *timer_head_node;
+    slot = timer_last_run & TIMER_WHEEL_ROOT_MASK;
 
-    timer_head_node = &timer_wheel[timer_last_run & TIMER_WHEEL_MASK];
+    if (slot == 0) {
+      /* new revolution of the root level, pull down timers from above */
+      for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        olsr_timer_cascade(level);
 
-    /* Walk all entries hanging off this hash bucket. We treat this basically as a stack
-     * so that we always know if and where the next element is.
+        if (((timer_last_run >> (TIMER_WHEEL_ROOT_BITS + level * TIMER_WHEEL_LEVEL_BITS))
+            & TIMER_WHEEL_LEVEL_MASK) != 0) {
+          break;
+        }
+      }
+    }
+
+    /*
+     * Dequeue the whole slot into a temporary list.
+     * We do this to avoid loosing our walking context when
+     * multiple timers fire. Timers restarted by the callbacks are
+     * inserted relative to the next clocktick.
      */
     list_init_head(&tmp_head_node);
-    while (!list_is_empty(timer_head_node)) {
-      /* the top element */
-      struct olsr_timer_entry *timer;
+    list_merge(&tmp_head_node, &timer_wheel[slot]);
+    timer_root_bitmap[slot / 32] &= ~(1u << (slot % 32));
 
-      timer = list_first_element(timer_head_node, timer, timer_list);
+    timer_last_run++;
+    wheel_slot_walks++;
 
-      /*
-       * Dequeue and insert to a temporary list.
-       * We do this to avoid loosing our walking context when
-       * multiple timers fire.
-       */
-      list_remove(&timer->timer_list);
-      list_add_after(&tmp_head_node, &timer->timer_list);
-      timers_walked++;
-
-      /* Ready to fire ? */
-      if (olsr_clock_isPast(timer->timer_clock)) {
+    while (!list_is_empty(&tmp_head_node)) {
+      /* the top element */
+      struct olsr_timer_entry *timer;
 #if !defined(REMOVE_LOG_DEBUG)
-  struct timeval_buf timebuf;
+      struct timeval_buf timebuf;
 #endif
-        OLSR_DEBUG(LOG_TIMER, "TIMER: fire %s timer %p, ctx %p, "
-                   "at clocktick %u (%s)\n",
-                   timer->timer_info->name,
-                   timer, timer->timer_cb_context, timer_last_run,
-                   olsr_clock_getWallclockString(&timebuf));
-
-        /* This timer is expired, call into the provided callback function */
-        timer->timer_in_callback = true;
-        timer->timer_info->callback(timer->timer_cb_context);
-        timer->timer_in_callback = false;
-        timer->timer_info->changes++;
-
-        /* Only act on actually running timers */
-        if (timer->timer_running) {
-          /*
-           * Don't restart the periodic timer if the callback function has
-           * stopped the timer.
-           */
-          if (timer->timer_period) {
-            /* For periodical timers, rehash the random number and restart */
-            timer->timer_random = random();
-            olsr_timer_change(timer, timer->timer_period, timer->timer_jitter_pct);
-          } else {
-            /* Singleshot timers are stopped */
-            olsr_timer_stop(timer);
-          }
-        }
-        else {
-          /* free memory */
-          olsr_memcookie_free(timer_mem_cookie, timer);
-        }
 
-        timers_fired++;
+      timer = list_first_element(&tmp_head_node, timer, timer_list);
+      total_timers_walked++;
+
+      OLSR_DEBUG(LOG_TIMER, "TIMER: fire %s timer %p, ctx %p, "
+                 "at clocktick %u (%s)\n",
+                 timer->timer_info->name,
+                 timer, timer->timer_cb_context, timer_last_run - 1,
+                 olsr_clock_getWallclockString(&timebuf));
+
+      /* This timer is expired, call into the provided callback function */
+      start = olsr_profile_start();
+      timer->timer_in_callback = true;
+      timer->timer_info->callback(timer->timer_cb_context);
+      timer->timer_in_callback = false;
+      olsr_profile_stop(&timer->timer_info->profile, start);
+      timer->timer_info->changes++;
+
+      /* Only act on actually running timers */
+      if (timer->timer_running) {
+        /*
+         * Don't restart the periodic timer if the callback function has
+         * stopped the timer.
+         */
+        if (timer->timer_period) {
+          /* For periodical timers, rehash the random number and restart */
+          timer->timer_random = random();
+          olsr_timer_change(timer, timer->timer_period, timer->timer_jitter_pct);
+        } else {
+          /* Singleshot timers are stopped */
+          olsr_timer_stop(timer);
+        }
+      }
+      else {
+        /* free memory */
+        olsr_memcookie_free(timer_mem_cookie, timer);
       }
-    }
-
-    /*
-     * Now merge the temporary list back to the old bucket.
-     */
-    list_merge(timer_head_node, &tmp_head_node);
 
-    /* keep some statistics */
-    total_timers_walked += timers_walked;
-    total_timers_fired += timers_fired;
+      total_timers_fired++;
+    }
 
-    /* Increment the time slot and wheel slot walk iteration */
-    timer_last_run++;
-    wheel_slot_walks++;
+    /* jump over empty root slots, but never beyond the current time */
+    skip = olsr_timer_next_root_slot(timer_last_run);
+    if (skip > now + 1 - timer_last_run) {
+      skip = now + 1 - timer_last_run;
+    }
+    timer_last_run += skip;
   }
 
-  OLSR_DEBUG(LOG_TIMER, "TIMER: processed %4u/%d clockwheel slots, "
+  OLSR_DEBUG(LOG_TIMER, "TIMER: processed %4u clockwheel slots, "
              "timers walked %4u/%u, timers fired %u\n",
-             wheel_slot_walks, TIMER_WHEEL_SLOTS, total_timers_walked, timer_mem_cookie->ci_usage, total_timers_fired);
-
-  /*
-   * If the scheduler has slipped and we have walked all wheel slots,
-   * reset the last timer run.
-   */
-  timer_last_run = olsr_clock_getNow();
+             wheel_slot_walks, total_timers_walked, timer_mem_cookie->ci_usage, total_timers_fired);
 }
@@ -45,9 +45,27 @@
 #include "common/common_types.h"
 #include "common/list.h"
 #include "common/avl.h"
+#include "olsr_profile.h"
 
-#define TIMER_WHEEL_SLOTS 1024
-#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+/*
+ * The timer wheel is hierarchical. The root level has one slot per
+ * millisecond, each of the following levels has slots that cover a whole
+ * revolution of the level below. Together they cover the complete 32 bit
+ * range of the olsr clock.
+ */
+#define TIMER_WHEEL_ROOT_BITS 8
+#define TIMER_WHEEL_ROOT_SLOTS (1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_ROOT_MASK (TIMER_WHEEL_ROOT_SLOTS - 1)
+
+#define TIMER_WHEEL_LEVEL_BITS 6
+#define TIMER_WHEEL_LEVEL_SLOTS (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_LEVEL_MASK (TIMER_WHEEL_LEVEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS 4
+
+#define TIMER_WHEEL_SLOTS (TIMER_WHEEL_ROOT_SLOTS + TIMER_WHEEL_LEVELS * TIMER_WHEEL_LEVEL_SLOTS)
+
+/* coalescing window for validity and garbage collection timers */
+#define OLSR_TIMER_VALIDITY_COALESCING 250 /* milliseconds */
 
 /* prototype for timer callback */
 typedef void (*timer_cb_func) (void *);
@@ -69,11 +87,21 @@ struct olsr_timer_info {
   /* true if this is a class of periodic timers */
   bool periodic;
 
+  /*
+   * coalescing window in milliseconds, timers of this class are
+   * delayed to the next multiple of it so that they fire together
+   * with other timers. 0 means no coalescing.
+   */
+  uint32_t coalescing;
+
   /* Stats, resource usage */
   uint32_t usage;
 
   /* Stats, resource churn */
   uint32_t changes;
+
+  /* Stats, time spent in the callback */
+  struct olsr_profile profile;
 };
 
 
@@ -81,6 +109,9 @@ struct olsr_timer_info {
  * Our timer implementation is a based on individual timers arranged in
  * a double linked list hanging of hash containers called a timer wheel slot.
  * For every timer a olsr_timer_entry is created and attached to the timer wheel slot.
+ * Timers far in the future are kept in the coarse slots of the higher
+ * wheel levels and are only moved (cascaded) towards the root level when
+ * their slot comes up.
  * When the timer fires, the timer_cb function is called with the
  * context pointer.
  */
@@ -120,6 +151,7 @@ extern struct list_entity EXPORT(timerinfo_list);
 void olsr_timer_init(void);
 void olsr_timer_cleanup(void);
 void olsr_timer_walk(void);
+uint32_t olsr_timer_getNextEvent(void);
 
 struct olsr_timer_info *EXPORT(olsr_timer_add)(
     const char *name, timer_cb_func callback, bool periodic) __attribute__((warn_unused_result));
@@ -49,8 +49,15 @@ int os_route_add_rtentry(const struct rt_entry *, int);
 
 int os_route_del_rtentry(const struct rt_entry *, int);
 
+bool os_route_can_replace(void);
+
+void os_route_batch_begin(void);
+void os_route_batch_end(void);
+
 #if defined linux
  int rtnetlink_register_socket(int);
+ int olsr_os_netlink_init(void);
+ void olsr_os_netlink_cleanup(void);
 
  void olsr_os_niit_4to6_route(const struct olsr_ip_prefix *dst_v4, bool set);
  void olsr_os_niit_6to4_route(const struct olsr_ip_prefix *dst_v6, bool set);
@@ -52,14 +52,35 @@
 #define _OLSR_NET_OS_H
 
 #include <assert.h>
+#include <string.h>
 #include <sys/time.h>
 
 #include "olsr_types.h"
 #include "interfaces.h"
 
+/* additional piece of data appended to a packet when sending */
+struct os_packet_segment {
+  void *buf;
+  size_t len;
+};
+
+/* one datagram of a batched send/receive call */
+struct os_packet {
+  void *buf;                           /* packet buffer */
+  size_t len;                          /* buffer size before receive, packet length afterwards */
+  union olsr_sockaddr addr;            /* source or destination of the packet */
+  socklen_t addrlen;                   /* length of the received source address */
+
+  /* segments sent after the packet buffer (scatter-gather), send only */
+  const struct os_packet_segment *segments;
+  int segment_count;
+};
+
 /* OS dependent functions socket functions */
 ssize_t EXPORT(os_sendto)(int, const void *, size_t, int, const union olsr_sockaddr *);
 ssize_t EXPORT(os_recvfrom)(int, void *, size_t, int, union olsr_sockaddr *, socklen_t *);
+int EXPORT(os_sendmmsg)(int, struct os_packet *, int, int);
+int EXPORT(os_recvmmsg)(int, struct os_packet *, int, int);
 int os_select(int, fd_set *, fd_set *, fd_set *, struct timeval *);
 int EXPORT(os_close)(int);
 
@@ -85,6 +106,48 @@ void os_socket_set_olsr_options(struct interface *ifs, int socket, union olsr_so
 
 int get_ipv6_address(char *, struct sockaddr_in6 *, int);
 
+/**
+ * Calculate the total length of a packet to be sent
+ * @param pkt pointer to packet
+ * @return length of buffer and all segments
+ */
+static INLINE size_t
+os_packet_length(const struct os_packet *pkt) {
+  size_t len = pkt->len;
+  int i;
+
+  for (i = 0; i < pkt->segment_count; i++) {
+    len += pkt->segments[i].len;
+  }
+  return len;
+}
+
+/**
+ * Copy a packet and all of its segments into a continuous buffer,
+ * used by systems without scatter-gather sending.
+ * @param pkt pointer to packet
+ * @param dst pointer to target buffer
+ * @param size size of target buffer
+ * @return length of packet, 0 if the buffer was too small
+ */
+static INLINE size_t
+os_packet_linearize(const struct os_packet *pkt, uint8_t *dst, size_t size) {
+  size_t len;
+  int i;
+
+  if (os_packet_length(pkt) > size) {
+    return 0;
+  }
+
+  memcpy(dst, pkt->buf, pkt->len);
+  len = pkt->len;
+  for (i = 0; i < pkt->segment_count; i++) {
+    memcpy(dst + len, pkt->segments[i].buf, pkt->segments[i].len);
+    len += pkt->segments[i].len;
+  }
+  return len;
+}
+
 /* helper function for getting a socket */
 static INLINE int
 os_getsocket46(int family, const char *if_name, uint16_t port, int bufspace, union olsr_sockaddr *bindto) {
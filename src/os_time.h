@@ -9,10 +9,12 @@
 #define OS_TIME_H_
 
 #include <sys/time.h>
+#include "common/common_types.h"
 #include "defs.h"
 
 int EXPORT(os_gettimeofday)(struct timeval *TVal, void *TZone);
 void EXPORT(os_sleep)(unsigned int Sec);
 int EXPORT(os_nanosleep)(struct timespec *Req, struct timespec *Rem);
+uint64_t EXPORT(os_getnanotime)(void);
 
 #endif /* OS_TIME_H_ */
@@ -49,10 +49,13 @@
 #include "olsr.h"
 #include "os_net.h"
 #include "olsr_logging.h"
+#include "olsr_stats.h"
 #include "net_olsr.h"
+#include "common/string.h"
 
 #include <assert.h>
 #include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #ifdef WIN32
@@ -60,14 +63,39 @@
 #define EWOULDBLOCK WSAEWOULDBLOCK
 #endif
 
-static void parse_packet(uint8_t *binary, int size, struct interface *in_if, union olsr_ip_addr *from_addr);
+static void parse_packet(uint8_t *binary, int size, struct interface *in_if, union olsr_ip_addr *from_addr,
+    struct olsr_packet_buffer *pktbuf);
 
 static struct parse_function_entry *parse_functions = NULL;
 static struct preprocessor_function_entry *preprocessor_functions = NULL;
 static struct packetparser_function_entry *packetparser_functions = NULL;
 
+/* walk all registered message handlers */
+#define OLSR_FOR_ALL_PARSE_FUNCTIONS(entry) for (entry = parse_functions; entry != NULL; entry = entry->next)
+
+/* receive buffers for olsr_input() */
+static struct olsr_packet_buffer *input_buffers[OLSR_INPUT_BATCH];
+
+/*
+ * Message handlers sorted by message type. Both tables are rebuilt from
+ * parse_functions each time a handler is added or removed, so the
+ * parser only touches the handlers for the type of each message.
+ * The typed and the promiscuous handlers of a message are merged by
+ * their position in parse_functions, so they are called in the same
+ * order as by a walk over the whole list.
+ */
+static struct parse_function_entry *parse_dispatch[OLSR_PARSER_DISPATCH_SIZE];
+static struct parse_function_entry *parse_promiscuous = NULL;
+
+/* time spent in parse_packet() */
+static struct olsr_profile parse_packet_profile;
+
+/* packet and message counters */
+static struct olsr_stats stats_packets_received, stats_packets_dropped;
+static struct olsr_stats stats_messages_received, stats_messages_dropped, stats_messages_duplicate;
+
 static int olsr_forward_message(struct olsr_message *msg,
-    uint8_t *binary, struct interface *in_if, union olsr_ip_addr *from_addr);
+    uint8_t *binary, struct interface *in_if, union olsr_ip_addr *from_addr, struct olsr_packet_buffer *pktbuf);
 
 /**
  *Initialize the parser.
@@ -79,6 +107,19 @@ olsr_init_parser(void)
 {
   OLSR_INFO(LOG_PACKET_PARSING, "Initializing parser...\n");
 
+  olsr_profile_add(&parse_packet_profile, "parse_packet");
+
+  olsr_stats_add(&stats_packets_received, "olsr_packets_received_total",
+      "OLSR packets received", OLSR_STATS_COUNTER);
+  olsr_stats_add(&stats_packets_dropped, "olsr_packets_dropped_total",
+      "OLSR packets dropped because of a bad size or by a preprocessor", OLSR_STATS_COUNTER);
+  olsr_stats_add(&stats_messages_received, "olsr_messages_received_total",
+      "OLSR messages received", OLSR_STATS_COUNTER);
+  olsr_stats_add(&stats_messages_dropped, "olsr_messages_dropped_total",
+      "OLSR messages dropped because they were malformed", OLSR_STATS_COUNTER);
+  olsr_stats_add(&stats_messages_duplicate, "olsr_messages_duplicate_total",
+      "OLSR messages not processed because they were duplicates", OLSR_STATS_COUNTER);
+
   /* Initialize the packet functions */
   olsr_init_package_process();
 }
@@ -86,8 +127,60 @@ olsr_init_parser(void)
 void
 olsr_deinit_parser(void)
 {
+  int i;
+
   OLSR_INFO(LOG_PACKET_PARSING, "Deinitializing parser...\n");
   olsr_deinit_package_process();
+  olsr_profile_remove(&parse_packet_profile);
+
+  olsr_stats_remove(&stats_packets_received);
+  olsr_stats_remove(&stats_packets_dropped);
+  olsr_stats_remove(&stats_messages_received);
+  olsr_stats_remove(&stats_messages_dropped);
+  olsr_stats_remove(&stats_messages_duplicate);
+
+  for (i = 0; i < OLSR_INPUT_BATCH; i++) {
+    if (input_buffers[i]) {
+      net_unlock_packet_buffer(input_buffers[i]);
+      input_buffers[i] = NULL;
+    }
+  }
+}
+
+/**
+ * Rebuild the message type dispatch table and the list of
+ * promiscuous handlers from the list of registered handlers.
+ * Handlers keep their registration order within each type.
+ */
+static void
+olsr_parser_rebuild_dispatch(void)
+{
+  struct parse_function_entry **tail[OLSR_PARSER_DISPATCH_SIZE];
+  struct parse_function_entry **promiscuous_tail;
+  struct parse_function_entry *entry;
+  uint32_t order = 0;
+  int i;
+
+  for (i = 0; i < OLSR_PARSER_DISPATCH_SIZE; i++) {
+    parse_dispatch[i] = NULL;
+    tail[i] = &parse_dispatch[i];
+  }
+  parse_promiscuous = NULL;
+  promiscuous_tail = &parse_promiscuous;
+
+  OLSR_FOR_ALL_PARSE_FUNCTIONS(entry) {
+    entry->next_dispatch = NULL;
+    entry->order = order++;
+
+    if (entry->type == PROMISCUOUS) {
+      *promiscuous_tail = entry;
+      promiscuous_tail = &entry->next_dispatch;
+    }
+    else if (entry->type < OLSR_PARSER_DISPATCH_SIZE) {
+      *tail[entry->type] = entry;
+      tail[entry->type] = &entry->next_dispatch;
+    }
+  }
 }
 
 void
@@ -95,15 +188,31 @@ olsr_parser_add_function(parse_function * function, uint32_t type)
 {
   struct parse_function_entry *new_entry;
 
+  if (type != PROMISCUOUS && type >= OLSR_PARSER_DISPATCH_SIZE) {
+    OLSR_WARN(LOG_PACKET_PARSING, "Register parse function: message type %u will never be received\n", type);
+  }
+
   new_entry = olsr_malloc(sizeof(*new_entry), "Register parse function");
 
   new_entry->function = function;
   new_entry->type = type;
 
+  if (type == PROMISCUOUS) {
+    olsr_profile_add(&new_entry->profile, "parser type any");
+  }
+  else {
+    char name[OLSR_PROFILE_NAME_LENGTH];
+
+    snprintf(name, sizeof(name), "parser type %u", type);
+    olsr_profile_add(&new_entry->profile, name);
+  }
+
   /* Queue */
   new_entry->next = parse_functions;
   parse_functions = new_entry;
 
+  olsr_parser_rebuild_dispatch();
+
   OLSR_INFO(LOG_PACKET_PARSING, "Register parse function: Added function for type %u\n", type);
 }
 
@@ -119,13 +228,29 @@ olsr_parser_remove_function(parse_function * function)
       } else {
         prev->next = entry->next;
       }
+      olsr_profile_remove(&entry->profile);
       free(entry);
+      olsr_parser_rebuild_dispatch();
       return 1;
     }
   }
   return 0;
 }
 
+/**
+ * Call a message handler and account the time spent in it.
+ */
+static INLINE void
+olsr_parser_call(struct parse_function_entry *entry, struct olsr_message *msg,
+    struct interface *in_if, union olsr_ip_addr *from_addr, enum duplicate_status dup_status)
+{
+  uint64_t start;
+
+  start = olsr_profile_start();
+  entry->function(msg, in_if, from_addr, dup_status);
+  olsr_profile_stop(&entry->profile, start);
+}
+
 void
 olsr_preprocessor_add_function(preprocessor_function * function)
 {
@@ -222,14 +347,17 @@ olsr_parse_msg_hdr(const uint8_t **curr, struct olsr_message *msg)
  *@param from the sockaddr struct describing the sender
  *@param olsr the olsr struct containing the message
  *@param size the size of the message
+ *@param pktbuf the packet buffer containing the packet, NULL if
+ *  the packet has been moved out of it by a preprocessor
  *@return nada
  */
 static void
-parse_packet(uint8_t *binary, int size, struct interface *in_if, union olsr_ip_addr *from_addr)
+parse_packet(uint8_t *binary, int size, struct interface *in_if, union olsr_ip_addr *from_addr,
+    struct olsr_packet_buffer *pktbuf)
 {
   struct olsr_packet pkt;
   struct olsr_message msg;
-  struct parse_function_entry *entry;
+  struct parse_function_entry *entry, *typed, *promiscuous;
   struct packetparser_function_entry *packetparser;
   enum duplicate_status dup_status = 0;
   uint8_t *curr, *end;
@@ -247,6 +375,7 @@ parse_packet(uint8_t *binary, int size, struct interface *in_if, union olsr_ip_a
   if (size < 4) {
     OLSR_WARN(LOG_PACKET_PARSING, "Received too small packet (%u bytes) from %s\n",
         size, olsr_ip_to_string(&buf, from_addr));
+    olsr_stats_inc(&stats_packets_dropped);
     return;
   }
 
@@ -256,6 +385,7 @@ parse_packet(uint8_t *binary, int size, struct interface *in_if, union olsr_ip_a
   if (pkt.size != (size_t) size) {
     OLSR_WARN(LOG_PACKET_PARSING, "Received packet from %s (%u bytes) has bad size field: %u bytes\n",
               olsr_ip_to_string(&buf, from_addr), size, pkt.size);
+    olsr_stats_inc(&stats_packets_dropped);
     return;
   }
 
@@ -270,16 +400,19 @@ parse_packet(uint8_t *binary, int size, struct interface *in_if, union olsr_ip_a
   for (;curr <= end - MIN_MESSAGE_SIZE(); curr += msg.size) {
     const uint8_t *msg_payload = curr;
     olsr_parse_msg_hdr(&msg_payload, &msg);
+    olsr_stats_inc(&stats_messages_received);
 
     /* Check size of message */
     if (curr + msg.size > end) {
       OLSR_WARN(LOG_PACKET_PARSING, "Packet received from %s is too short (%u bytes) for message %u (%u bytes)!",
           olsr_ip_to_string(&buf, from_addr), size, msg.type, msg.size);
+      olsr_stats_inc(&stats_messages_dropped);
       break;
     }
     else if (msg.size == 0) {
       OLSR_WARN(LOG_PACKET_PARSING, "Received a zero lengthed message from %s (typde %d), ignoring all further content of the packet!",
           olsr_ip_to_string(&buf, from_addr), msg.type);
+      olsr_stats_inc(&stats_messages_dropped);
       return;
     }
 
@@ -305,39 +438,55 @@ parse_packet(uint8_t *binary, int size, struct interface *in_if, union olsr_ip_a
 #endif
       OLSR_WARN(LOG_PACKET_PARSING, "Malformed incoming message type %u from %s with originator %s: ttl=%u and hopcount=%u\n",
           msg.type, olsr_ip_to_string(&buf, from_addr), olsr_ip_to_string(&buf2, &msg.originator), msg.ttl, msg.hopcnt);
+      olsr_stats_inc(&stats_messages_dropped);
       continue;
     }
     if (olsr_is_duplicate_message(&msg, false, &dup_status)) {
       OLSR_INFO(LOG_PACKET_PARSING, "Not processing message duplicate from %s (seqnr %u)!\n",
           olsr_ip_to_string(&buf, &msg.originator), msg.seqno);
+      olsr_stats_inc(&stats_messages_duplicate);
     }
     else {
       OLSR_DEBUG(LOG_PACKET_PARSING, "Processing message type %u (seqno %u) from %s\n",
           msg.type, msg.seqno, olsr_ip_to_string(&buf, &msg.originator));
-      for (entry = parse_functions; entry != NULL; entry = entry->next) {
-        /* Should be the same for IPv4 and IPv6 */
-        /* Promiscuous or exact match */
-        if ((entry->type == PROMISCUOUS) || (entry->type == msg.type)) {
-          entry->function(&msg, in_if, from_addr, dup_status);
+      /* merge the handlers for this message type with the promiscuous ones */
+      typed = parse_dispatch[msg.type];
+      promiscuous = parse_promiscuous;
+      while (typed != NULL || promiscuous != NULL) {
+        if (promiscuous == NULL || (typed != NULL && typed->order < promiscuous->order)) {
+          entry = typed;
+          typed = typed->next_dispatch;
+        }
+        else {
+          entry = promiscuous;
+          promiscuous = promiscuous->next_dispatch;
         }
+        olsr_parser_call(entry, &msg, in_if, from_addr, dup_status);
       }
     }
-    olsr_forward_message(&msg, curr, in_if, from_addr);
+    olsr_forward_message(&msg, curr, in_if, from_addr, pktbuf);
   }                             /* for olsr_msg */
 }
 
 /**
- *Processing OLSR data from socket. Reading data, setting
- *wich interface recieved the message, Sends IPC(if used)
- *and passes the packet on to parse_packet().
+ * Process a single packet received on an OLSR socket.
+ * Checks the sender, calls the preprocessors and passes
+ * the packet on to parse_packet().
  *
- *@param fd the filedescriptor that data should be read from.
- *@return nada
+ * @param fd the filedescriptor the packet was read from.
+ * @param olsr_in_if the interface the packet was received on
+ * @param pkt pointer to the received packet
+ * @param pktbuf the packet buffer the packet was received into
  */
-void
-olsr_input(int fd, void *data __attribute__ ((unused)), unsigned int flags __attribute__ ((unused)))
+static void
+olsr_input_packet(int fd __attribute__ ((unused)), struct interface *olsr_in_if, struct os_packet *pkt,
+    struct olsr_packet_buffer *pktbuf)
 {
-  unsigned int cpu_overload_exit = 0;
+  union olsr_ip_addr from_addr;
+  struct preprocessor_function_entry *entry;
+  uint8_t *packet;
+  uint64_t start;
+  int size;
 #ifndef REMOVE_LOG_DEBUG
   char addrbuf[128];
 #endif
@@ -345,81 +494,134 @@ olsr_input(int fd, void *data __attribute__ ((unused)), unsigned int flags __att
   struct ipaddr_str buf;
 #endif
 
+  size = pkt->len;
+  if (size <= 0) {
+    return;
+  }
+
+  OLSR_DEBUG(LOG_PACKET_PARSING, "Recieved a packet from %s (fd=%d)\n",
+             sockaddr_to_string(addrbuf, sizeof(addrbuf), &pkt->addr.std, pkt->addrlen),
+             fd);
+
+  if (olsr_cnf->ip_version == AF_INET) {
+    /* IPv4 sender address */
+    if (pkt->addrlen != sizeof(struct sockaddr_in)) {
+      OLSR_WARN(LOG_PACKET_PARSING, "Got wrong ip size from recv()\n");
+      return;
+    }
+    from_addr.v4 = pkt->addr.v4.sin_addr;
+  } else {
+    /* IPv6 sender address */
+    if (pkt->addrlen != sizeof(struct sockaddr_in6)) {
+      OLSR_WARN(LOG_PACKET_PARSING, "Got wrong ip size from recv()\n");
+      return;
+    }
+    from_addr.v6 = pkt->addr.v6.sin6_addr;
+  }
+
+  /* are we talking to ourselves? */
+  if (if_ifwithaddr(&from_addr) != NULL) {
+    OLSR_INFO(LOG_PACKET_PARSING, "Ignore packet from ourself (%s).\n",
+        olsr_ip_to_string(&buf, &from_addr));
+    return;
+  }
+
+  olsr_stats_inc(&stats_packets_received);
+
+  // call preprocessors
+  packet = pkt->buf;
+  for (entry = preprocessor_functions; entry != NULL; entry = entry->next) {
+    packet = entry->function(packet, olsr_in_if, &from_addr, &size);
+    // discard package ?
+    if (packet == NULL) {
+      OLSR_INFO(LOG_PACKET_PARSING, "Discard package because of preprocessor\n");
+      olsr_stats_inc(&stats_packets_dropped);
+      return;
+    }
+  }
+
+  if (packet != pkt->buf) {
+    /* preprocessor moved the packet, forwarded messages cannot reference it */
+    pktbuf = NULL;
+  }
+
+  /*
+   * &from - sender
+   * &inbuf.olsr
+   * size - bytes read
+   */
+  start = olsr_profile_start();
+  parse_packet(packet, size, olsr_in_if, &from_addr, pktbuf);
+  olsr_profile_stop(&parse_packet_profile, start);
+}
+
+/**
+ *Processing OLSR data from socket. Reading data in batches
+ *of up to OLSR_INPUT_BATCH packets into preallocated buffers
+ *and passing each packet on to olsr_input_packet().
+ *Buffers still referenced by forwarded messages afterwards
+ *are replaced by new ones.
+ *
+ *@param fd the filedescriptor that data should be read from.
+ *@param data the interface the socket belongs to
+ *@return nada
+ */
+void
+olsr_input(int fd, void *data, unsigned int flags __attribute__ ((unused)))
+{
+  struct os_packet pkts[OLSR_INPUT_BATCH];
+  struct interface *olsr_in_if = data;
+  unsigned int received = 0;
+  int i, count;
+
+  if (olsr_in_if == NULL) {
+    olsr_in_if = if_ifwithsock(fd);
+  }
+
   for (;;) {
-    struct interface *olsr_in_if;
-    union olsr_ip_addr from_addr;
-    struct preprocessor_function_entry *entry;
-    uint8_t *packet;
-    /* sockaddr_in6 is bigger than sockaddr !!!! */
-    union olsr_sockaddr from;
-    socklen_t fromlen;
-    int size;
-    uint8_t inbuf[MAXMESSAGESIZE] __attribute__ ((aligned));
-
-    if (32 < ++cpu_overload_exit) {
+    if (received >= OLSR_INPUT_MAX_PACKETS) {
       OLSR_WARN(LOG_PACKET_PARSING, "CPU overload detected, ending olsr_input() loop\n");
       break;
     }
 
-    fromlen = sizeof(from);
-    size = os_recvfrom(fd, inbuf, sizeof(inbuf), 0, &from, &fromlen);
+    for (i = 0; i < OLSR_INPUT_BATCH; i++) {
+      if (input_buffers[i] == NULL) {
+        input_buffers[i] = net_alloc_packet_buffer();
+      }
+      pkts[i].buf = input_buffers[i]->data;
+      pkts[i].len = sizeof(input_buffers[i]->data);
+      pkts[i].addrlen = sizeof(pkts[i].addr);
+      pkts[i].segments = NULL;
+      pkts[i].segment_count = 0;
+    }
 
-    if (size <= 0) {
-      if (size < 0 && errno != EWOULDBLOCK) {
+    count = os_recvmmsg(fd, pkts, OLSR_INPUT_BATCH, 0);
+    if (count <= 0) {
+      if (count < 0 && errno != EWOULDBLOCK) {
         OLSR_WARN(LOG_PACKET_PARSING, "error recvfrom: %s", strerror(errno));
       }
       break;
     }
 
-    OLSR_DEBUG(LOG_PACKET_PARSING, "Recieved a packet from %s (fd=%d)\n",
-               sockaddr_to_string(addrbuf, sizeof(addrbuf), (struct sockaddr *)&from, fromlen),
-               fd);
-
-    if (olsr_cnf->ip_version == AF_INET) {
-      /* IPv4 sender address */
-      if (fromlen != sizeof(struct sockaddr_in)) {
-        OLSR_WARN(LOG_PACKET_PARSING, "Got wrong ip size from recv()\n");
-        break;
-      }
-      from_addr.v4 = ((struct sockaddr_in *)&from)->sin_addr;
-    } else {
-      /* IPv6 sender address */
-      if (fromlen != sizeof(struct sockaddr_in6)) {
-        OLSR_WARN(LOG_PACKET_PARSING, "Got wrong ip size from recv()\n");
-        break;
+    for (i = 0; i < count; i++) {
+      if (olsr_in_if == NULL) {
+        OLSR_WARN(LOG_PACKET_PARSING, "Could not find input interface for socket %d\n", fd);
+        continue;
       }
-      from_addr.v6 = ((struct sockaddr_in6 *)&from)->sin6_addr;
-    }
+      olsr_input_packet(fd, olsr_in_if, &pkts[i], input_buffers[i]);
 
-    /* are we talking to ourselves? */
-    if (if_ifwithaddr(&from_addr) != NULL) {
-      OLSR_INFO(LOG_PACKET_PARSING, "Ignore packet from ourself (%s).\n",
-          olsr_ip_to_string(&buf, &from_addr));
-      return;
-    }
-    olsr_in_if = if_ifwithsock(fd);
-    if (olsr_in_if == NULL) {
-      OLSR_WARN(LOG_PACKET_PARSING, "Could not find input interface for message from %s size %d\n",
-                olsr_ip_to_string(&buf, &from_addr), size);
-      return;
-    }
-    // call preprocessors
-    packet = &inbuf[0];
-    for (entry = preprocessor_functions; entry != NULL; entry = entry->next) {
-      packet = entry->function(packet, olsr_in_if, &from_addr, &size);
-      // discard package ?
-      if (packet == NULL) {
-        OLSR_INFO(LOG_PACKET_PARSING, "Discard package because of preprocessor\n");
-        return;
+      if (input_buffers[i]->refcount > 1) {
+        /* buffer is used by forwarded messages, get a new one */
+        net_unlock_packet_buffer(input_buffers[i]);
+        input_buffers[i] = NULL;
       }
     }
+    received += count;
 
-    /*
-     * &from - sender
-     * &inbuf.olsr
-     * size - bytes read
-     */
-    parse_packet(packet, size, olsr_in_if, &from_addr);
+    if (count < OLSR_INPUT_BATCH) {
+      /* socket queue is empty */
+      break;
+    }
   }
 }
 
@@ -432,7 +634,8 @@ olsr_input(int fd, void *data __attribute__ ((unused)), unsigned int flags __att
  *@returns positive if forwarded
  */
 static int
-olsr_forward_message(struct olsr_message *msg, uint8_t *binary, struct interface *in_if, union olsr_ip_addr *from_addr)
+olsr_forward_message(struct olsr_message *msg, uint8_t *binary, struct interface *in_if, union olsr_ip_addr *from_addr,
+    struct olsr_packet_buffer *pktbuf)
 {
   union olsr_ip_addr *src;
   struct nbr_entry *neighbor;
@@ -490,32 +693,11 @@ olsr_forward_message(struct olsr_message *msg, uint8_t *binary, struct interface
 
   /* looping trough interfaces */
   OLSR_FOR_ALL_INTERFACES(ifn, iterator) {
-    if (net_output_pending(ifn)) {
-      /* dont forward to incoming interface if interface is mode ether */
-      if (in_if->mode == IF_MODE_ETHER && ifn == in_if)
-        continue;
-
-      /*
-       * Check if message is to big to be piggybacked
-       */
-      if (net_outbuffer_push(ifn, binary, msg->size) != msg->size) {
-        /* Send */
-        net_output(ifn);
-        /* Buffer message */
-        set_buffer_timer(ifn);
-
-        if (net_outbuffer_push(ifn, binary, msg->size) != msg->size) {
-          OLSR_WARN(LOG_NETWORKING, "Received message to big to be forwarded in %s(%d bytes)!", ifn->int_name, msg->size);
-        }
-      }
-    } else {
-      /* No forwarding pending */
-      set_buffer_timer(ifn);
+    /* dont forward to incoming interface if interface is mode ether */
+    if (in_if->mode == IF_MODE_ETHER && ifn == in_if)
+      continue;
 
-      if (net_outbuffer_push(ifn, binary, msg->size) != msg->size) {
-        OLSR_WARN(LOG_NETWORKING, "Received message to big to be forwarded in %s(%d bytes)!", ifn->int_name, msg->size);
-      }
-    }
+    net_schedule_message(ifn, binary, msg->size, OLSR_PRIO_FORWARD, pktbuf);
   }
 
   return 1;
@@ -46,9 +46,19 @@
 #include "duplicate_set.h"
 #include "olsr_protocol.h"
 #include "lq_packet.h"
+#include "olsr_profile.h"
 
 #define PROMISCUOUS 0xffffffff
 
+/* size of the message type dispatch table, message types are 8 bit */
+#define OLSR_PARSER_DISPATCH_SIZE 256
+
+/* number of packets read from a socket with one os_recvmmsg() call */
+#define OLSR_INPUT_BATCH 16
+
+/* maximum number of packets read from a socket per socket event */
+#define OLSR_INPUT_MAX_PACKETS 128
+
 #define MIN_MESSAGE_SIZE()	((int)(8 + olsr_cnf->ipsize))
 
 /* Function returns false if the message should not be forwarded */
@@ -58,6 +68,15 @@ struct parse_function_entry {
   uint32_t type;                       /* If set to PROMISCUOUS all messages will be received */
   parse_function *function;
   struct parse_function_entry *next;
+
+  /* next handler for the same message type (or next promiscuous handler) */
+  struct parse_function_entry *next_dispatch;
+
+  /* position in the list of all handlers, keeps the calling order */
+  uint32_t order;
+
+  /* number of calls and time spent in the handler */
+  struct olsr_profile profile;
 };
 
 typedef uint8_t *preprocessor_function(uint8_t *packet, struct interface *, union olsr_ip_addr *, int *length);
@@ -104,6 +104,10 @@ process_message_neighbors(struct nbr_entry *neighbor, const struct lq_hello_mess
     if (lnk) {
       connector = olsr_lookup_nbr_con_entry(neighbor, neigh_addr);
 
+      if (connector->second_hop_linkcost != message_neighbors->cost
+          || connector->path_linkcost != lnk->linkcost + message_neighbors->cost) {
+        olsr_nbr2_set_mpr_dirty(connector->nbr2);
+      }
       connector->second_hop_linkcost = message_neighbors->cost;
       connector->path_linkcost = lnk->linkcost + message_neighbors->cost;
 
@@ -215,6 +219,10 @@ static void olsr_update_mprs_set(struct lq_hello_message *message, struct link_e
     link->neighbor->mprs_count--;
   }
 
+  if (new_mprs_status != link->is_mprs) {
+    /* the MPR selector set is part of our TC */
+    changes_neighborhood = true;
+  }
   link->is_mprs = new_mprs_status;
 }
 
@@ -42,6 +42,9 @@
 #include "process_routes.h"
 #include "olsr_logging.h"
 #include "os_kernel_routes.h"
+#include "olsr_profile.h"
+#include "olsr_stats.h"
+#include "tc_set.h"
 
 #include <errno.h>
 
@@ -54,9 +57,25 @@ static struct list_entity chg_kernel_list;
 export_route_function olsr_add_route_function;
 export_route_function olsr_del_route_function;
 
+/* time spent in olsr_update_kernel_routes() */
+static struct olsr_profile kernel_routes_profile;
+
+/* kernel route counters and size of the routing table */
+static struct olsr_stats stats_routes_added, stats_routes_changed, stats_routes_deleted;
+static struct olsr_stats stats_route_errors, stats_routes;
+
 #define MAX_FAILURE_COUNT 10000 //should be FAILURE_LESS_NOISE_COUNT * (int)x
 #define FAILURE_LESS_NOISE_COUNT 100 //after x errors only every x errors this is written to log
 
+/**
+ * @return number of entries in the routing table
+ */
+static uint64_t
+olsr_get_route_count(void)
+{
+  return routingtree.count;
+}
+
 void
 olsr_init_export_route(void)
 {
@@ -65,6 +84,20 @@ olsr_init_export_route(void)
   /* the add/chg and del kernel queues */
   list_init_head(&chg_kernel_list);
 
+  olsr_profile_add(&kernel_routes_profile, "olsr_update_kernel_routes");
+
+  olsr_stats_add(&stats_routes_added, "olsr_routes_added_total",
+      "Routes added to the kernel", OLSR_STATS_COUNTER);
+  olsr_stats_add(&stats_routes_changed, "olsr_routes_changed_total",
+      "Kernel routes changed to a new nexthop or metric", OLSR_STATS_COUNTER);
+  olsr_stats_add(&stats_routes_deleted, "olsr_routes_deleted_total",
+      "Routes deleted from the kernel", OLSR_STATS_COUNTER);
+  olsr_stats_add(&stats_route_errors, "olsr_route_errors_total",
+      "Failed kernel route updates", OLSR_STATS_COUNTER);
+  olsr_stats_add(&stats_routes, "olsr_routes",
+      "Entries in the routing table", OLSR_STATS_GAUGE);
+  stats_routes.get_value = olsr_get_route_count;
+
   olsr_add_route_function = os_route_add_rtentry;
   olsr_del_route_function = os_route_del_rtentry;
 }
@@ -72,17 +105,21 @@ olsr_init_export_route(void)
 /**
  * Delete all OLSR routes.
  *
- * This is extremely simple - Just increment the version of the
- * tree and then olsr_update_rib_routes() will see all routes in the tree
- * as outdated and olsr_update_kernel_routes() will finally flush it.
+ * This is extremely simple - Just withdraw the routes of all nodes
+ * and then olsr_update_rib_routes() will see all routes in the tree
+ * without a path and olsr_update_kernel_routes() will finally flush it.
  *
  */
 void
 olsr_delete_all_kernel_routes(void)
 {
+  struct tc_entry *tc, *iterator;
+
   OLSR_DEBUG(LOG_ROUTING, "Deleting all routes...\n");
 
-  olsr_bump_routingtree_version();
+  OLSR_FOR_ALL_TC_ENTRIES(tc, iterator) {
+    olsr_update_tc_routes(tc, NULL);
+  }
   olsr_update_rib_routes();
   olsr_update_kernel_routes();
 }
@@ -127,6 +164,8 @@ olsr_del_route(struct rt_entry *rt)
   error = olsr_del_route_function(rt, olsr_cnf->ip_version);
 
   if (error != 0) {
+    olsr_stats_inc(&stats_route_errors);
+
     if (rt->failure_count>0) {
       /*ignore if we failed to delete a route we never successfully created*/
       OLSR_WARN(LOG_ROUTING, "KERN: SUCCESFULLY failed to delete unexisting %s: %s\n", olsr_rt_to_string(rt), strerror(errno));
@@ -168,10 +207,15 @@ olsr_add_route(struct rt_entry *rt)
   rt->failure_count++;
 
   if (0 != olsr_add_route_function(rt, olsr_cnf->ip_version)) {
+    olsr_stats_inc(&stats_route_errors);
+
     /*rate limit error messages*/
     if ( (rt->failure_count <= FAILURE_LESS_NOISE_COUNT ) || (rt->failure_count % FAILURE_LESS_NOISE_COUNT == 0) )
       OLSR_ERROR(LOG_ROUTING, "KERN: ERROR on %d attempt to add %s: %s\n", rt->failure_count, olsr_rtp_to_string(rt->rt_best), strerror(errno));
 
+    /* try again with the next RIB update */
+    olsr_rt_set_dirty(rt);
+
     /*stop trying it*/
     if (rt->failure_count >= MAX_FAILURE_COUNT)  {
        OLSR_ERROR(LOG_ROUTING, " WILL NOT TRY AGAIN!!\n==============\n");
@@ -194,6 +238,98 @@ olsr_add_route(struct rt_entry *rt)
   }
 }
 
+/**
+ * Check if a changed route can be replaced atomically in the kernel
+ * instead of being deleted and added again.
+ *
+ * @param rt the changed route
+ * @return true if the route can be replaced
+ */
+static bool
+olsr_route_replaceable(const struct rt_entry *rt)
+{
+  /* plugins hooking the kernel exports might rely on delete and add */
+  if (olsr_add_route_function != os_route_add_rtentry || olsr_del_route_function != os_route_del_rtentry) {
+    return false;
+  }
+
+  if (!os_route_can_replace()) {
+    return false;
+  }
+
+  /* the metric is part of the kernel route key, a new metric would add a second route */
+  return FIBM_FLAT == olsr_cnf->fib_metric || rt->rt_metric.hops == rt->rt_best->rtp_metric.hops;
+}
+
+/**
+ * Replace the nexthop of a route in the kernel without removing it
+ * first. Falls back to delete and add if the kernel refuses.
+ */
+static void
+olsr_replace_route(struct rt_entry *rt)
+{
+  struct interface *old_if = rt->rt_nexthop.interface;
+
+  if (0 != olsr_add_route_function(rt, olsr_cnf->ip_version)) {
+    OLSR_DEBUG(LOG_ROUTING, "KERN: replacing %s failed, deleting old route first\n", olsr_rt_to_string(rt));
+
+    olsr_del_route(rt);
+    olsr_add_route(rt);
+    return;
+  }
+
+  /* save the nexthop and metric in the route entry */
+  rt->rt_nexthop = rt->rt_best->rtp_nexthop;
+  rt->rt_metric = rt->rt_best->rtp_metric;
+
+  /* move the interface lock to the new nexthop */
+  lock_interface(rt->rt_nexthop.interface);
+  unlock_interface(old_if);
+
+  rt->failure_count = 0;
+}
+
+/**
+ * Handle the asynchronous error of a batched kernel route update.
+ * A route which could not be added is marked as not installed,
+ * so the next RIB update tries to add it again.
+ *
+ * @param dst destination of the failed route
+ * @param set true if the route should have been added, false if deleted
+ * @param error errno value reported by the kernel
+ */
+void
+olsr_kernel_route_error(const struct olsr_ip_prefix *dst, bool set, int error)
+{
+  struct rt_entry *rt;
+#if !defined(REMOVE_LOG_ERROR)
+  struct ipprefix_str buf;
+#endif
+
+  rt = avl_find_element(&routingtree, dst, rt, rt_tree_node);
+
+  if (!set || rt == NULL) {
+    OLSR_ERROR(LOG_ROUTING, "KERN: ERROR on %s route to %s: %s\n",
+        set ? "adding" : "deleting", olsr_ip_prefix_to_string(&buf, dst), strerror(error));
+    olsr_stats_inc(&stats_route_errors);
+    return;
+  }
+
+  olsr_stats_inc(&stats_route_errors);
+  rt->failure_count++;
+
+  /*rate limit error messages*/
+  if ( (rt->failure_count <= FAILURE_LESS_NOISE_COUNT ) || (rt->failure_count % FAILURE_LESS_NOISE_COUNT == 0) )
+    OLSR_ERROR(LOG_ROUTING, "KERN: ERROR on %d attempt to add %s: %s\n", rt->failure_count, olsr_rt_to_string(rt), strerror(error));
+
+  /* the route is not in the kernel, release the interface */
+  if (rt->rt_nexthop.interface) {
+    unlock_interface(rt->rt_nexthop.interface);
+    rt->rt_nexthop.interface = NULL;
+  }
+  olsr_rt_set_dirty(rt);
+}
+
 /**
  * process the kernel change list.
  * the routes are already ordered such that nexthop routes
@@ -210,73 +346,72 @@ olsr_chg_kernel_routes(struct list_entity *head_node)
     return;
   }
 
+  os_route_batch_begin();
+
   /*
    * Traverse from the beginning to the end of the list,
    * such that nexthop routes are added first.
    */
   OLSR_FOR_ALL_RTLIST_ENTRIES(head_node, rt, iterator) {
 
-    /*if netlink and NLFM_REPLACE is available (ipv4 only?) and applicable (fib_metric FLAT only) and used in linux/kernel_*.c no delete would be necesarry here */
-    if (rt->rt_nexthop.interface) olsr_del_route(rt); // fresh routes do not have an interface pointer
-
-    olsr_add_route(rt);
+    if (rt->rt_nexthop.interface == NULL) {
+      /* fresh routes do not have an interface pointer */
+      olsr_stats_inc(&stats_routes_added);
+      olsr_add_route(rt);
+    }
+    else if (olsr_route_replaceable(rt)) {
+      /* atomic change, no window without a route to the destination */
+      olsr_stats_inc(&stats_routes_changed);
+      olsr_replace_route(rt);
+    }
+    else {
+      olsr_stats_inc(&stats_routes_changed);
+      olsr_del_route(rt);
+      olsr_add_route(rt);
+    }
 
     list_remove(&rt->rt_change_node);
   }
-}
-
-/**
- * Check the version number of all route paths hanging off a route entry.
- * If a route does not match the current routing tree number, remove it
- * from the global originator tree for that rt_entry.
- * Reset the best route pointer.
- */
-static void
-olsr_delete_outdated_routes(struct rt_entry *rt)
-{
-  struct rt_path *rtp, *iterator;
-
-  OLSR_FOR_ALL_RT_PATH_ENTRIES(rt, rtp, iterator) {
-    /*
-     * check the version number which gets incremented on every SPF run.
-     * comparing for unequalness avoids handling version number wraps.
-     */
-    if (routingtree_version != rtp->rtp_version) {
-
-      /* remove from the originator tree */
-      avl_delete(&rt->rt_path_tree, &rtp->rtp_tree_node);
-      rtp->rtp_rt = NULL;
-    }
-  }
 
-  /* safety measure against dangling pointers */
-  rt->rt_best = NULL;
+  os_route_batch_end();
 }
 
 /**
- * Walk all the routes, remove outdated routes and run
- * best path selection on the remaining set.
+ * Walk all routes with changed paths, remove routes without paths
+ * and run best path selection on the remaining set.
  * Finally compare the nexthop of the route head and the best
  * path and enqueue an add/chg operation.
  */
 void
 olsr_update_rib_routes(void)
 {
-  struct rt_entry *rt, *iterator;
+  struct list_entity tmp_head_node;
+  struct rt_entry *rt;
 
   OLSR_DEBUG(LOG_ROUTING, "Updating kernel routes...\n");
 
-  /* walk all routes in the RIB. */
+  os_route_batch_begin();
 
-  OLSR_FOR_ALL_RT_ENTRIES(rt, iterator) {
+  /* routes which cannot be removed now are queued again for the next run */
+  list_init_head(&tmp_head_node);
+  list_merge(&tmp_head_node, &rt_dirty_list);
 
-    /* eliminate first unused routes */
-    olsr_delete_outdated_routes(rt);
+  while (!list_is_empty(&tmp_head_node)) {
+    rt = list_first_element(&tmp_head_node, rt, rt_dirty_node);
+    list_remove(&rt->rt_dirty_node);
 
     if (!rt->rt_path_tree.count) {
       /* oops, all routes are gone - flush the route head */
-      if (olsr_del_route(rt) == 0) avl_delete(&routingtree, &rt->rt_tree_node);
-
+      rt->rt_best = NULL;
+      if (rt->rt_nexthop.interface != NULL) {
+        olsr_stats_inc(&stats_routes_deleted);
+      }
+      if (olsr_del_route(rt) == 0) {
+        olsr_delete_rt_entry(rt);
+      }
+      else {
+        olsr_rt_set_dirty(rt);
+      }
       continue;
     }
 
@@ -288,9 +423,10 @@ olsr_update_rib_routes(void)
         (FIBM_CORRECT == olsr_cnf->fib_metric && olsr_hopcount_change(&rt->rt_best->rtp_metric, &rt->rt_metric))) {
 
       olsr_enqueue_rt(&chg_kernel_list, rt);
-     
     }
   }
+
+  os_route_batch_end();
 }
 
 /**
@@ -299,9 +435,12 @@ olsr_update_rib_routes(void)
 void
 olsr_update_kernel_routes(void)
 {
+  uint64_t start;
 
   /* route changes and additions */
+  start = olsr_profile_start();
   olsr_chg_kernel_routes(&chg_kernel_list);
+  olsr_profile_stop(&kernel_routes_profile, start);
 
 #ifdef DEBUG
   olsr_print_routing_table();
@@ -54,6 +54,7 @@ void olsr_init_export_route(void);
 void olsr_update_rib_routes(void);
 void olsr_update_kernel_routes(void);
 void olsr_delete_all_kernel_routes(void);
+void olsr_kernel_route_error(const struct olsr_ip_prefix *, bool, int);
 
 #endif
 
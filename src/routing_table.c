@@ -60,6 +60,7 @@
 /* Cookies */
 struct olsr_memcookie_info *rt_mem_cookie = NULL;
 struct olsr_memcookie_info *rtp_mem_cookie = NULL; /* Maybe static */
+static struct olsr_memcookie_info *rt_lpm_mem_cookie = NULL;
 
 /*
  * Sven-Ola: if the current internet gateway is switched, the
@@ -73,11 +74,24 @@ static struct rt_path *current_inetgw = NULL;
 /* Root of our RIB */
 struct avl_tree routingtree;
 
+/* Route entries with changed paths, see olsr_update_rib_routes() */
+struct list_entity rt_dirty_list;
+
 /*
- * Keep a version number for detecting outdated elements
- * in the per rt_entry rt_path subtree.
+ * Path compressed binary trie over the prefixes of the RIB.
+ * Every node stores a prefix with all host bits cleared. Nodes which
+ * are only needed to join two diverging subtries (glue nodes) have an
+ * empty route list. Prefixes with different host bits share a node.
  */
-unsigned int routingtree_version;
+struct rt_lpm_node {
+  struct olsr_ip_prefix prefix;
+  struct rt_lpm_node *parent;
+  struct rt_lpm_node *child[2];
+  struct list_entity rt_list;
+};
+
+/* Root of the longest prefix match index */
+static struct rt_lpm_node *rt_lpm_root = NULL;
 
 /**
  * Initialize the routingtree and kernel change queues.
@@ -89,13 +103,195 @@ olsr_init_routing_table(void)
 
   /* the routing tree */
   avl_init(&routingtree, avl_comp_prefix_default, false, NULL);
-  routingtree_version = 0;
+  list_init_head(&rt_dirty_list);
 
   /*
    * Get some cookies for memory stats and memory recycling.
    */
   rt_mem_cookie = olsr_memcookie_add("rt_entry", sizeof(struct rt_entry));
   rtp_mem_cookie = olsr_memcookie_add("rt_path", sizeof(struct rt_path));
+  rt_lpm_mem_cookie = olsr_memcookie_add("rt_lpm_node", sizeof(struct rt_lpm_node));
+}
+
+/**
+ * @param addr pointer to address
+ * @param bit index of bit, 0 is the most significant one
+ * @return value of the bit
+ */
+static INLINE int
+olsr_lpm_bit(const union olsr_ip_addr *addr, int bit)
+{
+  return (addr->v6.s6_addr[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
+
+/**
+ * Calculate the number of leading bits two addresses have in common.
+ * @param addr1 pointer to first address
+ * @param addr2 pointer to second address
+ * @param maxlen maximum number of bits to compare
+ * @return length of common prefix, never larger than maxlen
+ */
+static int
+olsr_lpm_common_len(const union olsr_ip_addr *addr1, const union olsr_ip_addr *addr2, int maxlen)
+{
+  int i, len = 0;
+  uint8_t diff;
+
+  for (i = 0; len < maxlen; i++) {
+    diff = addr1->v6.s6_addr[i] ^ addr2->v6.s6_addr[i];
+    if (diff != 0) {
+      while ((diff & 0x80) == 0) {
+        diff <<= 1;
+        len++;
+      }
+      break;
+    }
+    len += 8;
+  }
+  return len < maxlen ? len : maxlen;
+}
+
+/**
+ * Allocate a new lpm node for a prefix and clear its host bits.
+ * @param prefix pointer to prefix
+ * @param len length of the prefix of the new node
+ * @return pointer to lpm node
+ */
+static struct rt_lpm_node *
+olsr_lpm_alloc_node(const struct olsr_ip_prefix *prefix, int len)
+{
+  struct rt_lpm_node *node;
+  int i, bits;
+
+  node = olsr_memcookie_malloc(rt_lpm_mem_cookie);
+  node->prefix = *prefix;
+  node->prefix.prefix_len = len;
+  node->prefix.prefix_origin = 0;
+
+  for (i = 0; i < (int)sizeof(node->prefix.prefix.v6.s6_addr); i++) {
+    bits = len - 8 * i;
+    if (bits <= 0) {
+      node->prefix.prefix.v6.s6_addr[i] = 0;
+    } else if (bits < 8) {
+      node->prefix.prefix.v6.s6_addr[i] &= 0xff << (8 - bits);
+    }
+  }
+
+  list_init_head(&node->rt_list);
+  return node;
+}
+
+/**
+ * Add a route entry to the longest prefix match index.
+ * @param rt pointer to route entry
+ */
+static void
+olsr_lpm_insert(struct rt_entry *rt)
+{
+  struct rt_lpm_node **link, *node, *parent, *new_node, *top;
+  int len, common = 0;
+
+  len = rt->rt_dst.prefix_len;
+  link = &rt_lpm_root;
+  parent = NULL;
+
+  /* walk down as long as the nodes cover the new prefix */
+  while ((node = *link) != NULL) {
+    common = olsr_lpm_common_len(&node->prefix.prefix, &rt->rt_dst.prefix,
+        node->prefix.prefix_len < len ? node->prefix.prefix_len : len);
+    if (common < node->prefix.prefix_len) {
+      break;
+    }
+
+    if (node->prefix.prefix_len == len) {
+      /* prefix is already known (maybe as a glue node) */
+      rt->rt_lpm = node;
+      list_add_tail(&node->rt_list, &rt->rt_lpm_list_node);
+      return;
+    }
+
+    parent = node;
+    link = &node->child[olsr_lpm_bit(&rt->rt_dst.prefix, node->prefix.prefix_len)];
+  }
+
+  new_node = olsr_lpm_alloc_node(&rt->rt_dst, len);
+  rt->rt_lpm = new_node;
+  list_add_tail(&new_node->rt_list, &rt->rt_lpm_list_node);
+
+  top = new_node;
+  if (node != NULL) {
+    if (common == len) {
+      /* the new prefix covers the old subtrie */
+      new_node->child[olsr_lpm_bit(&node->prefix.prefix, len)] = node;
+      node->parent = new_node;
+    } else {
+      /* both prefixes diverge, join them with a glue node */
+      top = olsr_lpm_alloc_node(&rt->rt_dst, common);
+      top->child[olsr_lpm_bit(&rt->rt_dst.prefix, common)] = new_node;
+      top->child[olsr_lpm_bit(&node->prefix.prefix, common)] = node;
+      new_node->parent = top;
+      node->parent = top;
+    }
+  }
+
+  top->parent = parent;
+  *link = top;
+}
+
+/**
+ * Remove a route entry from the longest prefix match index and
+ * remove all nodes which are not necessary anymore.
+ * @param rt pointer to route entry
+ */
+static void
+olsr_lpm_remove(struct rt_entry *rt)
+{
+  struct rt_lpm_node **link, *node, *parent, *child;
+
+  node = rt->rt_lpm;
+  if (node == NULL) {
+    return;
+  }
+
+  list_remove(&rt->rt_lpm_list_node);
+  rt->rt_lpm = NULL;
+
+  while (node != NULL && list_is_empty(&node->rt_list)) {
+    if (node->child[0] != NULL && node->child[1] != NULL) {
+      /* still a glue node */
+      break;
+    }
+
+    child = node->child[0] != NULL ? node->child[0] : node->child[1];
+    parent = node->parent;
+    if (parent == NULL) {
+      link = &rt_lpm_root;
+    } else {
+      link = &parent->child[parent->child[0] == node ? 0 : 1];
+    }
+
+    *link = child;
+    olsr_memcookie_free(rt_lpm_mem_cookie, node);
+
+    if (child != NULL) {
+      child->parent = parent;
+      break;
+    }
+
+    /* the parent lost a child, check if it became a useless glue node */
+    node = parent;
+  }
+}
+
+/**
+ * Remove a route entry without paths from the RIB.
+ * @param rt pointer to route entry
+ */
+void
+olsr_delete_rt_entry(struct rt_entry *rt)
+{
+  olsr_lpm_remove(rt);
+  avl_delete(&routingtree, &rt->rt_tree_node);
 }
 
 /**
@@ -120,29 +316,62 @@ olsr_lookup_routing_table(const union olsr_ip_addr *dst)
 }
 
 /**
- * Update gateway/interface/etx/hopcount and the version for a route path.
+ * Look up the most specific route covering an address
+ * in the routing table.
+ *
+ * @param dst the address to look up
+ *
+ * @return a pointer to the rt_entry struct of the longest matching
+ * prefix or NULL if there is none.
  */
-void
-olsr_update_rt_path(struct rt_path *rtp, struct tc_entry *tc, struct link_entry *link)
+struct rt_entry *
+olsr_lookup_routing_table_lpm(const union olsr_ip_addr *dst)
 {
+  struct rt_lpm_node *node;
+  struct rt_entry *rt = NULL;
+  int maxlen = 8 * olsr_cnf->ipsize;
 
-  rtp->rtp_version = routingtree_version;
+  for (node = rt_lpm_root; node != NULL;) {
+    if (olsr_lpm_common_len(&node->prefix.prefix, dst, node->prefix.prefix_len) < node->prefix.prefix_len) {
+      break;
+    }
+
+    if (!list_is_empty(&node->rt_list)) {
+      rt = list_first_element(&node->rt_list, rt, rt_lpm_list_node);
+    }
+
+    if (node->prefix.prefix_len >= maxlen) {
+      break;
+    }
+    node = node->child[olsr_lpm_bit(dst, node->prefix.prefix_len)];
+  }
+  return rt;
+}
 
+/**
+ * Update gateway/interface/etx/hopcount for a route path
+ * from the routing state of its tc entry.
+ */
+static void
+olsr_update_rt_path(struct rt_path *rtp, struct tc_entry *tc)
+{
   /* gateway */
-  rtp->rtp_nexthop.gateway = link->neighbor_iface_addr;
+  rtp->rtp_nexthop.gateway = tc->rib_gateway;
 
   /* interface */
-  if (rtp->rtp_nexthop.interface != link->inter) {
+  if (rtp->rtp_nexthop.interface != tc->rib_interface) {
     if (rtp->rtp_nexthop.interface) {
       unlock_interface(rtp->rtp_nexthop.interface);
     }
-    rtp->rtp_nexthop.interface = link->inter;
+    rtp->rtp_nexthop.interface = tc->rib_interface;
     lock_interface(rtp->rtp_nexthop.interface);
   }
 
   /* metric/etx */
-  rtp->rtp_metric.hops = tc->hops;
-  rtp->rtp_metric.cost = tc->path_cost;
+  rtp->rtp_metric.hops = tc->rib_hops;
+  rtp->rtp_metric.cost = tc->rib_cost;
+
+  olsr_rt_set_dirty(rtp->rtp_rt);
 }
 
 /**
@@ -164,6 +393,7 @@ olsr_alloc_rt_entry(struct olsr_ip_prefix *prefix)
 
   rt->rt_tree_node.key = &rt->rt_dst;
   avl_insert(&routingtree, &rt->rt_tree_node);
+  olsr_lpm_insert(rt);
 
   /* init the originator subtree */
   avl_init(&rt->rt_path_tree, avl_comp_addr_origin_default, false, NULL);
@@ -218,15 +448,15 @@ olsr_alloc_rt_path(struct tc_entry *tc, struct olsr_ip_prefix *prefix, uint8_t o
  * Create a route entry for a given rt_path and
  * insert it into the global RIB tree.
  */
-void
-olsr_insert_rt_path(struct rt_path *rtp, struct tc_entry *tc, struct link_entry *link)
+static void
+olsr_insert_rt_path(struct rt_path *rtp, struct tc_entry *tc)
 {
   struct rt_entry *rt;
 
   /*
    * no unreachable routes please.
    */
-  if (tc->path_cost == ROUTE_COST_BROKEN) {
+  if (tc->rib_interface == NULL) {
     return;
   }
 
@@ -259,8 +489,92 @@ olsr_insert_rt_path(struct rt_path *rtp, struct tc_entry *tc, struct link_entry
   /* backlink to the owning route entry */
   rtp->rtp_rt = rt;
 
-  /* update the version field and relevant parameters */
-  olsr_update_rt_path(rtp, tc, link);
+  /* update the relevant parameters */
+  olsr_update_rt_path(rtp, tc);
+}
+
+/**
+ * Remove a rt_path from the global RIB tree, but keep it
+ * in the prefix tree of its tc entry.
+ */
+static void
+olsr_withdraw_rt_path(struct rt_path *rtp)
+{
+  struct rt_entry *rt = rtp->rtp_rt;
+
+  if (rt == NULL) {
+    return;
+  }
+
+  /* remove from the originator tree */
+  avl_delete(&rt->rt_path_tree, &rtp->rtp_tree_node);
+  rtp->rtp_rt = NULL;
+
+  /* safety measure against dangling pointers */
+  if (rt->rt_best == rtp) {
+    rt->rt_best = NULL;
+  }
+  olsr_rt_set_dirty(rt);
+}
+
+/**
+ * Push the SPF result of a tc entry into the RIB. The prefixes
+ * of the tc entry are only visited if the nexthop or the metric
+ * of the node has changed since the last call.
+ *
+ * @param tc the tc entry
+ * @param link the first hop towards the tc entry, NULL if unreachable
+ */
+void
+olsr_update_tc_routes(struct tc_entry *tc, struct link_entry *link)
+{
+  struct rt_path *rtp, *iterator;
+
+  if (link == NULL) {
+    if (tc->rib_interface == NULL) {
+      /* not in the RIB */
+      return;
+    }
+
+    unlock_interface(tc->rib_interface);
+    tc->rib_interface = NULL;
+
+    OLSR_FOR_ALL_PREFIX_ENTRIES(tc, rtp, iterator) {
+      olsr_withdraw_rt_path(rtp);
+    }
+    return;
+  }
+
+  if (tc->rib_interface == link->inter && tc->rib_cost == tc->path_cost && tc->rib_hops == tc->hops
+      && olsr_ipcmp(&tc->rib_gateway, &link->neighbor_iface_addr) == 0) {
+    /* nothing changed */
+    return;
+  }
+
+  /* the interface must not vanish while it is referenced by the tc entry */
+  if (tc->rib_interface != link->inter) {
+    if (tc->rib_interface) {
+      unlock_interface(tc->rib_interface);
+    }
+    tc->rib_interface = link->inter;
+    lock_interface(tc->rib_interface);
+  }
+  tc->rib_gateway = link->neighbor_iface_addr;
+  tc->rib_cost = tc->path_cost;
+  tc->rib_hops = tc->hops;
+
+  /*
+   * Now walk all prefixes advertised by that node.
+   * Since the node is reachable, insert the prefix into the global RIB.
+   * If the prefix is already in the RIB, refresh the entry.
+   */
+  OLSR_FOR_ALL_PREFIX_ENTRIES(tc, rtp, iterator) {
+    if (rtp->rtp_rt) {
+      olsr_update_rt_path(rtp, tc);
+    } else {
+      olsr_insert_rt_path(rtp, tc);
+    }
+  }
 }
 
 /**
@@ -273,6 +587,7 @@ olsr_delete_rt_path(struct rt_path *rtp)
   /* remove from the originator tree */
   if (rtp->rtp_rt) {
     avl_delete(&rtp->rtp_rt->rt_path_tree, &rtp->rtp_tree_node);
+    olsr_rt_set_dirty(rtp->rtp_rt);
     /* clean up rt_best */
     if (rtp->rtp_rt->rt_best == rtp) {
       if (rtp->rtp_rt->rt_path_tree.count) {
@@ -463,6 +778,9 @@ olsr_insert_routing_table(const union olsr_ip_addr *dst, int plen, const union o
     OLSR_DEBUG(LOG_ROUTING, "RIB: add prefix %s/%d from %s\n",
                olsr_ip_to_string(&dstbuf, dst), plen, olsr_ip_to_string(&origbuf, originator));
 
+    /* a prefix of a reachable node goes into the RIB immediately */
+    olsr_insert_rt_path(rtp, tc);
+
     /* overload the hna change bit for flagging a prefix change */
     changes_hna = true;
   }
@@ -547,13 +865,13 @@ olsr_rtp_to_string(const struct rt_path *rtp)
 
   snprintf(buff, sizeof(buff),
            "%s from %s via %s dev %s, "
-           "cost %s, metric %u, v %u",
+           "cost %s, metric %u",
            olsr_ip_prefix_to_string(&prefixstr, &rtp->rtp_rt->rt_dst),
            olsr_ip_to_string(&origstr, &rtp->rtp_originator.prefix),
            olsr_ip_to_string(&gwstr, &rtp->rtp_nexthop.gateway),
            rtp->rtp_nexthop.interface ? rtp->rtp_nexthop.interface->int_name : "(null)",
            olsr_get_linkcost_text(rtp->rtp_metric.cost, true, lqbuffer, sizeof(lqbuffer)),
-           rtp->rtp_metric.hops, rtp->rtp_version);
+           rtp->rtp_metric.hops);
 
   return buff;
 }
@@ -587,12 +905,12 @@ olsr_print_routing_table(void)
 
     /* walk the per-originator path tree of routes */
     OLSR_FOR_ALL_RT_PATH_ENTRIES(rt, rtp, rtp_iterator) {
-      OLSR_INFO_NH(LOG_ROUTING, "\tfrom %s, cost %s, metric %u, via %s, dev %s, v %u\n",
+      OLSR_INFO_NH(LOG_ROUTING, "\tfrom %s, cost %s, metric %u, via %s, dev %s\n",
                    olsr_ip_to_string(&origstr, &rtp->rtp_originator.prefix),
                    olsr_get_linkcost_text(rtp->rtp_metric.cost, true, lqbuffer, sizeof(lqbuffer)),
                    rtp->rtp_metric.hops,
                    olsr_ip_to_string(&gwstr, &rtp->rtp_nexthop.gateway),
-                   rt->rt_nexthop.interface ? rt->rt_nexthop.interface->int_name : "(null)", rtp->rtp_version);
+                   rt->rt_nexthop.interface ? rt->rt_nexthop.interface->int_name : "(null)");
     }
   }
 #endif
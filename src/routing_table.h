@@ -73,6 +73,8 @@ struct rt_nexthop {
   struct interface *interface;         /* outgoing interface */
 };
 
+struct rt_lpm_node;
+
 /*
  * Every prefix in our RIB needs a route entry that contains
  * the nexthop of the best path as installed in the kernel FIB.
@@ -83,11 +85,14 @@ struct rt_nexthop {
 struct rt_entry {
   struct olsr_ip_prefix rt_dst;
   struct avl_node rt_tree_node;
+  struct rt_lpm_node *rt_lpm;          /* node of the longest prefix match index */
+  struct list_entity rt_lpm_list_node; /* list of routes sharing a lpm node */
   struct rt_path *rt_best;             /* shortcut to the best path */
   struct rt_nexthop rt_nexthop;        /* nexthop of FIB route */
   struct rt_metric rt_metric;          /* metric of FIB route */
   struct avl_tree rt_path_tree;
   struct list_entity rt_change_node;     /* queue for kernel FIB add/chg/del */
+  struct list_entity rt_dirty_node;    /* queue for best path election */
   int failure_count;
 };
 
@@ -110,7 +115,6 @@ struct rt_path {
   struct olsr_ip_prefix rtp_originator; /* originator of the route */
   struct avl_node rtp_prefix_tree_node; /* tc entry rtp node */
   struct olsr_ip_prefix rtp_dst;       /* the prefix */
-  uint32_t rtp_version;                /* for detection of outdated rt_paths */
 };
 
 #define OLSR_FOR_ALL_RT_PATH_ENTRIES(rt, rtp, iterator) avl_for_each_element_safe(&rt->rt_path_tree, rtp, rtp_tree_node, iterator)
@@ -158,23 +162,26 @@ union olsr_kernel_route {
 };
 
 extern struct avl_tree EXPORT(routingtree);
-extern unsigned int routingtree_version;
+extern struct list_entity rt_dirty_list;
 extern struct olsr_memcookie_info *rt_mem_cookie;
 
 void olsr_init_routing_table(void);
+void olsr_delete_rt_entry(struct rt_entry *);
 
 /**
- * Bump the version number of the routing tree.
+ * Queue a route entry whose set of paths has changed
+ * for the next best path election.
  *
- * After route-insertion compare the version number of the routes
- * against the version number of the table.
- * This is a lightweight detection if a node or prefix went away,
- * rather than brute force old vs. new rt_entry comparision.
+ * Only the queued route entries are visited after a SPF run,
+ * so the work depends on the number of changed prefixes
+ * and not on the size of the routing table.
  */
 static INLINE void
-olsr_bump_routingtree_version(void)
+olsr_rt_set_dirty(struct rt_entry *rt)
 {
-  routingtree_version++;
+  if (!list_node_added(&rt->rt_dirty_node)) {
+    list_add_tail(&rt_dirty_list, &rt->rt_dirty_node);
+  }
 }
 
 
@@ -238,11 +245,11 @@ olsr_get_nh(const struct rt_entry *rt)
 /* rt_path manipulation */
 struct rt_path *olsr_insert_routing_table(const union olsr_ip_addr *, const int, const union olsr_ip_addr *, const int);
 void olsr_delete_routing_table(union olsr_ip_addr *, int, union olsr_ip_addr *, int);
-void olsr_insert_rt_path(struct rt_path *, struct tc_entry *, struct link_entry *);
-void olsr_update_rt_path(struct rt_path *, struct tc_entry *, struct link_entry *);
+void olsr_update_tc_routes(struct tc_entry *, struct link_entry *);
 void olsr_delete_rt_path(struct rt_path *);
 
 struct rt_entry *EXPORT(olsr_lookup_routing_table) (const union olsr_ip_addr *);
+struct rt_entry *EXPORT(olsr_lookup_routing_table_lpm) (const union olsr_ip_addr *);
 
 
 #endif
@@ -41,6 +41,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef WIN32
 #include "win32/compat.h"  /* random() */
@@ -55,11 +56,14 @@
 #include "link_set.h"
 #include "mid_set.h"
 #include "neighbor_table.h"
+#include "olsr_spf.h"
 #include "olsr_logging.h"
+#include "olsr_stats.h"
 
 static bool delete_outdated_tc_edges(struct tc_entry *);
 static void olsr_expire_tc_entry(void *context);
 static void olsr_expire_tc_edge_gc(void *context);
+static void olsr_tc_cache_flush(void);
 
 /* Root of the link state database */
 struct avl_tree tc_tree;
@@ -70,6 +74,9 @@ struct olsr_memcookie_info *tc_mem_cookie = NULL;
 static struct olsr_timer_info *tc_edge_gc_timer_info = NULL;
 static struct olsr_timer_info *tc_validity_timer_info = NULL;
 
+/* size of the link state database */
+static struct olsr_stats stats_tc;
+
 static uint32_t relevantTcCount = 0;
 
 /* the first 32 TCs are without Fisheye */
@@ -77,6 +84,30 @@ static int ttl_index = -32;
 
 static uint16_t local_ansn_number = 0;
 
+/*
+ * Cached TC messages, only used with TcCache.
+ * The entries store the advertised link costs for the hysteresis check.
+ * Each fragment keeps a reference to the packet buffer holding the message,
+ * so the output scheduler can send it without copying.
+ */
+struct tc_cache_fragment {
+  struct list_entity node;
+  size_t size;
+  struct olsr_packet_buffer *pktbuf;
+};
+
+struct tc_cache_entry {
+  union olsr_ip_addr addr;
+  olsr_linkcost cost;
+};
+
+static struct olsr_memcookie_info *tc_cache_mem_cookie = NULL;
+static struct list_entity tc_cache_fragments;
+static struct tc_cache_entry *tc_cache_entries = NULL;
+static uint32_t tc_cache_entry_count = 0, tc_cache_entry_size = 0;
+static uint32_t tc_cache_refresh = 0;
+static bool tc_cache_dirty = false;
+
 /**
  * Add a new tc_entry to the tc tree
  *
@@ -112,6 +143,9 @@ olsr_add_tc_entry(const union olsr_ip_addr *adr)
   tc->mid_seq = -1;
   tc->hna_seq = -1;
   tc->tc_seq = -1;
+
+  /* not reachable until the next SPF run */
+  tc->path_cost = ROUTE_COST_BROKEN;
   /*
    * Insert into the global tc tree.
    */
@@ -133,6 +167,15 @@ olsr_add_tc_entry(const union olsr_ip_addr *adr)
   return tc;
 }
 
+/**
+ * @return number of nodes in the link state database
+ */
+static uint64_t
+olsr_get_tc_count(void)
+{
+  return tc_tree.count;
+}
+
 /**
  * Initialize the topology set
  *
@@ -150,7 +193,16 @@ olsr_init_tc(void)
   tc_edge_gc_timer_info = olsr_timer_add("TC edge GC", olsr_expire_tc_edge_gc, false);
   tc_validity_timer_info = olsr_timer_add("TC validity", &olsr_expire_tc_entry, false);
 
+  /* expiring topology a little bit later does no harm */
+  tc_edge_gc_timer_info->coalescing = OLSR_TIMER_VALIDITY_COALESCING;
+  tc_validity_timer_info->coalescing = OLSR_TIMER_VALIDITY_COALESCING;
+
   tc_mem_cookie = olsr_memcookie_add("tc_entry", sizeof(struct tc_entry));
+  tc_cache_mem_cookie = olsr_memcookie_add("TC cache", sizeof(struct tc_cache_fragment));
+  list_init_head(&tc_cache_fragments);
+
+  olsr_stats_add(&stats_tc, "olsr_topology_nodes", "Nodes in the link state database", OLSR_STATS_GAUGE);
+  stats_tc.get_value = olsr_get_tc_count;
 
   /* start with a random answer set number */
   local_ansn_number = random() & 0xffff;
@@ -196,6 +248,9 @@ olsr_change_myself_tc(void)
     tc_myself = NULL;
 
     main_ip_change = true;
+
+    /* cached TCs contain the old originator */
+    olsr_tc_cache_flush();
   }
 
   /*
@@ -254,6 +309,9 @@ olsr_delete_tc_entry(struct tc_entry *tc)
     return;
   }
 
+  /* withdraw the routes of the node */
+  olsr_update_tc_routes(tc, NULL);
+
   OLSR_FOR_ALL_PREFIX_ENTRIES(tc, rtp, rtp_iterator) {
     olsr_delete_rt_path(rtp);
   }
@@ -264,6 +322,8 @@ olsr_delete_tc_entry(struct tc_entry *tc)
   /* Flush all HNA Networks and kill its timers */
   olsr_flush_hna_nets(tc);
 
+  olsr_spf_vertex_deleted(tc);
+
   avl_delete(&tc_tree, &tc->vertex_node);
   olsr_memcookie_free(tc_mem_cookie, tc);
 }
@@ -429,6 +489,7 @@ olsr_add_tc_edge_entry(struct tc_entry *tc, const union olsr_ip_addr *addr, uint
    * Update the etx.
    */
   tc_edge->cost = olsr_calc_tc_cost(tc_edge);
+  olsr_spf_edge_changed(tc_edge);
 
   OLSR_DEBUG(LOG_TC, "TC: add edge entry %s\n", olsr_tc_edge_to_string(tc_edge));
 
@@ -475,6 +536,7 @@ olsr_delete_tc_edge_entry(struct tc_edge_entry *tc_edge)
   if (!tc_edge_inv->virtual || tc_edge_inv->neighbor != NULL) {
     /* mark this edge as virtual and correct tc_entry realedge_count */
     tc_edge->virtual = true;
+    olsr_spf_edge_changed(tc_edge);
     OLSR_DEBUG(LOG_TC, "TC: mark edge entry %s as virtual\n", olsr_tc_edge_to_string(tc_edge));
     return;
   }
@@ -483,6 +545,7 @@ olsr_delete_tc_edge_entry(struct tc_edge_entry *tc_edge)
 
   /* mark topology as changed */
   changes_topology = true;
+  olsr_spf_edge_deleted(tc_edge);
 
   /* split the two edges */
   tc_edge_inv->edge_inv = NULL;
@@ -524,6 +587,35 @@ delete_outdated_tc_edges(struct tc_entry *tc)
   return retval;
 }
 
+/**
+ * Revoke an edge which is no longer part of the advertised
+ * neighbor set of its TC entry.
+ *
+ * @param tc_edge the edge to revoke
+ */
+static void
+olsr_revoke_tc_edge(struct tc_edge_entry *tc_edge)
+{
+  tc_edge->cost = LINK_COST_BROKEN;
+  tc_edge->common_cost = LINK_COST_BROKEN;
+  tc_edge->edge_inv->common_cost = LINK_COST_BROKEN;
+  olsr_delete_tc_edge_entry(tc_edge);
+}
+
+/**
+ * @param tc the TC entry
+ * @param tc_edge an edge of the TC entry
+ * @return the following edge of the TC entry, NULL if tc_edge is the last one
+ */
+static struct tc_edge_entry *
+olsr_next_tc_edge(struct tc_entry *tc, struct tc_edge_entry *tc_edge)
+{
+  if (avl_is_last(&tc->edge_tree, &tc_edge->edge_node)) {
+    return NULL;
+  }
+  return avl_next_element(tc_edge, edge_node);
+}
+
 /**
  * Delete all destinations that are inside the borders but
  * not updated in the last tc.
@@ -535,34 +627,20 @@ delete_outdated_tc_edges(struct tc_entry *tc)
 static int
 olsr_delete_revoked_tc_edges(struct tc_entry *tc, uint16_t ansn, union olsr_ip_addr *lower_border, union olsr_ip_addr *upper_border)
 {
-  struct tc_edge_entry *tc_edge, *iterator;
+  struct tc_edge_entry *tc_edge, *next;
   int retval = 0;
-  bool passedLowerBorder = false;
 
   OLSR_DEBUG(LOG_TC, "TC: deleting revoked TCs\n");
 
-  OLSR_FOR_ALL_TC_EDGE_ENTRIES(tc, tc_edge, iterator) {
-    if (!passedLowerBorder) {
-      if (avl_comp_default(lower_border, &tc_edge->T_dest_addr, NULL) <= 0) {
-        passedLowerBorder = true;
-      } else {
-        continue;
-      }
-    }
-
-    if (passedLowerBorder) {
-      if (avl_comp_default(upper_border, &tc_edge->T_dest_addr, NULL) <= 0) {
-        break;
-      }
-    }
+  tc_edge = avl_find_ge_element(&tc->edge_tree, lower_border, tc_edge, edge_node);
+  while (tc_edge != NULL && avl_comp_default(upper_border, &tc_edge->T_dest_addr, NULL) > 0) {
+    next = olsr_next_tc_edge(tc, tc_edge);
 
     if (SEQNO_GREATER_THAN(ansn, tc_edge->ansn)) {
-      tc_edge->cost = LINK_COST_BROKEN;
-      tc_edge->common_cost = LINK_COST_BROKEN;
-      tc_edge->edge_inv->common_cost = LINK_COST_BROKEN;
-      olsr_delete_tc_edge_entry(tc_edge);
+      olsr_revoke_tc_edge(tc_edge);
       retval = 1;
     }
+    tc_edge = next;
   }
 
   if (retval)
@@ -575,29 +653,28 @@ olsr_delete_revoked_tc_edges(struct tc_entry *tc, uint16_t ansn, union olsr_ip_a
  * Creates new edge-entries if not registered.
  * Bases update on a received TC message
  *
- * @param entry the TC entry to check
- * @pkt the TC edge entry in the packet
+ * @param tc the TC entry to update
+ * @param tc_edge the TC edge entry of the neighbor, NULL if not known yet
+ * @param ansn the advertised neighbor set sequence number
+ * @param curr pointer to the link quality data of the edge in the packet
+ * @param neighbor the address of the advertised neighbor
  * @return 1 if entries are added 0 if not
  */
 static int
-olsr_tc_update_edge(struct tc_entry *tc, uint16_t ansn, const unsigned char **curr, union olsr_ip_addr *neighbor)
+olsr_tc_update_edge(struct tc_entry *tc, struct tc_edge_entry *tc_edge, uint16_t ansn,
+    const unsigned char **curr, union olsr_ip_addr *neighbor)
 {
-  struct tc_edge_entry *tc_edge;
+  olsr_linkcost old_cost = LINK_COST_BROKEN;
+  bool old_virtual = true;
   int edge_change = 0;
 
-  /*
-   * Fetch the per-edge data
-   */
-  pkt_get_ipaddress(curr, neighbor);
-
-  /* First check if we know this edge */
-  tc_edge = olsr_lookup_tc_edge(tc, neighbor);
   if (!tc_edge) {
     /*
      * Yet unknown - create it.
      * Check if the address is allowed.
      */
     if (!olsr_validate_address(neighbor)) {
+      *curr += olsr_sizeof_TCLQ();
       return 0;
     }
 
@@ -610,6 +687,8 @@ olsr_tc_update_edge(struct tc_entry *tc, uint16_t ansn, const unsigned char **cu
      * We know this edge - Update entry.
      */
     tc_edge->ansn = ansn;
+    old_cost = tc_edge->cost;
+    old_virtual = tc_edge->virtual;
 
     /*
      * Update link quality if configured.
@@ -631,9 +710,123 @@ olsr_tc_update_edge(struct tc_entry *tc, uint16_t ansn, const unsigned char **cu
   tc_edge->virtual = false;
   tc->virtual = false;
 
+  /* only real changes are interesting for the SPF */
+  if (old_virtual || old_cost != tc_edge->cost) {
+    olsr_spf_edge_changed(tc_edge);
+  }
+
   return edge_change;
 }
 
+/**
+ * Check if the neighbors of a TC message are sorted in the
+ * order of the edge tree.
+ *
+ * @param curr pointer to the first advertised neighbor
+ * @param count number of advertised neighbors
+ * @return true if the addresses are strictly ascending
+ */
+static bool
+olsr_tc_is_sorted(const uint8_t *curr, int count)
+{
+  union olsr_ip_addr addr, prev;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    pkt_get_ipaddress(&curr, &addr);
+    curr += olsr_sizeof_TCLQ();
+
+    if (i > 0 && avl_comp_default(&prev, &addr, NULL) >= 0) {
+      return false;
+    }
+    prev = addr;
+  }
+  return true;
+}
+
+/**
+ * Update the edges of a TC entry from a sorted neighbor list.
+ * The list and the edge tree are walked in lockstep, so each
+ * advertised neighbor is inserted or updated without a tree lookup
+ * and outdated edges inside the borders are revoked in the same pass.
+ *
+ * @param tc the TC entry to update
+ * @param ansn the advertised neighbor set sequence number
+ * @param curr pointer to the first advertised neighbor
+ * @param count number of advertised neighbors
+ * @param lower_border lower border of the neighbor set, NULL if
+ *   no edges should be revoked
+ * @param upper_border upper border of the neighbor set
+ * @return true if any edge was added or updated
+ */
+static bool
+olsr_tc_merge_edges(struct tc_entry *tc, uint16_t ansn, const uint8_t *curr, int count,
+    union olsr_ip_addr *lower_border, union olsr_ip_addr *upper_border)
+{
+  struct tc_edge_entry *tc_edge, *next;
+  union olsr_ip_addr neighbor;
+  bool relevant = false, revoked = false;
+  int i;
+
+  tc_edge = NULL;
+  for (i = 0; i < count; i++) {
+    pkt_get_ipaddress(&curr, &neighbor);
+
+    if (i == 0) {
+      /*
+       * The only tree search of this message. The lower border might be
+       * above the first neighbor (unadvertised or crafted border),
+       * so start at the smaller one to find all existing edges.
+       */
+      tc_edge = avl_find_ge_element(&tc->edge_tree,
+          lower_border != NULL && avl_comp_default(lower_border, &neighbor, NULL) < 0 ? lower_border : &neighbor,
+          tc_edge, edge_node);
+    }
+
+    /* edges between two advertised neighbors are not part of the set anymore */
+    while (tc_edge != NULL && avl_comp_default(&tc_edge->T_dest_addr, &neighbor, NULL) < 0) {
+      next = olsr_next_tc_edge(tc, tc_edge);
+
+      /* only edges inside the borders are revoked */
+      if (lower_border != NULL && SEQNO_GREATER_THAN(ansn, tc_edge->ansn)
+          && avl_comp_default(&tc_edge->T_dest_addr, lower_border, NULL) >= 0
+          && avl_comp_default(upper_border, &tc_edge->T_dest_addr, NULL) > 0) {
+        olsr_revoke_tc_edge(tc_edge);
+        revoked = true;
+      }
+      tc_edge = next;
+    }
+
+    if (tc_edge != NULL && avl_comp_default(&tc_edge->T_dest_addr, &neighbor, NULL) == 0) {
+      next = olsr_next_tc_edge(tc, tc_edge);
+      if (olsr_tc_update_edge(tc, tc_edge, ansn, &curr, &neighbor)) {
+        relevant = true;
+      }
+      tc_edge = next;
+    }
+    else if (olsr_tc_update_edge(tc, NULL, ansn, &curr, &neighbor)) {
+      relevant = true;
+    }
+  }
+
+  /* revoke the outdated edges between the last neighbor and the upper border */
+  while (lower_border != NULL && tc_edge != NULL
+      && avl_comp_default(upper_border, &tc_edge->T_dest_addr, NULL) > 0) {
+    next = olsr_next_tc_edge(tc, tc_edge);
+
+    if (SEQNO_GREATER_THAN(ansn, tc_edge->ansn)
+        && avl_comp_default(&tc_edge->T_dest_addr, lower_border, NULL) >= 0) {
+      olsr_revoke_tc_edge(tc_edge);
+      revoked = true;
+    }
+    tc_edge = next;
+  }
+
+  if (revoked)
+    changes_topology = true;
+  return relevant;
+}
+
 /**
  * Lookup an edge hanging off a TC entry.
  *
@@ -764,14 +957,14 @@ olsr_input_tc(struct olsr_message * msg,
 {
   uint16_t ansn;
   uint8_t lower_border, upper_border;
-  const uint8_t *curr;
+  const uint8_t *curr, *ptr;
   struct tc_entry *tc;
   bool relevantTc;
 #if !defined REMOVE_LOG_DEBUG
   struct ipaddr_str buf;
 #endif
-  union olsr_ip_addr lower_border_ip, upper_border_ip;
-  int borderSet = 0;
+  union olsr_ip_addr lower_border_ip, upper_border_ip, neighbor;
+  int borderSet = 0, count, i;
 
   /* We are only interested in TC message types. */
   if (msg->type != olsr_get_TC_MessageId()) {
@@ -821,19 +1014,44 @@ olsr_input_tc(struct olsr_message * msg,
   OLSR_DEBUG(LOG_TC, "Processing TC from %s, seq 0x%04x\n", olsr_ip_to_string(&buf, &msg->originator), tc->tc_seq);
 
   /*
-   * Now walk the edge advertisements contained in the packet.
+   * Calculate real border IPs from the first and the last
+   * advertised neighbor.
    */
-
+  count = (msg->end - curr) / (olsr_cnf->ipsize + olsr_sizeof_TCLQ());
   borderSet = 0;
+  if (count > 0) {
+    ptr = curr;
+    pkt_get_ipaddress(&ptr, &lower_border_ip);
+
+    ptr = curr + (count - 1) * (olsr_cnf->ipsize + olsr_sizeof_TCLQ());
+    pkt_get_ipaddress(&ptr, &upper_border_ip);
+
+    borderSet = olsr_calculate_tc_border(lower_border, &lower_border_ip, upper_border, &upper_border_ip);
+  }
+
+  /*
+   * Now walk the edge advertisements contained in the packet.
+   * Sorted neighbor sets (as generated by olsrd) are merged into
+   * the edge tree in a single pass.
+   */
   relevantTc = false;
-  while (curr + olsr_cnf->ipsize + olsr_sizeof_TCLQ() <= msg->end) {
-    if (olsr_tc_update_edge(tc, ansn, &curr, &upper_border_ip)) {
-      relevantTc = true;
+  if (olsr_tc_is_sorted(curr, count)) {
+    relevantTc = olsr_tc_merge_edges(tc, ansn, curr, count,
+        borderSet ? &lower_border_ip : NULL, &upper_border_ip);
+  }
+  else {
+    for (i = 0; i < count; i++) {
+      pkt_get_ipaddress(&curr, &neighbor);
+      if (olsr_tc_update_edge(tc, olsr_lookup_tc_edge(tc, &neighbor), ansn, &curr, &neighbor)) {
+        relevantTc = true;
+      }
     }
 
-    if (!borderSet) {
-      borderSet = 1;
-      memcpy(&lower_border_ip, &upper_border_ip, sizeof(lower_border_ip));
+    if (borderSet) {
+      /*
+       * Delete all old tc edges within borders.
+       */
+      olsr_delete_revoked_tc_edges(tc, ansn, &lower_border_ip, &upper_border_ip);
     }
   }
 
@@ -842,14 +1060,6 @@ olsr_input_tc(struct olsr_message * msg,
     changes_topology = true;
   }
 
-  /*
-   * Calculate real border IPs.
-   */
-  assert(msg);
-  if (borderSet) {
-    borderSet = olsr_calculate_tc_border(lower_border, &lower_border_ip, upper_border, &upper_border_ip);
-  }
-
   /*
    * Set or change the expiration timer accordingly.
    */
@@ -857,14 +1067,7 @@ olsr_input_tc(struct olsr_message * msg,
   olsr_timer_set(&tc->validity_timer, msg->vtime,
                  OLSR_TC_VTIME_JITTER, tc, tc_validity_timer_info);
 
-  if (borderSet) {
-
-    /*
-     * Delete all old tc edges within borders.
-     */
-    olsr_delete_revoked_tc_edges(tc, ansn, &lower_border_ip, &upper_border_ip);
-  } else {
-
+  if (!borderSet) {
     /*
      * Kick the the edge garbage collection timer. In the meantime hopefully
      * all edges belonging to a multipart neighbor set will arrive.
@@ -905,6 +1108,11 @@ olsr_delete_all_tc_entries(void) {
 
   /* kill tc_myself */
   tc_myself = NULL;
+
+  olsr_tc_cache_flush();
+  free(tc_cache_entries);
+  tc_cache_entries = NULL;
+  tc_cache_entry_size = 0;
 }
 
 static uint8_t
@@ -944,21 +1152,157 @@ get_local_ansn_number(void) {
 void
 increase_local_ansn_number(void) {
   local_ansn_number++;
+  tc_cache_dirty = true;
+}
+
+/**
+ * Check if a neighbor has to be advertised in our TC messages.
+ * @param nbr pointer to neighbor
+ * @return best link to the neighbor, NULL if it is not advertised
+ */
+static struct link_entry *
+olsr_get_advertised_link(struct nbr_entry *nbr)
+{
+  struct link_entry *link;
+
+  /*
+   * TC redundancy 2
+   *
+   * Only consider symmetric neighbours.
+   */
+  if (!nbr->is_sym) {
+    return NULL;
+  }
+
+  /*
+   * TC redundancy 1
+   *
+   * Only consider MPRs and MPR selectors
+   */
+  if (olsr_cnf->tc_redundancy == 1 && !nbr->is_mpr && nbr->mprs_count == 0) {
+    return NULL;
+  }
+
+  /*
+   * TC redundancy 0
+   *
+   * Only consider MPR selectors
+   */
+  if (olsr_cnf->tc_redundancy == 0 && nbr->mprs_count == 0) {
+    return NULL;
+  }
+
+  /* Set the entry's link quality */
+  link = get_best_link_to_neighbor_ip(&nbr->nbr_addr);
+  if (!link) {
+    /* no link ? */
+    return NULL;
+  }
+
+  if (link->linkcost >= LINK_COST_BROKEN) {
+    /* don't advertisebroken links */
+    return NULL;
+  }
+  return link;
 }
 
+/**
+ * Remember the cost of an advertised neighbor for the TC cache.
+ * @param addr address of the neighbor
+ * @param cost advertised link cost
+ */
+static void
+olsr_tc_cache_add_entry(const union olsr_ip_addr *addr, olsr_linkcost cost)
+{
+  struct tc_cache_entry *entries;
+
+  if (tc_cache_entry_count == tc_cache_entry_size) {
+    tc_cache_entry_size = tc_cache_entry_size == 0 ? 16 : 2 * tc_cache_entry_size;
+
+    entries = olsr_malloc(tc_cache_entry_size * sizeof(*entries), "TC cache entries");
+    if (tc_cache_entry_count > 0) {
+      memcpy(entries, tc_cache_entries, tc_cache_entry_count * sizeof(*entries));
+    }
+    free(tc_cache_entries);
+    tc_cache_entries = entries;
+  }
+
+  tc_cache_entries[tc_cache_entry_count].addr = *addr;
+  tc_cache_entries[tc_cache_entry_count].cost = cost;
+  tc_cache_entry_count++;
+}
+
+/**
+ * Remove all cached TC messages.
+ */
+static void
+olsr_tc_cache_flush(void)
+{
+  struct tc_cache_fragment *fragment, *iterator;
+
+  list_for_each_element_safe(&tc_cache_fragments, fragment, node, iterator) {
+    list_remove(&fragment->node);
+    net_unlock_packet_buffer(fragment->pktbuf);
+    olsr_memcookie_free(tc_cache_mem_cookie, fragment);
+  }
+  tc_cache_entry_count = 0;
+}
+
+/**
+ * Compare the current neighborhood with the cached TC messages.
+ * @return true if the set of advertised neighbors is the same and
+ *   all link costs are still inside the hysteresis band
+ */
 static bool
-olsr_output_lq_tc_internal(void *ctx  __attribute__ ((unused)), union olsr_ip_addr *nextIp, bool skip)
+olsr_tc_cache_is_valid(void)
+{
+  struct nbr_entry *nbr, *nbr_iterator;
+  struct link_entry *link;
+  struct tc_cache_entry *entry;
+  olsr_linkcost diff;
+  uint32_t idx = 0;
+
+  OLSR_FOR_ALL_NBR_ENTRIES(nbr, nbr_iterator) {
+    link = olsr_get_advertised_link(nbr);
+    if (link == NULL) {
+      continue;
+    }
+
+    if (idx == tc_cache_entry_count) {
+      return false;
+    }
+
+    entry = &tc_cache_entries[idx++];
+    if (olsr_ipcmp(&entry->addr, &nbr->nbr_addr) != 0) {
+      return false;
+    }
+
+    diff = link->linkcost > entry->cost ? link->linkcost - entry->cost : entry->cost - link->linkcost;
+    if ((uint64_t)diff * 100 > (uint64_t)entry->cost * olsr_cnf->tc_cost_hysteresis) {
+      return false;
+    }
+  }
+  return idx == tc_cache_entry_count;
+}
+
+/**
+ * Serialize one TC message fragment. TTL and sequence number
+ * are set when the message is sent.
+ * @param msg_buffer buffer for the message
+ * @param size pointer to message size, set to 0 if there is nothing to send
+ * @param nextIp first neighbor of the next fragment
+ * @param skip true if nextIp contains the start of this fragment
+ * @return true if another fragment is necessary
+ */
+static bool
+olsr_build_lq_tc(uint8_t *msg_buffer, size_t *size, union olsr_ip_addr *nextIp, bool skip)
 {
-  static int ttl_list[] = { 2, 8, 2, 16, 2, 8, 2, MAX_TTL };
-  struct interface *ifp, *ifp_iterator;
   struct nbr_entry *nbr, *nbr_iterator;
   struct link_entry *link;
   struct nbr_entry *prevNbr;
-  uint8_t msg_buffer[MAXMESSAGESIZE - OLSR_HEADERSIZE] __attribute__ ((aligned));
   uint8_t *curr = msg_buffer;
-  uint8_t *length_field, *border_flags, *seqno, *last;
+  uint8_t *length_field, *border_flags, *last;
   bool sendTC = false, nextFragment = false;
-  uint8_t ttl = 255;
 
   OLSR_INFO(LOG_PACKET_CREATION, "Building TC\n-------------------\n");
 
@@ -970,23 +1314,11 @@ olsr_output_lq_tc_internal(void *ctx  __attribute__ ((unused)), union olsr_ip_ad
 
   pkt_put_ipaddress(&curr, &olsr_cnf->router_id);
 
-  if (olsr_cnf->lq_fish > 0) {
-    /* handle fisheye */
-    ttl_index++;
-    if (ttl_index >= (int)ARRAYSIZE(ttl_list)) {
-      ttl_index = 0;
-    }
-    if (ttl_index >= 0) {
-      ttl = ttl_list[ttl_index];
-    }
-  }
-  pkt_put_u8(&curr, ttl);
-
-  /* hopcount */
+  /* ttl and hopcount */
+  pkt_put_u8(&curr, 0);
   pkt_put_u8(&curr, 0);
 
   /* reserve sequence number lazy */
-  seqno = curr;
   pkt_put_u16(&curr, 0);
   pkt_put_u16(&curr, get_local_ansn_number());
 
@@ -994,7 +1326,7 @@ olsr_output_lq_tc_internal(void *ctx  __attribute__ ((unused)), union olsr_ip_ad
   border_flags = curr;
   pkt_put_u16(&curr, 0xffff);
 
-  last = msg_buffer + sizeof(msg_buffer) - olsr_cnf->ipsize - olsr_sizeof_TCLQ();
+  last = msg_buffer + MAXMESSAGESIZE - OLSR_HEADERSIZE - olsr_cnf->ipsize - olsr_sizeof_TCLQ();
 
   OLSR_FOR_ALL_NBR_ENTRIES(nbr, nbr_iterator) {
     /* allow fragmentation */
@@ -1020,79 +1352,143 @@ olsr_output_lq_tc_internal(void *ctx  __attribute__ ((unused)), union olsr_ip_ad
       break;
     }
 
-    /*
-     * TC redundancy 2
-     *
-     * Only consider symmetric neighbours.
-     */
-    if (!nbr->is_sym) {
-      continue;
-    }
-
-    /*
-     * TC redundancy 1
-     *
-     * Only consider MPRs and MPR selectors
-     */
-    if (olsr_cnf->tc_redundancy == 1 && !nbr->is_mpr && nbr->mprs_count == 0) {
-      continue;
-    }
-
-    /*
-     * TC redundancy 0
-     *
-     * Only consider MPR selectors
-     */
-    if (olsr_cnf->tc_redundancy == 0 && nbr->mprs_count == 0) {
-      continue;
-    }
-
-    /* Set the entry's link quality */
-    link = get_best_link_to_neighbor_ip(&nbr->nbr_addr);
-    if (!link) {
-      /* no link ? */
-      continue;
-    }
-
-    if (link->linkcost >= LINK_COST_BROKEN) {
-      /* don't advertisebroken links */
+    link = olsr_get_advertised_link(nbr);
+    if (link == NULL) {
       continue;
     }
 
     pkt_put_ipaddress(&curr, &nbr->nbr_addr);
     olsr_serialize_tc_lq(&curr, link);
 
+    if (olsr_cnf->tc_cache) {
+      olsr_tc_cache_add_entry(&nbr->nbr_addr, link->linkcost);
+    }
     sendTC = true;
   }
 
   if (!sendTC && skip) {
     OLSR_DEBUG(LOG_TC, "Nothing to send for this TC...\n");
+    *size = 0;
     return false;
   }
 
-  /* late initialization of length and sequence number */
-  pkt_put_u16(&seqno, get_msg_seqno());
-  pkt_put_u16(&length_field, curr - msg_buffer);
+  /* late initialization of length */
+  *size = curr - msg_buffer;
+  pkt_put_u16(&length_field, *size);
+  return nextFragment;
+}
+
+/**
+ * Set TTL and sequence number of a serialized TC message
+ * and send it to all interfaces.
+ * @param pktbuf packet buffer containing the message
+ * @param size size of message
+ */
+static void
+olsr_send_lq_tc(struct olsr_packet_buffer *pktbuf, size_t size)
+{
+  static int ttl_list[] = { 2, 8, 2, 16, 2, 8, 2, MAX_TTL };
+  struct interface *ifp, *ifp_iterator;
+  uint8_t *curr;
+  uint8_t ttl = 255;
+
+  if (olsr_cnf->lq_fish > 0) {
+    /* handle fisheye */
+    ttl_index++;
+    if (ttl_index >= (int)ARRAYSIZE(ttl_list)) {
+      ttl_index = 0;
+    }
+    if (ttl_index >= 0) {
+      ttl = ttl_list[ttl_index];
+    }
+  }
+
+  /* skip type, vtime, size and originator */
+  curr = pktbuf->data + 4 + olsr_cnf->ipsize;
+  pkt_put_u8(&curr, ttl);
+
+  /* skip hopcount */
+  curr++;
+  pkt_put_u16(&curr, get_msg_seqno());
 
   /* send to all interfaces */
   OLSR_FOR_ALL_INTERFACES(ifp, ifp_iterator) {
-    if (net_outbuffer_bytes_left(ifp) < curr - msg_buffer) {
-      net_output(ifp);
-      set_buffer_timer(ifp);
-    }
-    net_outbuffer_push(ifp, msg_buffer, curr - msg_buffer);
+    net_schedule_message(ifp, pktbuf->data, size, OLSR_PRIO_LOCAL, pktbuf);
   }
-  return nextFragment;
 }
 
-void
-olsr_output_lq_tc(void *ctx) {
+/**
+ * Regenerate the cached TC messages from the current neighborhood.
+ */
+static void
+olsr_tc_cache_rebuild(void)
+{
+  struct tc_cache_fragment *fragment;
   union olsr_ip_addr next;
   bool skip = false;
 
+  olsr_tc_cache_flush();
   memset(&next, 0, sizeof(next));
 
-  while ((skip = olsr_output_lq_tc_internal(ctx, &next, skip)));
+  do {
+    fragment = olsr_memcookie_malloc(tc_cache_mem_cookie);
+    fragment->pktbuf = net_alloc_packet_buffer();
+    skip = olsr_build_lq_tc(fragment->pktbuf->data, &fragment->size, &next, skip);
+
+    if (fragment->size == 0) {
+      net_unlock_packet_buffer(fragment->pktbuf);
+      olsr_memcookie_free(tc_cache_mem_cookie, fragment);
+      break;
+    }
+    list_add_tail(&tc_cache_fragments, &fragment->node);
+  } while (skip);
+
+  tc_cache_refresh = olsr_clock_getAbsolute(olsr_cnf->tc_refresh_interval);
+}
+
+void
+olsr_output_lq_tc(void *ctx __attribute__ ((unused))) {
+  struct olsr_packet_buffer *pktbuf;
+  struct tc_cache_fragment *fragment;
+  union olsr_ip_addr next;
+  bool skip = false;
+  size_t size;
+
+  if (!olsr_cnf->tc_cache) {
+    memset(&next, 0, sizeof(next));
+
+    do {
+      pktbuf = net_alloc_packet_buffer();
+      skip = olsr_build_lq_tc(pktbuf->data, &size, &next, skip);
+      if (size > 0) {
+        olsr_send_lq_tc(pktbuf, size);
+      }
+      net_unlock_packet_buffer(pktbuf);
+    } while (skip);
+    return;
+  }
+
+  /*
+   * Only regenerate the TC if the neighborhood has changed in a
+   * relevant way or the refresh interval is over.
+   */
+  if (list_is_empty(&tc_cache_fragments) || olsr_clock_isPast(tc_cache_refresh)
+      || (tc_cache_dirty && !olsr_tc_cache_is_valid())) {
+    OLSR_DEBUG(LOG_TC, "Regenerate cached TC\n");
+    olsr_tc_cache_rebuild();
+  }
+  tc_cache_dirty = false;
+
+  list_for_each_element(&tc_cache_fragments, fragment, node) {
+    if (fragment->pktbuf->refcount > 1) {
+      /* the last copy still waits for output, do not change its TTL and seqno */
+      pktbuf = net_alloc_packet_buffer();
+      memcpy(pktbuf->data, fragment->pktbuf->data, fragment->size);
+      net_unlock_packet_buffer(fragment->pktbuf);
+      fragment->pktbuf = pktbuf;
+    }
+    olsr_send_lq_tc(fragment->pktbuf, fragment->size);
+  }
 }
 
 /*
@@ -44,6 +44,7 @@
 #include "defs.h"
 #include "common/avl.h"
 #include "common/list.h"
+#include "common/pairing_heap.h"
 #include "olsr_protocol.h"
 #include "lq_packet.h"
 #include "olsr_timer.h"
@@ -73,14 +74,21 @@ struct tc_edge_entry {
 struct tc_entry {
   struct avl_node vertex_node;         /* node keyed by ip address */
   union olsr_ip_addr addr;             /* vertex_node key */
-  struct avl_node cand_tree_node;      /* SPF candidate heap, node keyed by path_etx */
-  olsr_linkcost path_cost;             /* SPF calculated distance, cand_tree_node key */
+  struct pairing_heap_node cand_heap_node; /* SPF candidate heap, node keyed by path_cost */
+  olsr_linkcost path_cost;             /* SPF calculated distance, cand_heap_node key */
   struct list_entity path_list_node;   /* SPF result list */
   struct avl_tree edge_tree;           /* subtree for edges */
   struct avl_tree prefix_tree;         /* subtree for prefixes */
   struct avl_tree mid_tree;            /* subtree for MID entries */
   struct avl_tree hna_tree;            /* subtree for HNA entries */
   struct link_entry *next_hop;         /* SPF calculated link to the 1st hop neighbor */
+  struct tc_entry *spf_parent;         /* SPF calculated predecessor on the shortest path */
+  struct list_entity spf_dirty_node;   /* incremental SPF list of changed vertices */
+  olsr_linkcost spf_check_cost;        /* incremental SPF result, used for the self check */
+  union olsr_ip_addr rib_gateway;      /* nexthop of the prefixes in the RIB */
+  struct interface *rib_interface;     /* nexthop interface in the RIB, NULL if not in the RIB */
+  olsr_linkcost rib_cost;              /* path cost of the prefixes in the RIB */
+  uint8_t rib_hops;                    /* hopcount of the prefixes in the RIB */
   struct olsr_timer_entry *edge_gc_timer;   /* used for edge garbage collection */
   struct olsr_timer_entry *validity_timer;  /* tc validity time */
   bool virtual;                        /* true if node is virtual */
@@ -107,6 +107,7 @@ chk_if_changed(struct olsr_if_config *iface)
   struct ifreq ifr;
   int if_changes = 0;
   int int_flags;
+  int if_index;
 
   OLSR_DEBUG(LOG_INTERFACE, "Checking if %s is set down or changed\n", iface->name);
 
@@ -169,7 +170,11 @@ chk_if_changed(struct olsr_if_config *iface)
   }
 
   /* Get interface index */
-  ifp->if_index = if_nametoindex(ifr.ifr_name);
+  if_index = if_nametoindex(ifr.ifr_name);
+  if (ifp->if_index != if_index) {
+    ifp->if_index = if_index;
+    reindex_interface(ifp);
+  }
 
   /*
    * Now check if the IP has changed
@@ -203,6 +208,7 @@ chk_if_changed(struct olsr_if_config *iface)
       /* Update address */
       ifp->int_src.v6.sin6_addr = tmp_saddr6.sin6_addr;
       ifp->ip_addr.v6 = tmp_saddr6.sin6_addr;
+      reindex_interface(ifp);
 
       if_changes = 1;
     }
@@ -227,6 +233,7 @@ chk_if_changed(struct olsr_if_config *iface)
 
       ifp->int_src.v4 = *(struct sockaddr_in *)(ARM_NOWARN_ALIGN(&ifr.ifr_addr));
       ifp->ip_addr.v4 = tmp_saddr4->sin_addr;
+      reindex_interface(ifp);
 
       if_changes = 1;
     }
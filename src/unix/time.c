@@ -41,3 +41,18 @@ os_nanosleep(struct timespec *Req, struct timespec *Rem) {
 int os_gettimeofday(struct timeval *TVal, void *TZone) {
   return gettimeofday(TVal, TZone);
 }
+
+/**
+ * Read a monotonic high resolution clock, only useful for
+ * measuring time intervals.
+ * @return current time in nanoseconds
+ */
+uint64_t
+os_getnanotime(void) {
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+    return 0;
+  }
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
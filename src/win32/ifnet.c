@@ -462,6 +462,7 @@ chk_if_changed(struct olsr_if_config *olsr_if)
     OLSR_DEBUG(LOG_NETWORKING, "\tNew: %s\n", olsr_ip_to_string(&buf, &NewVal));
 
     Int->ip_addr.v4 = NewVal.v4;
+    reindex_interface(Int);
 
     AddrIn = &Int->int_src.v4;
 
@@ -184,6 +184,31 @@ os_route_del_rtentry(const struct rt_entry *rt, int ip_version)
   return 0;
 }
 
+/**
+ * Routes cannot be replaced atomically on this platform.
+ */
+bool
+os_route_can_replace(void)
+{
+  return false;
+}
+
+/**
+ * Route updates are not batched on this platform.
+ */
+void
+os_route_batch_begin(void)
+{
+}
+
+/**
+ * Route updates are not batched on this platform.
+ */
+void
+os_route_batch_end(void)
+{
+}
+
 /*
  * Local Variables:
  * c-basic-offset: 2
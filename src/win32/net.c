@@ -419,6 +419,67 @@ os_recvfrom(int s, void *buf, size_t len, int flags __attribute__ ((unused)), un
   return recvfrom(s, buf, len, 0, &sock->std, fromlen);
 }
 
+/**
+ * Send multiple packets, one sendto(2) call per packet.
+ * Packets with segments are copied into a continuous buffer first.
+ * @param s socket
+ * @param pkts array of packets with buffer, length and destination
+ * @param count number of packets in the array
+ * @param flags flags for sendto(2)
+ * @return number of packets sent, -1 if the first packet failed
+ */
+int
+os_sendmmsg(int s, struct os_packet *pkts, int count, int flags)
+{
+  static uint8_t buffer[65536];
+  const void *buf;
+  size_t len;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    buf = pkts[i].buf;
+    len = pkts[i].len;
+
+    if (pkts[i].segment_count > 0) {
+      /* no scatter-gather support, copy the segments behind the buffer */
+      len = os_packet_linearize(&pkts[i], buffer, sizeof(buffer));
+      buf = buffer;
+    }
+
+    if (os_sendto(s, buf, len, flags, &pkts[i].addr) < 0) {
+      break;
+    }
+  }
+  return i > 0 ? i : -1;
+}
+
+/**
+ * Receive multiple packets, one recvfrom(2) call per packet.
+ * @param s socket
+ * @param pkts array of packets with preallocated buffers,
+ *   length and source address are set for each received packet
+ * @param count number of packets in the array
+ * @param flags flags for recvfrom(2)
+ * @return number of packets received, -1 if an error happened
+ *   before the first packet
+ */
+int
+os_recvmmsg(int s, struct os_packet *pkts, int count, int flags)
+{
+  ssize_t len;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    pkts[i].addrlen = sizeof(pkts[i].addr);
+    len = os_recvfrom(s, pkts[i].buf, pkts[i].len, flags, &pkts[i].addr, &pkts[i].addrlen);
+    if (len < 0) {
+      break;
+    }
+    pkts[i].len = len;
+  }
+  return i > 0 ? i : -1;
+}
+
 /**
  * Wrapper for select(2)
  */
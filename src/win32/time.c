@@ -45,3 +45,18 @@ os_gettimeofday(struct timeval *TVal, void *TZone __attribute__ ((unused)))
   TVal->tv_usec = (unsigned int)(Ticks % 10000000) / 10;
   return 0;
 }
+
+uint64_t
+os_getnanotime(void)
+{
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+
+  if (frequency.QuadPart == 0 && !QueryPerformanceFrequency(&frequency)) {
+    return 0;
+  }
+  QueryPerformanceCounter(&counter);
+
+  return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ull
+    + (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ull / frequency.QuadPart;
+}